@@ -0,0 +1,258 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// A thin client that forwards its command line to a resident clang-expand
+// process (see `clang-expand --server`), starting one if none is running.
+// It deliberately does not link LLVM, so that it starts in a few milliseconds
+// instead of paying for clang's static initialization on every keystroke.
+
+// Project includes
+#include "clang-expand/server/protocol.hpp"
+
+// System includes
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Standard includes
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+/// How long to wait for a freshly started server to accept connections.
+constexpr unsigned startupTimeoutMilliseconds = 10000;
+
+/// Connects to the server.
+/// \returns The connected socket, or -1 if nobody is listening.
+int connectToServer(const std::string& socketPath) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof address);
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof address.sun_path) return -1;
+  std::strcpy(address.sun_path, socketPath.c_str());
+
+  const int connection = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connection < 0) return -1;
+
+  const auto* generic = reinterpret_cast<const sockaddr*>(&address);
+  if (::connect(connection, generic, sizeof address) != 0) {
+    ::close(connection);
+    return -1;
+  }
+
+  return connection;
+}
+
+/// Finds the full clang-expand binary: `$CLANG_EXPAND_SERVER_BINARY`, or
+/// `clang-expand` next to this executable, or else whatever is on the `PATH`.
+std::string findServerBinary(const char* argv0) {
+  if (const char* binary = std::getenv("CLANG_EXPAND_SERVER_BINARY")) {
+    return binary;
+  }
+
+  char path[PATH_MAX];
+  const auto length = ::readlink("/proc/self/exe", path, sizeof path - 1);
+  if (length > 0) {
+    path[length] = '\0';
+  } else if (::realpath(argv0, path) == nullptr) {
+    return "clang-expand";
+  }
+
+  std::string directory(path);
+  const auto slash = directory.rfind('/');
+  if (slash == std::string::npos) return "clang-expand";
+
+  return directory.substr(0, slash + 1) + "clang-expand";
+}
+
+/// Starts the server in the background, fully detached from us (and our
+/// terminal), so that it outlives this process. If `$CLANG_EXPAND_FORK` is
+/// set, the server answers every request in a forked child (see `--fork`).
+void startServer(const std::string& binary, const std::string& socketPath) {
+  const auto argument = "--server=" + socketPath;
+  const char* fork = std::getenv("CLANG_EXPAND_FORK");
+  const char* mode = (fork != nullptr && *fork != '\0') ? "--fork" : nullptr;
+
+  const pid_t child = ::fork();
+  if (child < 0) return;
+
+  if (child == 0) {
+    ::setsid();
+    if (::fork() != 0) ::_exit(EXIT_SUCCESS);
+
+    const int null = ::open("/dev/null", O_RDWR);
+    ::dup2(null, STDIN_FILENO);
+    ::dup2(null, STDOUT_FILENO);
+    ::dup2(null, STDERR_FILENO);
+    if (null > STDERR_FILENO) ::close(null);
+
+    ::execlp(binary.c_str(), binary.c_str(), argument.c_str(), mode, nullptr);
+    ::_exit(127);
+  }
+
+  ::waitpid(child, nullptr, 0);
+}
+
+/// Connects to the server, starting it if necessary.
+/// \returns The connected socket, or -1 if the server could not be started.
+int connectOrStartServer(const std::string& socketPath, const char* argv0) {
+  int connection = connectToServer(socketPath);
+  if (connection >= 0) return connection;
+
+  startServer(findServerBinary(argv0), socketPath);
+
+  // Loading clang takes a moment, so back off a little between attempts.
+  unsigned waited = 0;
+  for (unsigned delay = 1; waited < startupTimeoutMilliseconds; delay *= 2) {
+    if (delay > 100) delay = 100;
+    ::usleep(delay * 1000);
+    waited += delay;
+
+    connection = connectToServer(socketPath);
+    if (connection >= 0) return connection;
+  }
+
+  return -1;
+}
+
+/// Reads all of stdin.
+bool readInput(std::string& input) {
+  char buffer[4096];
+  while (true) {
+    const auto count = ::read(STDIN_FILENO, buffer, sizeof buffer);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (count == 0) return true;
+    input.append(buffer, static_cast<std::size_t>(count));
+  }
+}
+
+/// Checks whether the argument asks for output that only the full binary
+/// knows how to produce (its option descriptions and version).
+bool isInformational(const std::string& argument) {
+  const auto start = argument.find_first_not_of('-');
+  if (start == 0 || start == std::string::npos) return false;
+
+  const auto name = argument.substr(start);
+  return name == "help" || name == "help-hidden" || name == "version" ||
+         name.compare(0, 10, "help-list") == 0;
+}
+
+/// Checks whether the argument is an `-unsaved` option, whose contents follow
+/// on stdin.
+bool isUnsaved(const std::string& argument) {
+  const auto start = argument.find_first_not_of('-');
+  if (start == 0 || start == std::string::npos) return false;
+
+  return argument.compare(start, 7, "unsaved") == 0;
+}
+
+/// Writes all of the string to the file descriptor.
+void writeAll(int descriptor, const std::string& string) {
+  const char* data = string.data();
+  std::size_t size = string.size();
+  while (size > 0) {
+    const auto written = ::write(descriptor, data, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+}
+}  // namespace
+
+auto main(int argc, char* argv[]) -> int {
+  using ClangExpand::Server::Request;
+  using ClangExpand::Server::Response;
+
+  std::signal(SIGPIPE, SIG_IGN);
+
+  Request request;
+  bool needsInput = false;
+  for (int index = 1; index < argc; ++index) {
+    const std::string argument(argv[index]);
+    if (isInformational(argument)) {
+      const auto binary = findServerBinary(argv[0]);
+      ::execvp(binary.c_str(), argv);
+      std::fprintf(stderr, "Could not run %s\n", binary.c_str());
+      return EXIT_FAILURE;
+    }
+    needsInput = needsInput || isUnsaved(argument);
+    request.arguments.emplace_back(argument);
+  }
+
+  char workingDirectory[PATH_MAX];
+  if (::getcwd(workingDirectory, sizeof workingDirectory) == nullptr) {
+    std::perror("Could not determine the working directory");
+    return EXIT_FAILURE;
+  }
+  request.workingDirectory = workingDirectory;
+
+  if (needsInput && !readInput(request.input)) {
+    std::perror("Could not read stdin");
+    return EXIT_FAILURE;
+  }
+
+  const auto socketPath = ClangExpand::Server::getDefaultSocketPath();
+  if (socketPath.empty()) {
+    std::fprintf(stderr, "Could not create a private socket directory\n");
+    return EXIT_FAILURE;
+  }
+
+  const int connection = connectOrStartServer(socketPath, argv[0]);
+  if (connection < 0) {
+    std::fprintf(stderr,
+                 "Could not connect to clang-expand server at %s\n",
+                 socketPath.c_str());
+    return EXIT_FAILURE;
+  }
+
+  Response response;
+  const bool answered = ClangExpand::Server::sendRequest(connection, request) &&
+                        ClangExpand::Server::receiveResponse(connection,
+                                                             response);
+  ::close(connection);
+
+  if (!answered) {
+    std::fprintf(stderr, "Lost connection to clang-expand server\n");
+    return EXIT_FAILURE;
+  }
+
+  writeAll(STDOUT_FILENO, response.output);
+  writeAll(STDERR_FILENO, response.errors);
+
+  return response.exitCode;
+}
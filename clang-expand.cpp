@@ -31,9 +31,23 @@
 //===----------------------------------------------------------------------===//
 
 // Project includes
+#include "clang-expand/caller-search/expander.hpp"
+#include "clang-expand/common/caching-file-system.hpp"
+#include "clang-expand/common/offset.hpp"
+#include "clang-expand/common/range.hpp"
+#include "clang-expand/common/routines.hpp"
+#include "clang-expand/definition-search/candidates.hpp"
+#include "clang-expand/definition-search/include-graph.hpp"
+#include "clang-expand/error.hpp"
+#include "clang-expand/lsp/language-server.hpp"
+#include "clang-expand/merge.hpp"
 #include "clang-expand/options.hpp"
 #include "clang-expand/result.hpp"
 #include "clang-expand/search.hpp"
+#if defined(CLANG_EXPAND_SERVER)
+#include "clang-expand/server/protocol.hpp"
+#include "clang-expand/server/server.hpp"
+#endif
 
 // Third-party includes
 #include <third-party/json.hpp>
@@ -41,14 +55,36 @@
 // Clang includes
 #include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/ReplacementsYaml.h>
 
 // LLVM includes
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/YAMLTraits.h>
 #include <llvm/Support/raw_ostream.h>
 
 // Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
 #include <string>
+#include <system_error>
+#include <utility>
 #include <vector>
 
 namespace {
@@ -110,30 +146,523 @@ llvm::cl::opt<bool> rewriteOption(
     llvm::cl::desc("Whether to generate the rewritten (expand) definition"),
     llvm::cl::cat(clangExpandCategory));
 
+llvm::cl::opt<bool> statisticsOption(
+    "statistics",
+    llvm::cl::init(false),
+    llvm::cl::desc("Whether to return file cache statistics"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<ClangExpand::Offset::Encoding> positionsOption(
+    "positions",
+    llvm::cl::init(ClangExpand::Offset::Encoding::LineColumn),
+    llvm::cl::desc("How to report positions in files"),
+    llvm::cl::values(clEnumValN(ClangExpand::Offset::Encoding::LineColumn,
+                                "lines",
+                                "As line and column (default)"),
+                     clEnumValN(ClangExpand::Offset::Encoding::Bytes,
+                                "bytes",
+                                "As byte offsets into the file")),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<bool> allSourcesOption(
+    "all-sources",
+    llvm::cl::init(false),
+    llvm::cl::desc("Whether to search every source in the compilation "
+                   "database for the definition"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<bool> allDefinitionsOption(
+    "all-definitions",
+    llvm::cl::init(false),
+    llvm::cl::desc("Whether to search for every definition of the function "
+                   "instead of stopping at the first"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<bool> callersOption(
+    "callers",
+    llvm::cl::init(false),
+    llvm::cl::desc("Whether to find every call to the function instead, "
+                   "printed one JSON object per line as they are found"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<std::string> expandAllOption(
+    "expand-all",
+    llvm::cl::desc("A file to which to write the expansion of every call to "
+                   "the function, as YAML for clang-apply-replacements"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<std::string> sourcesFromOption(
+    "sources-from",
+    llvm::cl::desc("A file listing further sources to search for the "
+                   "definition, one per line"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<bool> pruneOption(
+    "prune",
+    llvm::cl::init(false),
+    llvm::cl::desc("Whether to skip sources that cannot include the file "
+                   "declaring the function"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<std::string> includeCacheOption(
+    "include-cache",
+    llvm::cl::desc("A file in which to cache the include graph used by "
+                   "-prune"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<std::string> pchCacheOption(
+    "pch-cache",
+    llvm::cl::desc("A directory in which to build and cache a precompiled "
+                   "header for the includes shared by all sources"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<bool> astFilesOption(
+    "ast-files",
+    llvm::cl::init(false),
+    llvm::cl::desc("Whether to search up-to-date .ast files emitted by the "
+                   "build instead of parsing sources"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<std::string> extdefMapOption(
+    "extdef-map",
+    llvm::cl::desc("An externalDefMap.txt (from clang-extdef-mapping) naming "
+                   "the file that defines the function"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<std::string> clangdIndexOption(
+    "clangd-index",
+    llvm::cl::desc("A clangd background index directory (e.g. "
+                   ".cache/clangd/index) to look the definition up in"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<bool> speculateOption(
+    "speculate",
+    llvm::cl::init(false),
+    llvm::cl::desc("Whether to parse candidate sources for the definition in "
+                   "the background while the call is still being parsed"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<unsigned> memoryBudgetOption(
+    "memory-budget",
+    llvm::cl::init(0),
+    llvm::cl::desc("The memory in MiB that background parses may take at "
+                   "once (default: derived from the cgroup or system limit)"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<std::string> parseHistoryOption(
+    "parse-history",
+    llvm::cl::desc("A file in which to remember what parsing each source "
+                   "cost (memory, time and includes)"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<std::string> shardOption(
+    "shard",
+    llvm::cl::desc("<index>/<count> of the shard of sources to search for the "
+                   "definition, for merging with --merge later"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::opt<unsigned> timeoutOption(
+    "timeout-ms",
+    llvm::cl::init(0),
+    llvm::cl::desc("How long the search may take in milliseconds, after which "
+                   "it returns what it found so far as partial"),
+    llvm::cl::cat(clangExpandCategory));
+
+llvm::cl::list<std::string> unsavedOption(
+    "unsaved",
+    llvm::cl::desc("<file>:<size> of a modified, unsaved file whose <size> "
+                   "bytes of contents follow on stdin"),
+    llvm::cl::cat(clangExpandCategory));
+
 llvm::cl::extrahelp
     commonHelp(clang::tooling::CommonOptionsParser::HelpMessage);
-}  // namespace
 
-auto main(int argc, const char* argv[]) -> int {
-  using namespace clang::tooling;  // NOLINT(build/namespaces)
+/// Produces the input of an invocation: stdin on the command line, or what the
+/// client sent along in server mode.
+using InputReader =
+    llvm::function_ref<llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>()>;
+
+/// Reads the contents of the files passed with `-unsaved=<file>:<size>` from
+/// the input, where they follow each other in the order of the options.
+llvm::Expected<llvm::StringMap<std::string>>
+readUnsavedFiles(InputReader readInput) {
+  using ClangExpand::Error;
+  using ClangExpand::ErrorKind;
+
+  llvm::StringMap<std::string> files;
+  if (unsavedOption.empty()) return std::move(files);
+
+  auto input = readInput();
+  if (!input) {
+    return llvm::make_error<Error>(ErrorKind::InvalidConfiguration,
+                                   "Could not read unsaved files from stdin: " +
+                                       input.getError().message());
+  }
+
+  auto remaining = (*input)->getBuffer();
+  for (const auto& argument : unsavedOption) {
+    const auto fileAndSize = llvm::StringRef(argument).rsplit(':');
+    std::size_t size;
+    if (fileAndSize.first.empty() ||
+        fileAndSize.second.getAsInteger(10, size)) {
+      return llvm::make_error<Error>(ErrorKind::InvalidConfiguration,
+                                     "Invalid -unsaved argument '" + argument +
+                                         "' (expected <file>:<size>)");
+    }
+    if (remaining.size() < size) {
+      return llvm::make_error<Error>(ErrorKind::InvalidConfiguration,
+                                     "Unexpected end of stdin reading " +
+                                         fileAndSize.first.str());
+    }
+
+    const auto file = fileAndSize.first.str();
+    const auto contents = remaining.take_front(size);
+    files[ClangExpand::Routines::makeAbsolute(file)] = contents;
+    remaining = remaining.drop_front(size);
+  }
+
+  return std::move(files);
+}
+
+/// Parses the `-shard=<index>/<count>` option into the query options.
+llvm::Error readShard(ClangExpand::Options& queryOptions) {
+  if (shardOption.empty()) return llvm::Error::success();
 
-  CommonOptionsParser options(argc, argv, clangExpandCategory);
-  const auto& sources = options.getSourcePathList();
+  const auto indexAndCount = llvm::StringRef(shardOption).split('/');
+  unsigned index, count;
+  if (indexAndCount.first.getAsInteger(10, index) ||
+      indexAndCount.second.getAsInteger(10, count) || index >= count) {
+    return llvm::make_error<ClangExpand::Error>(
+        ClangExpand::ErrorKind::InvalidConfiguration,
+        "Invalid -shard argument '" + shardOption +
+            "' (expected <index>/<count> with <index> < <count>)");
+  }
+
+  queryOptions.shardIndex = index;
+  queryOptions.shardCount = count;
+
+  return llvm::Error::success();
+}
+
+/// Runs the search described by the parsed command line and prints its
+/// result.
+llvm::Error
+expand(clang::tooling::CommonOptionsParser& options,
+       InputReader readInput,
+       llvm::IntrusiveRefCntPtr<ClangExpand::CachingFileSystem> fileSystem) {
+  using ClangExpand::Error;
+  using ClangExpand::ErrorKind;
+
+  auto sources = options.getSourcePathList();
   auto& db = options.getCompilations();
 
-  if (fileOption.empty()) {
-    fileOption = sources.front();
+  if (!sourcesFromOption.empty()) {
+    namespace Candidates = ClangExpand::DefinitionSearch::Candidates;
+    auto list = Candidates::readSourceList(sourcesFromOption);
+    if (!list) {
+      return llvm::make_error<Error>(ErrorKind::InvalidConfiguration,
+                                     "Could not read sources from " +
+                                         sourcesFromOption + ": " +
+                                         list.getError().message());
+    }
+    sources.insert(sources.end(), list->begin(), list->end());
+  }
+
+  auto file = fileOption.getValue();
+  if (file.empty()) {
+    if (sources.empty()) {
+      return llvm::make_error<Error>(ErrorKind::InvalidConfiguration,
+                                     "No -file and no sources given");
+    }
+    file = sources.front();
   }
 
   // clang-format off
-  ClangExpand::Search search(fileOption, lineOption, columnOption);
-  auto result = search.run(db, sources, {
+  ClangExpand::Options queryOptions = {
     callOption,
     declarationOption,
     definitionOption,
     rewriteOption
-  });
+  };
   // clang-format on
+  queryOptions.wantsStatistics = statisticsOption;
+  queryOptions.wantsByteOffsets =
+      positionsOption == ClangExpand::Offset::Encoding::Bytes;
+  queryOptions.wantsAllDefinitions = allDefinitionsOption;
+  queryOptions.searchAllSources = allSourcesOption;
+  queryOptions.pruneByIncludes = pruneOption;
+  queryOptions.includeGraphCache = includeCacheOption;
+  queryOptions.prefixHeaderCache = pchCacheOption;
+  queryOptions.useASTFiles = astFilesOption;
+  queryOptions.externalDefinitionMap = extdefMapOption;
+  queryOptions.clangdIndex = clangdIndexOption;
+  queryOptions.speculate = speculateOption;
+  queryOptions.memoryBudget = std::uint64_t{memoryBudgetOption} << 20;
+  queryOptions.parseHistory = parseHistoryOption;
+  queryOptions.timeout = std::chrono::milliseconds(timeoutOption);
+  if (auto error = readShard(queryOptions)) return std::move(error);
+
+  auto unsavedFiles = readUnsavedFiles(readInput);
+  if (!unsavedFiles) return unsavedFiles.takeError();
+  queryOptions.unsavedFiles = std::move(*unsavedFiles);
+
+  ClangExpand::Search search(file,
+                             lineOption,
+                             columnOption,
+                             std::move(fileSystem));
+
+  // Calls are printed as they are found, so that editors can show them while
+  // the rest of the project is still being scanned.
+  if (callersOption) {
+    auto onCall = [](llvm::StringRef filename,
+                     const ClangExpand::Range& range) {
+      // clang-format off
+      const nlohmann::json call = {
+        {"filename", filename.str()},
+        {"range", range.toJson()}
+      };
+      // clang-format on
+      llvm::outs() << call.dump() << '\n';
+      llvm::outs().flush();
+    };
+    auto count = search.findCallers(db, sources, queryOptions, onCall);
+    return count ? llvm::Error::success() : count.takeError();
+  }
+
+  // The replacements go to a file, the calls that were not expanded (and why)
+  // to stdout.
+  if (!expandAllOption.empty()) {
+    auto expansions = search.expandCallers(db, sources, queryOptions);
+    if (!expansions) return expansions.takeError();
+
+    std::error_code error;
+    llvm::raw_fd_ostream stream(expandAllOption, error, llvm::sys::fs::F_Text);
+    if (error) {
+      return llvm::make_error<Error>(ErrorKind::FileNotFound,
+                                     "Could not write " + expandAllOption +
+                                         ": " + error.message());
+    }
+    llvm::yaml::Output yaml(stream);
+    yaml << expansions->replacements;
+
+    llvm::outs() << expansions->toJson().dump(2) << '\n';
+
+    return llvm::Error::success();
+  }
+
+  auto result = search.run(db, sources, queryOptions);
+  if (!result) return result.takeError();
+
+  llvm::outs() << result->toJson().dump(2) << '\n';
+
+  return llvm::Error::success();
+}
+
+/// Parses the command line and runs clang-expand with it, printing the result
+/// to stdout and errors to stderr. Unlike `main`, this never exits, so that it
+/// can run many times in the same (server) process.
+int runCommandLine(
+    int argc,
+    const char** argv,
+    InputReader readInput,
+    llvm::IntrusiveRefCntPtr<ClangExpand::CachingFileSystem> fileSystem) {
+  using clang::tooling::CommonOptionsParser;
+
+  auto options = CommonOptionsParser::create(argc,
+                                             argv,
+                                             clangExpandCategory,
+                                             llvm::cl::ZeroOrMore);
+  if (!options) {
+    llvm::logAllUnhandledErrors(options.takeError(), llvm::errs(), "");
+    return EXIT_FAILURE;
+  }
+
+  if (auto error = expand(*options, readInput, std::move(fileSystem))) {
+    llvm::logAllUnhandledErrors(std::move(error), llvm::errs(), "");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/// Merges the results of a sharded search, read from the files (or stdin, for
+/// `-`), and prints the result of the whole search.
+int runMerge(llvm::ArrayRef<const char*> files) {
+  std::vector<nlohmann::json> shards;
+  for (const auto* file : files) {
+    auto buffer = llvm::MemoryBuffer::getFileOrSTDIN(file);
+    if (!buffer) {
+      llvm::errs() << "Could not read " << file << ": "
+                   << buffer.getError().message() << '\n';
+      return EXIT_FAILURE;
+    }
+    // Without exceptions, malformed JSON aborts the parser. These are files
+    // clang-expand wrote itself.
+    shards.emplace_back(nlohmann::json::parse((*buffer)->getBuffer().str()));
+  }
+
+  auto merged = ClangExpand::mergeShards(shards);
+  if (!merged) {
+    llvm::logAllUnhandledErrors(merged.takeError(), llvm::errs(), "");
+    return EXIT_FAILURE;
+  }
+
+  llvm::outs() << merged->dump(2) << '\n';
+
+  return EXIT_SUCCESS;
+}
+
+#if defined(CLANG_EXPAND_SERVER)
+/// How many sources of a project the server scans for hot headers.
+constexpr std::size_t warmUpSourceLimit = 4096;
+
+/// How many of the hottest headers of a project the server reads ahead.
+constexpr std::size_t hotHeaderLimit = 1024;
+
+/// Returns the build directory of a request: the value of its `-p` option,
+/// or else its working directory.
+std::string getBuildDirectory(const ClangExpand::Server::Request& request) {
+  llvm::StringRef directory = request.workingDirectory;
+  const auto& arguments = request.arguments;
+  for (std::size_t index = 0; index < arguments.size(); ++index) {
+    const llvm::StringRef argument(arguments[index]);
+    if ((argument == "-p" || argument == "--p") &&
+        index + 1 < arguments.size()) {
+      directory = arguments[index + 1];
+    } else if (argument.startswith("-p=") || argument.startswith("--p=")) {
+      directory = argument.split('=').second;
+    }
+  }
+
+  llvm::SmallString<256> path;
+  if (!llvm::sys::path::is_absolute(directory)) {
+    path = request.workingDirectory;
+  }
+  llvm::sys::path::append(path, directory);
+  llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+
+  return path.str();
+}
+
+/// Loads the compilation database found from the `directory` (if any) and
+/// reads the headers that its translation units include most into the
+/// `fileSystem`. Together with the sources scanned to find them, these stay
+/// cached for every request forked after this.
+void warmUp(const std::string& directory,
+            ClangExpand::CachingFileSystem& fileSystem) {
+  std::string message;
+  auto compilationDatabase =
+      clang::tooling::CompilationDatabase::autoDetectFromDirectory(directory,
+                                                                   message);
+  if (!compilationDatabase) return;
+
+  ClangExpand::DefinitionSearch::IncludeGraph includeGraph("", &fileSystem);
+  llvm::StringMap<unsigned> includers;
+  auto sources = compilationDatabase->getAllFiles();
+  if (sources.size() > warmUpSourceLimit) sources.resize(warmUpSourceLimit);
+  for (const auto& source : sources) {
+    const auto commands = compilationDatabase->getCompileCommands(source);
+    for (const auto& command : commands) {
+      for (const auto& header : includeGraph.getLeadingIncludes(command)) {
+        ++includers[header];
+      }
+    }
+  }
+
+  std::vector<std::pair<unsigned, llvm::StringRef>> headers;
+  for (const auto& entry : includers) {
+    headers.emplace_back(entry.getValue(), entry.getKey());
+  }
+  std::sort(headers.begin(), headers.end(), [](const auto& a, const auto& b) {
+    return a.first > b.first;
+  });
+  if (headers.size() > hotHeaderLimit) headers.resize(hotHeaderLimit);
+
+  for (const auto& header : headers) {
+    fileSystem.getCachedBuffer(header.second);
+  }
+}
+
+/// Answers requests forwarded by `clang-expand-client` until idle. The file
+/// system cache is shared by all requests, which is most of the point. In
+/// fork mode, every request runs in its own copy of this process instead, so
+/// the server itself reads the hot headers of each project it is asked about
+/// (starting with the one it was started in) before forking, for all
+/// requests to share.
+int runServer(const std::string& socketPath, ClangExpand::Server::Mode mode) {
+  llvm::IntrusiveRefCntPtr<ClangExpand::CachingFileSystem> fileSystem(
+      new ClangExpand::CachingFileSystem());
+
+  llvm::StringSet<> warmDirectories;
+  auto prepare = [&](const ClangExpand::Server::Request& request) {
+    const auto directory = getBuildDirectory(request);
+    if (!warmDirectories.insert(directory).second) return;
+    fileSystem->refresh();
+    warmUp(directory, *fileSystem);
+  };
+
+  if (mode == ClangExpand::Server::Mode::Fork) {
+    llvm::SmallString<256> workingDirectory;
+    if (!llvm::sys::fs::current_path(workingDirectory)) {
+      prepare({workingDirectory.str(), {}, {}});
+    }
+  }
+
+  auto handler = [&fileSystem](const ClangExpand::Server::Request& request) {
+    // Files may have changed since the last request.
+    fileSystem->refresh();
+
+    std::vector<const char*> argv = {"clang-expand"};
+    for (const auto& argument : request.arguments) {
+      argv.emplace_back(argument.c_str());
+    }
+
+    auto readInput = [&request] {
+      return llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>(
+          llvm::MemoryBuffer::getMemBuffer(request.input, "<stdin>", false));
+    };
+
+    return runCommandLine(static_cast<int>(argv.size()),
+                          argv.data(),
+                          readInput,
+                          fileSystem);
+  };
+
+  return ClangExpand::Server::serve(socketPath,
+                                    handler,
+                                    mode,
+                                    /*idleTimeoutSeconds=*/30 * 60,
+                                    prepare);
+}
+#endif
+}  // namespace
+
+auto main(int argc, const char* argv[]) -> int {
+  // Started by an editor, which speaks the language server protocol on stdio.
+  if (argc == 2 && llvm::StringRef(argv[1]) == "--lsp") {
+    return ClangExpand::LSP::LanguageServer().run(stdin, stdout);
+  }
+
+  // Combining the results of a sharded search parses nothing.
+  if (argc >= 2 && llvm::StringRef(argv[1]) == "--merge") {
+    return runMerge(llvm::makeArrayRef(argv + 2, argv + argc));
+  }
+
+#if defined(CLANG_EXPAND_SERVER)
+  // Started by clang-expand-client, which parses nothing itself.
+  if ((argc == 2 || argc == 3) &&
+      llvm::StringRef(argv[1]).startswith("--server=")) {
+    using ClangExpand::Server::Mode;
+    const auto socketPath = llvm::StringRef(argv[1]).drop_front(9).str();
+    if (argc == 2) return runServer(socketPath, Mode::InProcess);
+    if (llvm::StringRef(argv[2]) == "--fork") {
+      return runServer(socketPath, Mode::Fork);
+    }
+  }
+#endif
 
-  llvm::outs() << result.toJson().dump(2) << '\n';
+  return runCommandLine(argc,
+                        argv,
+                        llvm::MemoryBuffer::getSTDIN,
+                        new ClangExpand::CachingFileSystem());
 }
@@ -0,0 +1,165 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_CALLER_SEARCH_EXPANDER_HPP
+#define CLANG_EXPAND_CALLER_SEARCH_EXPANDER_HPP
+
+// Project includes
+#include "clang-expand/common/expansion-template.hpp"
+#include "clang-expand/common/range.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// Clang includes
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/Tooling/Core/Replacement.h>
+
+// LLVM includes
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTContext;
+class ASTUnit;
+class FunctionDecl;
+}
+
+namespace ClangExpand {
+struct Query;
+namespace CallerSearch {
+class Scanner;
+}
+}
+
+namespace ClangExpand {
+namespace CallerSearch {
+
+/// \ingroup CallerSearch
+///
+/// A call that was not expanded, and why.
+struct Refusal {
+  /// Converts the `Refusal` to JSON.
+  nlohmann::json toJson() const;
+
+  /// The real path of the file containing the call. Owned, since expansions
+  /// outlive the search and its `StringPool`.
+  std::string filename;
+
+  /// The range of the call.
+  Range range;
+
+  /// Why the call was not expanded, e.g. because it is nested in a condition.
+  std::string reason;
+};
+
+/// \ingroup CallerSearch
+///
+/// The outcome of expanding every call to a function.
+struct Expansions {
+  /// Converts the refused calls and the number of expanded calls to JSON. The
+  /// replacements themselves are written as YAML, for
+  /// `clang-apply-replacements`.
+  nlohmann::json toJson() const;
+
+  /// The replacements of all expanded calls, sorted by file and offset.
+  clang::tooling::TranslationUnitReplacements replacements;
+
+  /// The calls that were not expanded, sorted by file and position.
+  std::vector<Refusal> refusals;
+};
+
+/// \ingroup CallerSearch
+///
+/// Expands every call to the function of a query's `DeclarationData` in the
+/// ASTs a `Scanner` parses.
+///
+/// Each call is handled just like a call under the cursor in symbol search
+/// (see `SymbolSearch::collectMatch()`): its `CallData` and parameter map are
+/// collected, or the call is refused with the same reasons. The call is then
+/// spliced into an `ExpansionTemplate` of the definition, which is built once
+/// per definition: per translation unit if the call's own translation unit
+/// defines the function (e.g. inline in a header), or else once for the whole
+/// search from the translation unit defining it out of line, whose AST is
+/// dropped as soon as the template is built.
+class Expander {
+ public:
+  using MatchResult = clang::ast_matchers::MatchFinder::MatchResult;
+  using TemplateMap =
+      llvm::DenseMap<const clang::FunctionDecl*, ExpansionTemplate>;
+
+  /// Constructor, taking the ongoing query (with the declaration of the
+  /// function), the scanner that claims calls and the AST of the translation
+  /// unit defining the function out of line, which may be null.
+  Expander(const Query& query,
+           Scanner& scanner,
+           std::unique_ptr<clang::ASTUnit> definitionUnit);
+
+  /// Expands the calls in the AST that no other translation unit has claimed
+  /// yet. May be called for different ASTs concurrently.
+  void expandCalls(clang::ASTContext& context);
+
+  /// Returns the replacements and refusals of all calls so far, with the
+  /// `mainSourceFile` that `clang-apply-replacements` attributes them to.
+  Expansions takeExpansions(const std::string& mainSourceFile);
+
+ private:
+  /// Expands a matching call, with the templates of the definitions in its
+  /// translation unit.
+  void _expand(const MatchResult& result, TemplateMap& templates);
+
+  /// Records a refused call.
+  void _refuse(llvm::StringRef filename, Range range, std::string reason);
+
+  /// The ongoing query.
+  const Query& _query;
+
+  /// Claims calls, so that calls in headers are expanded once.
+  Scanner& _scanner;
+
+  /// The template of the definition in a translation unit of its own, if any.
+  llvm::Optional<ExpansionTemplate> _outOfLineTemplate;
+
+  /// Guards the `_replacements` and `_refusals`.
+  std::mutex _mutex;
+
+  /// The replacements of the expanded calls.
+  std::vector<clang::tooling::Replacement> _replacements;
+
+  /// The refused calls.
+  std::vector<Refusal> _refusals;
+};
+
+}  // namespace CallerSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_CALLER_SEARCH_EXPANDER_HPP
@@ -0,0 +1,92 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_CALLER_SEARCH_MATCH_HANDLER_HPP
+#define CLANG_EXPAND_CALLER_SEARCH_MATCH_HANDLER_HPP
+
+// Clang includes
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+
+// LLVM includes
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringRef.h>
+
+namespace clang {
+class ASTContext;
+class Expr;
+class SourceRange;
+}
+
+namespace ClangExpand {
+struct Query;
+struct Range;
+}
+
+namespace ClangExpand {
+namespace CallerSearch {
+
+/// \ingroup CallerSearch
+///
+/// The match handler of caller search.
+///
+/// The matcher only selects calls by the name of the callee, so this class
+/// checks that the callee is really the function of the query's
+/// `DeclarationData`, by comparing their USRs. Unlike names, contexts and
+/// parameter types, USRs see through overloads, templates and typedefs alike.
+class MatchHandler : public clang::ast_matchers::MatchFinder::MatchCallback {
+ public:
+  using MatchResult = clang::ast_matchers::MatchFinder::MatchResult;
+  using ReportFunction =
+      llvm::function_ref<void(llvm::StringRef, unsigned, const Range&)>;
+
+  /// Constructs the `MatchHandler` with the ongoing `Query` object and a
+  /// function to report each call with, by the real path of its file, the
+  /// offset of its beginning in that file and its range.
+  MatchHandler(const Query& query, ReportFunction report);
+
+  /// Returns the matcher for calls to functions of the query's name.
+  clang::ast_matchers::StatementMatcher getMatcher() const;
+
+  /// Runs the `MatchHandler` for a matching call.
+  void run(const MatchResult& result) override;
+
+ private:
+  /// The ongoing query object.
+  const Query& _query;
+
+  /// Reports a call.
+  ReportFunction _report;
+};
+
+/// \ingroup CallerSearch
+///
+/// Returns the range of the `call` as written in the file, i.e. at the
+/// expansion of any macro containing it, ending after its last token.
+clang::SourceRange getCallRange(const clang::Expr& call,
+                                const clang::ASTContext& context);
+
+}  // namespace CallerSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_CALLER_SEARCH_MATCH_HANDLER_HPP
@@ -0,0 +1,132 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_CALLER_SEARCH_SCANNER_HPP
+#define CLANG_EXPAND_CALLER_SEARCH_SCANNER_HPP
+
+// Project includes
+#include "clang-expand/definition-search/parse-pool.hpp"
+
+// Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+
+// LLVM includes
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clang {
+class ASTContext;
+namespace tooling {
+class CompilationDatabase;
+}
+}
+
+namespace ClangExpand {
+struct Query;
+struct Range;
+}
+
+namespace ClangExpand {
+namespace CallerSearch {
+
+/// \ingroup CallerSearch
+///
+/// Scans translation units for calls to the function of a query's
+/// `DeclarationData`.
+///
+/// All translation units are parsed concurrently, one per core, in a
+/// `DefinitionSearch::ParsePool` like speculative parses of definition search
+/// (estimated by the size of the source when they have no history yet). ASTs
+/// are dropped as soon as they have been scanned.
+///
+/// Calls in headers are found again in every translation unit including them,
+/// so they are reported (or `claim()`ed) only the first time.
+class Scanner {
+ public:
+  using CompilationDatabase = clang::tooling::CompilationDatabase;
+  using FileSystemPointer = llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>;
+  using SourceVector = std::vector<std::string>;
+  using CallFunction = llvm::function_ref<void(llvm::StringRef, const Range&)>;
+  using UnitFunction = llvm::function_ref<void(clang::ASTContext&)>;
+
+  /// Constructor, taking the compilation database, the file system to parse
+  /// with and the ongoing query, whose declaration must have been found.
+  Scanner(CompilationDatabase& compilationDatabase,
+          FileSystemPointer fileSystem,
+          const Query& query);
+
+  /// Scans the `sources` and calls `onCall` with the real path of the file and
+  /// the range of every call, as soon as it is found. `onCall` is never called
+  /// concurrently. Stops early when the query is cancelled.
+  ///
+  /// \returns The number of calls found.
+  unsigned scan(const SourceVector& sources, CallFunction onCall);
+
+  /// Parses the `sources` concurrently and calls `visit` with the AST of each,
+  /// on the thread that parsed it. Stops early when the query is cancelled.
+  void parseEach(const SourceVector& sources, UnitFunction visit);
+
+  /// Claims the call at the `offset` in the file with the real path
+  /// `filename`. Thread-safe.
+  ///
+  /// \returns True the first time the call is claimed, else false.
+  bool claim(llvm::StringRef filename, unsigned offset);
+
+ private:
+  /// Parses a source, once the budget admits it, and visits its AST.
+  void _parse(const DefinitionSearch::ParsePool::Job& job, UnitFunction visit);
+
+  /// The compilation database of the project.
+  CompilationDatabase& _compilationDatabase;
+
+  /// The file system to parse with.
+  FileSystemPointer _fileSystem;
+
+  /// The ongoing query.
+  const Query& _query;
+
+  /// Guards the `_claimed` calls.
+  std::mutex _mutex;
+
+  /// The calls claimed so far, by the real path of their file (interned in the
+  /// `StringPool`) and their offset in it.
+  std::set<std::pair<llvm::StringRef, unsigned>> _claimed;
+
+  /// Parses the sources. Declared last, so that its threads are joined before
+  /// anything they use is destroyed.
+  DefinitionSearch::ParsePool _pool;
+};
+
+}  // namespace CallerSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_CALLER_SEARCH_SCANNER_HPP
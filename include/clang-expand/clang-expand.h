@@ -0,0 +1,165 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_CLANG_EXPAND_H
+#define CLANG_EXPAND_CLANG_EXPAND_H
+
+/// \file
+/// The C interface of clang-expand, exported by `libclang-expand`.
+///
+/// This interface is meant for editor integrations that want to run many
+/// searches in one process (e.g. plugins written in C, or in Lua and Python
+/// through their foreign function interfaces). Only the functions declared
+/// here are exported, and they only use C types, so the interface stays stable
+/// across compilers and releases. Incompatible changes increase
+/// `CLANG_EXPAND_C_API_VERSION`.
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define CLANG_EXPAND_API __declspec(dllexport)
+#else
+#define CLANG_EXPAND_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// The version of this interface.
+#define CLANG_EXPAND_C_API_VERSION 1
+
+/// Flags for `clang_expand_session_create`.
+enum clang_expand_session_flags {
+  /// Search every source in the compilation database for definitions.
+  CLANG_EXPAND_SESSION_ALL_SOURCES = 0x1,
+
+  /// Skip sources that cannot include the file declaring the function.
+  CLANG_EXPAND_SESSION_PRUNE = 0x2
+};
+
+/// Flags for `clang_expand_query`, selecting what the result contains.
+enum clang_expand_query_flags {
+  CLANG_EXPAND_QUERY_CALL = 0x1,
+  CLANG_EXPAND_QUERY_DECLARATION = 0x2,
+  CLANG_EXPAND_QUERY_DEFINITION = 0x4,
+  CLANG_EXPAND_QUERY_REWRITE = 0x8,
+  CLANG_EXPAND_QUERY_STATISTICS = 0x10,
+  CLANG_EXPAND_QUERY_ALL_DEFINITIONS = 0x20,
+  CLANG_EXPAND_QUERY_BYTE_OFFSETS = 0x40,
+
+  /// What the `clang-expand` executable returns by default.
+  CLANG_EXPAND_QUERY_DEFAULT = 0xf
+};
+
+/// A session keeps the compilation database and file caches of a project
+/// alive across queries.
+typedef struct clang_expand_session clang_expand_session;
+
+/// The result of a query, as JSON.
+typedef struct clang_expand_result clang_expand_result;
+
+/// The contents of a file that was modified but not saved.
+typedef struct clang_expand_unsaved_file {
+  /// The path of the file.
+  const char* filename;
+
+  /// The contents of the file (not necessarily null-terminated).
+  const char* contents;
+
+  /// The length of the `contents` in bytes.
+  size_t length;
+} clang_expand_unsaved_file;
+
+/// Returns `CLANG_EXPAND_C_API_VERSION` as it was when the library was built.
+CLANG_EXPAND_API unsigned clang_expand_get_version(void);
+
+/// Creates a session for the project whose compilation database
+/// (`compile_commands.json`) is in the `build_directory`.
+///
+/// The `num_sources` paths in `sources` are searched for definitions in
+/// addition to those selected by the `flags` (a combination of
+/// `clang_expand_session_flags`).
+///
+/// Returns null if the compilation database could not be loaded.
+CLANG_EXPAND_API clang_expand_session*
+clang_expand_session_create(const char* build_directory,
+                            const char* const* sources,
+                            unsigned num_sources,
+                            unsigned flags);
+
+/// Destroys a session. No query may be running on it.
+CLANG_EXPAND_API void clang_expand_session_dispose(
+    clang_expand_session* session);
+
+/// Expands the function call at the given `line` and `column` (both starting
+/// at one) of the `file`.
+///
+/// The `flags` (a combination of `clang_expand_query_flags`) select what the
+/// result contains. The `num_unsaved_files` files in `unsaved_files` are used
+/// instead of their versions on disk.
+///
+/// Queries of one session run one at a time; concurrent calls block.
+///
+/// Never returns null. The result must be freed with
+/// `clang_expand_result_dispose`.
+CLANG_EXPAND_API clang_expand_result*
+clang_expand_query(clang_expand_session* session,
+                   const char* file,
+                   unsigned line,
+                   unsigned column,
+                   unsigned flags,
+                   const clang_expand_unsaved_file* unsaved_files,
+                   unsigned num_unsaved_files);
+
+/// Limits how long each query on the session may take, in `milliseconds`
+/// (zero, the default, for no limit). A query that runs past its limit
+/// returns what it found so far, with `"partial": true` in its JSON. May be
+/// called from any thread; the limit applies to queries started afterwards.
+CLANG_EXPAND_API void clang_expand_session_set_timeout(
+    clang_expand_session* session, unsigned milliseconds);
+
+/// Cancels the query currently running on the session, if any, which then
+/// returns an error of kind "cancelled". May be called from any thread.
+CLANG_EXPAND_API void clang_expand_cancel(clang_expand_session* session);
+
+/// Returns non-zero if the query failed, else zero.
+CLANG_EXPAND_API int clang_expand_result_is_error(
+    const clang_expand_result* result);
+
+/// Returns the result as a null-terminated JSON string. This is the same JSON
+/// the `clang-expand` executable prints or, if the query failed, an object of
+/// the form `{"error": {"kind": ..., "message": ...}}`. The string is owned by
+/// the result.
+CLANG_EXPAND_API const char* clang_expand_result_get_json(
+    const clang_expand_result* result);
+
+/// Frees a result.
+CLANG_EXPAND_API void clang_expand_result_dispose(clang_expand_result* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CLANG_EXPAND_CLANG_EXPAND_H
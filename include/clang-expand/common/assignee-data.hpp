@@ -34,6 +34,8 @@
 #include <string>
 
 namespace ClangExpand {
+class StringPool;
+
 /// Stores information about the assignee of a call expression.
 ///
 /// In `int x = f(5);`, the variable `x` is the *assignee*.
@@ -46,12 +48,13 @@ class AssigneeData {
 
   /// Stores information about the type of the assignee.
   struct Type {
-    /// Constructor.
-    explicit Type(std::string name_ = std::string(),
-                  bool isDefaultConstructible_ = true) noexcept;
+    /// Constructor, taking an interned name.
+    explicit Type(llvm::StringRef name_ = llvm::StringRef(),
+                  bool isDefaultConstructible_ = true);
 
-    /// A string representation of the type.
-    std::string name;
+    /// A string representation of the type, interned in the `StringPool` of
+    /// the `Builder`.
+    llvm::StringRef name;
 
     /// Whether the type is default constructible or not.
     bool isDefaultConstructible;
@@ -114,8 +117,9 @@ class AssigneeData {
   /// The operator used in the assignment (`=`, `+=`, `<<=` etc.).
   OperatorString op;
 
-  /// The name of the variable being assigned to.
-  std::string name;
+  /// The name of the variable being assigned to, interned in the
+  /// `StringPool`.
+  llvm::StringRef name;
 
   /// If the assignment is a variable declaration and not just an assignment,
   /// the type of the variable being declared. The type is further split into
@@ -127,8 +131,10 @@ class AssigneeData {
 /// Helper class to build an `AssigneeData` structure.
 class AssigneeData::Builder {
  public:
-  /// Constructs a new builder with a temporary `AssigneeData` instance.
-  explicit Builder(AssigneeData&& assignee = AssigneeData());
+  /// Constructs a new builder with a temporary `AssigneeData` instance, whose
+  /// names are interned in the `strings`.
+  explicit Builder(StringPool& strings,
+                   AssigneeData&& assignee = AssigneeData());
   Builder(const Builder&) = delete;
   Builder& operator=(const Builder&) = delete;
 
@@ -148,6 +154,9 @@ class AssigneeData::Builder {
  private:
   /// The `AssigneeData` being built.
   AssigneeData _assignee;
+
+  /// The pool to intern names in.
+  StringPool& _strings;
 };
 
 }  // namespace ClangExpand
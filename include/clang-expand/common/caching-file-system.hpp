@@ -0,0 +1,163 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_COMMON_CACHING_FILE_SYSTEM_HPP
+#define CLANG_EXPAND_COMMON_CACHING_FILE_SYSTEM_HPP
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+
+// LLVM includes
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/ErrorOr.h>
+
+// Standard includes
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+namespace llvm {
+class MemoryBuffer;
+class Twine;
+}
+
+namespace ClangExpand {
+
+/// A thread-safe `clang::vfs::FileSystem` that caches `stat` results and file
+/// contents of an underlying file system.
+///
+/// Every translation unit we parse re-stats and re-reads the same common
+/// headers (the standard library, base libraries, generated code). Sharing one
+/// `CachingFileSystem` between all `clang::tooling::ClangTool`s of a search
+/// collapses that I/O to a single `stat` and a single read per file. Failed
+/// lookups are cached too, since header search produces a lot of them.
+///
+/// Cached buffers are owned by the file system and handed out as non-owning
+/// `llvm::MemoryBuffer`s, so the file system must outlive every
+/// `clang::SourceManager` that uses it. This is guaranteed as long as it is
+/// only accessed through reference counted pointers. Since the buffers are
+/// shared and stay put, they are tracked by `LineTable`, which memoizes their
+/// lines for all translation units.
+class CachingFileSystem : public clang::vfs::FileSystem {
+ public:
+  using FileSystemPointer = llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>;
+
+  /// Hit and miss counters of the cache.
+  struct Statistics {
+    /// Converts the `Statistics` to JSON.
+    nlohmann::json toJson() const;
+
+    /// The number of `stat` calls answered from the cache.
+    std::size_t statHits;
+
+    /// The number of `stat` calls forwarded to the underlying file system.
+    std::size_t statMisses;
+
+    /// The number of file reads answered from the cache.
+    std::size_t readHits;
+
+    /// The number of file reads forwarded to the underlying file system.
+    std::size_t readMisses;
+  };
+
+  /// Constructor, taking the file system whose results to cache.
+  explicit CachingFileSystem(
+      FileSystemPointer underlying = clang::vfs::getRealFileSystem());
+
+  /// Destructor, dropping the `LineTable`s of the cached buffers.
+  ~CachingFileSystem() override;
+
+  /// Returns the (possibly cached) status of a file.
+  llvm::ErrorOr<clang::vfs::Status> status(const llvm::Twine& path) override;
+
+  /// Opens a file whose status and contents are served from the cache.
+  llvm::ErrorOr<std::unique_ptr<clang::vfs::File>>
+  openFileForRead(const llvm::Twine& path) override;
+
+  /// Forwards to the underlying file system. Directory listings are not
+  /// cached.
+  clang::vfs::directory_iterator dir_begin(const llvm::Twine& directory,
+                                           std::error_code& error) override;
+
+  /// Forwards to the underlying file system.
+  llvm::ErrorOr<std::string> getCurrentWorkingDirectory() const override;
+
+  /// Forwards to the underlying file system. Cache entries are keyed by
+  /// absolute path, so changing the working directory does not invalidate
+  /// them.
+  std::error_code setCurrentWorkingDirectory(const llvm::Twine& path) override;
+
+  /// Returns the contents of a file, reading it only if it is not cached yet.
+  /// The returned buffer does not own its memory.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+  getCachedBuffer(const llvm::Twine& path, bool requiresNullTerminator = true);
+
+  /// Returns a snapshot of the hit and miss counters.
+  Statistics getStatistics() const noexcept;
+
+  /// Evicts every entry whose file changed (or appeared or vanished) since it
+  /// was cached, so that the cache can be kept across searches. This costs one
+  /// `stat` per cached path. Since evicted buffers are freed, this must not be
+  /// called while any clang tool is using the file system.
+  void refresh();
+
+ private:
+  /// Makes a path absolute w.r.t. the current working directory, to use it
+  /// as a cache key.
+  std::string _makeKey(const llvm::Twine& path) const;
+
+  /// The file system whose results we cache.
+  FileSystemPointer _underlying;
+
+  /// Guards `_statuses` and `_buffers`.
+  mutable std::mutex _mutex;
+
+  /// Cached `stat` results, including failures.
+  llvm::StringMap<llvm::ErrorOr<clang::vfs::Status>> _statuses;
+
+  /// Cached file contents. Always null-terminated.
+  llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>> _buffers;
+
+  /// Counter for `Statistics::statHits`.
+  std::atomic<std::size_t> _statHits{0};
+
+  /// Counter for `Statistics::statMisses`.
+  std::atomic<std::size_t> _statMisses{0};
+
+  /// Counter for `Statistics::readHits`.
+  std::atomic<std::size_t> _readHits{0};
+
+  /// Counter for `Statistics::readMisses`.
+  std::atomic<std::size_t> _readMisses{0};
+};
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_COMMON_CACHING_FILE_SYSTEM_HPP
@@ -0,0 +1,62 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_COMMON_CANCELLATION_TOKEN_HPP
+#define CLANG_EXPAND_COMMON_CANCELLATION_TOKEN_HPP
+
+// Standard includes
+#include <atomic>
+
+namespace ClangExpand {
+/// A flag through which one thread can ask a search running on another thread
+/// to stop.
+///
+/// Cancellation is cooperative: the search checks the token between
+/// translation units and top-level declarations and gives up with an
+/// `ErrorKind::Cancelled` error. Only translation units parsed in the
+/// background (see `DefinitionSearch::Speculation`) are still finished.
+class CancellationToken {
+ public:
+  /// Requests cancellation. May be called from any thread.
+  void cancel() noexcept {
+    _cancelled.store(true, std::memory_order_relaxed);
+  }
+
+  /// Withdraws any request for cancellation, so the token can be reused.
+  void reset() noexcept {
+    _cancelled.store(false, std::memory_order_relaxed);
+  }
+
+  /// \returns True if cancellation was requested, else false.
+  bool isCancelled() const noexcept {
+    return _cancelled.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /// Whether cancellation was requested.
+  std::atomic<bool> _cancelled{false};
+};
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_COMMON_CANCELLATION_TOKEN_HPP
@@ -25,6 +25,9 @@
 #ifndef CLANG_EXPAND_COMMON_CANONICAL_LOCATION_HPP
 #define CLANG_EXPAND_COMMON_CANONICAL_LOCATION_HPP
 
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+
 namespace clang {
 class FileEntry;
 class SourceLocation;
@@ -32,6 +35,7 @@ class SourceManager;
 }
 
 namespace ClangExpand {
+class StringPool;
 
 /// A location structure that always compares equal for identical offset.
 ///
@@ -50,6 +54,12 @@ struct CanonicalLocation {
   /// Tests two `CanonicalLocation`s for inequality.
   bool operator!=(const CanonicalLocation& other) const noexcept;
 
+  /// Returns the absolute, real path of the file. Unlike the `file` entry,
+  /// which belongs to the file manager of one translation unit, this also
+  /// identifies the file across translation units. The path is interned in the
+  /// `strings`, so locations in the same file share it.
+  llvm::StringRef getFilename(StringPool& strings) const;
+
   /// The file entry of the location.
   const clang::FileEntry* file;
 
@@ -25,15 +25,15 @@
 #ifndef CLANG_EXPAND_COMMON_CONTEXT_DATA_HPP
 #define CLANG_EXPAND_COMMON_CONTEXT_DATA_HPP
 
+// Project includes
+#include "clang-expand/common/string-pool.hpp"
+
 // Clang includes
 #include <clang/AST/DeclBase.h>
 
 // LLVM includes
 #include <llvm/ADT/StringRef.h>
 
-// Standard includes
-#include <string>
-
 namespace ClangExpand {
 
 /// Stores information about a context (namespace, class name etc.).
@@ -42,16 +42,19 @@ namespace ClangExpand {
 /// (`namespace X { struct X {}; }`), so we can't just store the name, we also
 /// need the `Decl::Kind`.
 struct ContextData {
-  /// Constructor.
-  ContextData(clang::Decl::Kind kind_, const llvm::StringRef& name_)
-  : kind(kind_), name(name_.str()) {
+  /// Constructor, interning the name in the `strings`.
+  ContextData(clang::Decl::Kind kind_,
+              const llvm::StringRef& name_,
+              StringPool& strings)
+  : kind(kind_), name(strings.intern(name_)) {
   }
 
   /// The `clang::Decl::Kind` of the context (usually CXXRecord or Namespace).
   clang::Decl::Kind kind;
 
-  /// The name of the context (class, namespace etc.).
-  std::string name;
+  /// The name of the context (class, namespace etc.), interned in the
+  /// `StringPool`.
+  llvm::StringRef name;
 };
 }  // namespace ClangExpand
 
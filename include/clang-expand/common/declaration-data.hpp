@@ -35,6 +35,7 @@
 // LLVM includes
 #include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
 
 // Standard includes
 #include <string>
@@ -48,14 +49,16 @@ namespace ClangExpand {
 struct DeclarationData {
   using ParameterMap = llvm::StringMap<std::string>;
 
-  /// Constructor.
-  explicit DeclarationData(std::string name_, Location location_);
+  /// Constructor, interning the name in the `strings`.
+  DeclarationData(llvm::StringRef name_,
+                  Location location_,
+                  StringPool& strings);
 
   /// Converts the `DeclarationData` to JSON.
   nlohmann::json toJson() const;
 
-  /// The name of the function (or operator).
-  std::string name;
+  /// The name of the function (or operator), interned in the `StringPool`.
+  llvm::StringRef name;
 
   /// The raw source text of the entire function declaration.
   ///
@@ -89,8 +92,8 @@ struct DeclarationData {
   /// `parameter->getOriginalType().getCanonicalType().getAsString(policy)`,
   /// where `parameter` is a `ParmVarDecl` and `policy` is an appropriate
   /// `PrintingPolicy` retrieved from the `ASTContext` that stores the full
-  /// qualification of the name.
-  llvm::SmallVector<std::string, 8> parameterTypes;
+  /// qualification of the name. The strings are interned in the `StringPool`.
+  llvm::SmallVector<llvm::StringRef, 8> parameterTypes;
 
   /// The mapping from parameter names to respective argument expressions.
   ///
@@ -107,6 +110,13 @@ struct DeclarationData {
   /// function can be replaced with `1` and `g(2)`, respectively.
   ParameterMap parameterMap;
 
+  /// The Unified Symbol Resolution (USR) of the function, as generated by
+  /// `clang::index::generateUSRForDecl`. Empty if no USR could be generated.
+  /// This is the key used by clang's cross translation unit tooling (e.g. the
+  /// external definition maps produced by `clang-extdef-mapping`). Interned in
+  /// the `StringPool`.
+  llvm::StringRef usr;
+
   /// The location of the function declaration (right at the name of the
   /// function).
   Location location;
@@ -31,6 +31,9 @@
 // Third party includes
 #include <third-party/json.hpp>
 
+// LLVM includes
+#include <llvm/Support/Error.h>
+
 // Standard includes
 #include <string>
 
@@ -47,9 +50,13 @@ struct DefinitionData {
   /// Collects the entire `DefinitionData` for the function. The `query` passed
   /// should already have been through symbol search and must store `CallData`
   /// and `DeclarationData`.
-  static DefinitionData Collect(const clang::FunctionDecl& function,
-                                clang::ASTContext& context,
-                                const Query& query);
+  ///
+  /// \returns An error if the definition cannot be rewritten for the context
+  /// of the call.
+  static llvm::Expected<DefinitionData>
+  Collect(const clang::FunctionDecl& function,
+          clang::ASTContext& context,
+          const Query& query);
 
   /// Converts the `DefinitionData` to JSON.
   nlohmann::json toJson() const;
@@ -25,36 +25,35 @@
 #ifndef CLANG_EXPAND_COMMON_DEFINITION_REWRITER_HPP
 #define CLANG_EXPAND_COMMON_DEFINITION_REWRITER_HPP
 
+// Project includes
+#include "clang-expand/common/expansion-template.hpp"
+
 // Clang includes
 #include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/Basic/SourceLocation.h>
 
 // LLVM includes
 #include <llvm/ADT/SmallPtrSet.h>
-#include <llvm/ADT/SmallVector.h>
-#include <llvm/ADT/StringMap.h>
-
-// Standard includes
-#include <iosfwd>
 
 namespace clang {
 class ASTContext;
 class Rewriter;
 class Stmt;
-class SourceLocation;
 class MemberExpr;
 class ReturnStmt;
 }
 
 namespace ClangExpand {
-struct CallData;
 
-/// Class to rewrite a function body for expansion purposes.
+/// Class to record the holes of an `ExpansionTemplate` in a function body.
 ///
 /// This class performs the heavy lifting in terms of rewriting a function body.
-/// It rewrites `return` statements to assignments (under certain
-/// circumstances), prefixes member expressions with their base objects and most
-/// importantly replaces parameter references with the passed argument
-/// expressions.
+/// It finds `return` statements (to be rewritten to assignments), member
+/// expressions (to be prefixed with their base objects), template parameters
+/// (to be substituted) and most importantly references to parameters (to be
+/// replaced with the passed argument expressions). Rather than rewriting these
+/// for one particular call, it records their ranges in an `ExpansionTemplate`,
+/// into which any number of calls can then be spliced.
 ///
 /// This class only stores references to the objects it is constructed with. It
 /// should therefore not be stored, but used just like a function call with all
@@ -63,12 +62,12 @@ class DefinitionRewriter
     : public clang::RecursiveASTVisitor<DefinitionRewriter> {
  public:
   using super = clang::RecursiveASTVisitor<DefinitionRewriter>;
-  using ParameterMap = llvm::StringMap<std::string>;
 
-  /// Constructor.
-  explicit DefinitionRewriter(clang::Rewriter& rewriter,
-                              const ParameterMap& parameterMap,
-                              const CallData& call,
+  /// Constructor, taking the template to record holes in, whose `body` must
+  /// begin at `bodyBegin`, and a rewriter to measure source ranges with.
+  explicit DefinitionRewriter(ExpansionTemplate& expansionTemplate,
+                              const clang::SourceLocation& bodyBegin,
+                              clang::Rewriter& rewriter,
                               clang::ASTContext& context);
 
   /// Traverses the body of a function to rewrite.
@@ -78,64 +77,47 @@ class DefinitionRewriter
   /// parameters.
   bool VisitTypeLoc(clang::TypeLoc typeLocation);
 
-  /// Rewrites all `return` statements to assignments, according to the stored
-  /// `CallData`. `return` statement locations are stored during the traversal
-  /// in `VisitStmt`. After this is done, this method can be called to actually
-  /// replace each `return <something>` statement to `<variable> = <something>`.
-  ///
-  /// There are two required preconditions to calling this method:
-  ///
-  /// 1. The `assignee` member of the `CallData` must not be nullopt`.
-  /// 2. There must be at least one return statement in the body of
-  /// the function. This invariant *should* follow from (1), since there
-  /// *should* be no assignee if there is no return statement.
-  ///
-  /// \returns True if it is necessary to prepend a declaration of the assignee
-  /// to the function body (depending on the number of return statements), else
-  /// false.
-  bool rewriteReturnsToAssignments(const clang::Stmt& body);
+  /// Sorts the recorded holes and drops any that overlap an earlier one (such
+  /// as the same node visited twice). Must be called after traversal.
+  void finish();
 
  private:
-  /// Stores the location of a return statement for later use. Once all return
-  /// locations have been collected like this, `rewriteReturnsToAssignments` can
-  /// later be called to perform the actual replacements.
-  void _recordReturn(const clang::ReturnStmt& returnStatement,
-                     const CallData& call);
-
-  /// Replaces a single return location with the given text. The location should
-  /// probably come out of `_returnLocations`.
-  void _rewriteReturn(const clang::SourceLocation& begin,
-                      const std::string& replacement);
-
-  /// Handles rewriting a member expression. This is needed when the function
-  /// being rewritten is a method. In that case we need to prefix every
-  /// reference to a field or method with the base of the function (e.g. the 'x'
-  /// in `x.foo()`).
-  void _rewriteMemberExpression(const clang::MemberExpr& member);
-
-  void _rewriteNonTypeTemplateParameterExpression(
+  /// Records the `return` keyword of a return statement, which is rewritten
+  /// to an assignment for calls with an assignee.
+  void _recordReturn(const clang::ReturnStmt& returnStatement);
+
+  /// Records a member expression accessed through `this`. This is needed when
+  /// the function being rewritten is a method. In that case we need to prefix
+  /// every reference to a field or method with the base of the call (e.g. the
+  /// 'x' in `x.foo()`).
+  void _recordMemberExpression(const clang::MemberExpr& member);
+
+  /// Records a non-type template parameter with an integer value, which is
+  /// substituted with the value.
+  void _recordNonTypeTemplateParameterExpression(
       const clang::SubstNonTypeTemplateParmExpr& nonType);
 
-  /// A rewriter to mess with the source text.
-  clang::Rewriter& _rewriter;
+  /// Records a hole of `length` characters at the `location`, unless it is not
+  /// a location in the body (e.g. inside a macro).
+  void _addHole(ExpansionTemplate::Hole hole,
+                const clang::SourceLocation& location,
+                int length);
 
-  /// A reference to a parameter map, for replacing parameter uses with argument
-  /// expressions.
-  const ParameterMap& _parameterMap;
+  /// The template to record holes in.
+  ExpansionTemplate& _template;
 
-  /// A reference to a `CallData` structure.
-  const CallData& _call;
+  /// The location at which the `body` of the template begins.
+  clang::SourceLocation _bodyBegin;
+
+  /// A rewriter to measure source ranges with, just as it would replace them.
+  clang::Rewriter& _rewriter;
 
   /// The current `clang::ASTContext`.
   clang::ASTContext& _context;
 
-  /// Stores members we have rewritten, because sometimes they are encountered
+  /// Stores members we have recorded, because sometimes they are encountered
   /// twice inside `VisitStmt` (dunno why).
-  llvm::SmallPtrSet<const clang::MemberExpr*, 16> _rewrittenMembers;
-
-  /// Stores the locations of return statements (at the 'r') so we can later
-  /// rewrite them.
-  llvm::SmallVector<clang::SourceLocation, 8> _returnLocations;
+  llvm::SmallPtrSet<const clang::MemberExpr*, 16> _recordedMembers;
 };
 }  // namespace ClangExpand
 
@@ -0,0 +1,117 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_COMMON_EXPANSION_TEMPLATE_HPP
+#define CLANG_EXPAND_COMMON_EXPANSION_TEMPLATE_HPP
+
+// LLVM includes
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTContext;
+class FunctionDecl;
+}
+
+namespace ClangExpand {
+struct CallData;
+
+/// The body of a function, prepared for expansion at any number of calls.
+///
+/// Expanding a call replaces references to parameters with the arguments,
+/// prefixes members accessed through `this` with the base of the call,
+/// substitutes template parameters and rewrites `return` statements to
+/// assignments. Of these, only the arguments, the base and the assignee depend
+/// on the call. An `ExpansionTemplate` therefore stores the text of the body
+/// once, together with the ranges ("holes") of everything a call may replace,
+/// as recorded by a single traversal of the body with the
+/// `DefinitionRewriter`. Each call is then expanded by splicing its text into
+/// the holes, which is linear string work without the AST.
+struct ExpansionTemplate {
+  using ParameterMap = llvm::StringMap<std::string>;
+
+  /// What a hole is filled with.
+  enum class HoleKind {
+    /// The argument for the parameter named by the hole's `text`.
+    Parameter,
+
+    /// The base of the call, replacing any `this->` before a member.
+    Member,
+
+    /// An assignment to the assignee, replacing the `return` keyword.
+    Return,
+
+    /// The hole's `text`, for a template parameter of an instantiation.
+    Substitution
+  };
+
+  /// A range of the body that may be replaced when expanding a call.
+  struct Hole {
+    /// The offset of the hole into the `body`.
+    unsigned offset;
+
+    /// The length of the original text of the hole, which is zero for members
+    /// accessed implicitly.
+    unsigned length;
+
+    /// What the hole is filled with.
+    HoleKind kind;
+
+    /// The name of the parameter, or the text substituted for a template
+    /// parameter.
+    std::string text;
+
+    /// For returns, whether the statement is directly in the body of the
+    /// function, which allows initializing the assignee with it.
+    bool isTopLevel{false};
+  };
+
+  /// Builds the template for the body of the function, which must have one.
+  static ExpansionTemplate
+  Build(const clang::FunctionDecl& function, clang::ASTContext& context);
+
+  /// Expands a call with the `parameterMap` (mapping parameter names to
+  /// argument expressions) and the `call`'s base and assignee.
+  ///
+  /// \returns The rewritten body (as in `DefinitionData::rewritten`), or an
+  /// error if the function cannot be rewritten for the context of the call.
+  llvm::Expected<std::string> instantiate(const ParameterMap& parameterMap,
+                                          const CallData& call) const;
+
+  /// The text between the braces of the body.
+  std::string body;
+
+  /// The holes in the `body`, sorted by offset and not overlapping.
+  std::vector<Hole> holes;
+
+  /// The number of `Return` holes.
+  unsigned returnCount{0};
+};
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_COMMON_EXPANSION_TEMPLATE_HPP
@@ -0,0 +1,83 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_COMMON_LINE_TABLE_HPP
+#define CLANG_EXPAND_COMMON_LINE_TABLE_HPP
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace ClangExpand {
+
+/// The offsets at which the lines of a file begin, to convert byte offsets
+/// into `(line, column)` pairs.
+///
+/// `clang::SourceManager` builds such a table for every file it is asked for a
+/// line number in, once per translation unit. Batch searches report positions
+/// in the same (often generated, multi-megabyte) headers from thousands of
+/// translation units, so we build the table once per file instead, scanning
+/// for line breaks sixteen bytes at a time where SSE2 is available. Lines end
+/// at `\n`, `\r`, `\r\n` or `\n\r`, like they do for clang.
+///
+/// Tables are memoized only for buffers registered with `track()`. These are
+/// the file contents cached by a `CachingFileSystem`, which every translation
+/// unit of a search shares and which stay put until they are `forget()`ten.
+class LineTable {
+ public:
+  using TablePointer = std::shared_ptr<const LineTable>;
+
+  /// Constructor, scanning the `buffer` for the beginnings of its lines.
+  explicit LineTable(llvm::StringRef buffer);
+
+  /// Returns the 1-indexed line and column of a byte `offset` into the buffer.
+  /// Like clang's, columns count bytes, not characters.
+  std::pair<unsigned, unsigned> getLineAndColumn(unsigned offset) const;
+
+  /// Returns the number of lines in the buffer.
+  unsigned getLineCount() const noexcept;
+
+  /// Returns the table of a tracked `buffer`, building it the first time it is
+  /// asked for. Null if the buffer is not tracked. Thread-safe.
+  static TablePointer find(llvm::StringRef buffer);
+
+  /// Allows memoizing the table of the `buffer`, whose memory must neither
+  /// move nor change until it is forgotten. Thread-safe.
+  static void track(llvm::StringRef buffer);
+
+  /// Drops the `buffer` and its table, before its memory is freed.
+  /// Thread-safe.
+  static void forget(llvm::StringRef buffer);
+
+ private:
+  /// The offsets at which the lines begin, zero for the first.
+  std::vector<unsigned> _lineStarts;
+};
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_COMMON_LINE_TABLE_HPP
@@ -34,15 +34,13 @@
 // LLVM includes
 #include <llvm/ADT/StringRef.h>
 
-// Standard includes
-#include <string>
-
 namespace clang {
 class SourceLocation;
 class SourceManager;
 }
 
 namespace ClangExpand {
+class StringPool;
 
 /// An easier-to-use representaiton of a source location.
 ///
@@ -56,18 +54,26 @@ namespace ClangExpand {
 /// lot when doing our processing as well as for final output to stdout.
 struct Location {
   /// Constructs a `Location` from a `clang::SourceLocation` using the source
-  /// manager.
+  /// manager, with its offset in the given `encoding`. The filename is
+  /// interned in the `strings`.
   Location(const clang::SourceLocation& location,
-           const clang::SourceManager& sourceManager);
+           const clang::SourceManager& sourceManager,
+           StringPool& strings,
+           Offset::Encoding encoding = Offset::Encoding::LineColumn);
 
-  /// Constructs a `Location` from a filename and `(line, column)` pair.
-  Location(const llvm::StringRef& filename_, unsigned line, unsigned column);
+  /// Constructs a `Location` from a filename and `(line, column)` pair. The
+  /// filename is interned in the `strings`.
+  Location(const llvm::StringRef& filename_,
+           unsigned line,
+           unsigned column,
+           StringPool& strings);
 
   /// Converts the `Location` to JSON.
   nlohmann::json toJson() const;
 
-  /// The name of the file this location is from.
-  std::string filename;
+  /// The name of the file this location is from, interned in the
+  /// `StringPool`.
+  llvm::StringRef filename;
 
   /// The offset into the file (a `(line, column)` pair).
   Offset offset;
@@ -36,22 +36,39 @@ class SourceManager;
 namespace ClangExpand {
 /// An offset into a file, represented by a `(line, column)` pair. Both the line
 /// and the column start are 1-indexed, as they are in clang.
+///
+/// Alternatively, the offset may be represented by the number of bytes before
+/// it in the file. Finding the line of a location makes the source manager
+/// build a table of all lines in its file, which byte offsets do without.
 struct Offset {
-  /// Constructs an `Offset` by converting a `clang::SourceLocation`.
+  /// How an `Offset` represents its position in the file.
+  enum class Encoding { LineColumn, Bytes };
+
+  /// Constructs an `Offset` by converting a `clang::SourceLocation`, to a
+  /// `(line, column)` pair or a byte offset depending on the `encoding_`.
   Offset(const clang::SourceLocation& location,
-         const clang::SourceManager& sourceManager);
+         const clang::SourceManager& sourceManager,
+         Encoding encoding_ = Encoding::LineColumn);
 
   /// Constructor.
   Offset(unsigned line_, unsigned column_);
 
-  /// Converts the `Offset` to JSON.
+  /// Converts the `Offset` to JSON: an object with the line and column, or
+  /// just the byte offset (a number) with `Encoding::Bytes`.
   nlohmann::json toJson() const;
 
-  /// The 1-indexed line (row) of the location.
+  /// The 1-indexed line (row) of the location. Zero with `Encoding::Bytes`.
   unsigned line;
 
-  /// The 1-indexed column (offset into the line) of the loction.
+  /// The 1-indexed column (offset into the line) of the loction. Zero with
+  /// `Encoding::Bytes`.
   unsigned column;
+
+  /// The 0-indexed byte offset into the file. Only set with `Encoding::Bytes`.
+  unsigned byte{0};
+
+  /// Whether the `line` and `column` or the `byte` offset are set.
+  Encoding encoding{Encoding::LineColumn};
 };
 }  // namespace ClangExpand
 
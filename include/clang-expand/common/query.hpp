@@ -27,12 +27,25 @@
 
 // Project includes
 #include "clang-expand/common/call-data.hpp"
+#include "clang-expand/common/cancellation-token.hpp"
 #include "clang-expand/common/declaration-data.hpp"
 #include "clang-expand/common/definition-data.hpp"
+#include "clang-expand/common/offset.hpp"
+#include "clang-expand/common/string-pool.hpp"
+#include "clang-expand/error.hpp"
 #include "clang-expand/options.hpp"
 
 // LLVM includes
 #include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <chrono>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
 
 namespace ClangExpand {
 
@@ -42,8 +55,14 @@ namespace ClangExpand {
 /// the tool to collect and store data. After the search has finished, the
 /// `Query` can be converted to a `Result` and finally printed to the console.
 struct Query {
-  /// Constructs a fresh `Query` with the given `Options`.
-  explicit Query(Options options_) : options(options_) {
+  using Clock = std::chrono::steady_clock;
+
+  /// Constructs a fresh `Query` with the given `Options`, whose filenames and
+  /// names are interned in the `strings`. The deadline of the query, if any,
+  /// starts now.
+  Query(Options options_, std::shared_ptr<StringPool> strings_)
+  : strings(std::move(strings_)), options(options_) {
+    if (options.timeout.count() > 0) deadline = Clock::now() + options.timeout;
   }
 
   /// Utility method to test if it is necessary to collect `DeclarationData`.
@@ -60,6 +79,13 @@ struct Query {
     return options.wantsDefinition || options.wantsRewritten;
   }
 
+  /// Utility method to get the encoding in which positions are collected, as
+  /// chosen by `Options::wantsByteOffsets`.
+  Offset::Encoding getOffsetEncoding() const noexcept {
+    return options.wantsByteOffsets ? Offset::Encoding::Bytes
+                                    : Offset::Encoding::LineColumn;
+  }
+
   /// Utility method to check, after symbol search, whether the search was not
   /// successful. This function respects command line options, i.e. if the query
   /// has no `DeclarationData` and the user did not request such data,
@@ -68,6 +94,56 @@ struct Query {
     return requiresDeclaration() && (!declaration && !definition);
   }
 
+  /// \returns True if the query was cancelled or ran past its deadline, else
+  /// false. Checked between translation units, between top-level declarations
+  /// and before handling matches, so that a query stops soon after either.
+  bool isCancelled() const noexcept {
+    return (options.cancellation && options.cancellation->isCancelled()) ||
+           hasTimedOut();
+  }
+
+  /// \returns True if definition search is finished, i.e. if the query
+  /// failed, or has a definition and does not want all of them.
+  bool hasEnoughDefinitions() const noexcept {
+    return error || (definition && !options.wantsAllDefinitions);
+  }
+
+  /// \returns True if a definition at the canonical location (the absolute
+  /// path of its file and the offset into it) was already recorded.
+  bool hasDefinitionAt(llvm::StringRef file, unsigned offset) const {
+    return definitionLocations.count({file, offset}) > 0;
+  }
+
+  /// Records a definition found at the canonical location (the absolute path
+  /// of its file and the offset into it). The first one becomes the
+  /// `definition`; with `Options::wantsAllDefinitions`, those at other
+  /// locations are appended to `otherDefinitions`.
+  void addDefinition(DefinitionData found,
+                     llvm::StringRef file,
+                     unsigned offset) {
+    file = strings->intern(file);
+    if (!definitionLocations.insert({file, offset}).second) return;
+    if (!definition) {
+      definition = std::move(found);
+    } else if (options.wantsAllDefinitions) {
+      otherDefinitions.emplace_back(std::move(found));
+    }
+  }
+
+  /// \returns True if the query ran past its deadline, else false.
+  bool hasTimedOut() const noexcept {
+    return deadline && Clock::now() >= *deadline;
+  }
+
+  /// Records that the query failed. Only the first failure is kept, since
+  /// everything after it is most likely a consequence. This is for stages of
+  /// the search that run inside clang's callbacks, which cannot return errors.
+  void fail(llvm::Error failure) {
+    llvm::handleAllErrors(std::move(failure), [this](const Error& cause) {
+      if (!error) error = cause;
+    });
+  }
+
   /// Possibly collected `CallData`.
   llvm::Optional<CallData> call;
 
@@ -77,6 +153,24 @@ struct Query {
   /// Possibly collected `DefinitionData`.
   llvm::Optional<DefinitionData> definition;
 
+  /// The definitions found after the first, with
+  /// `Options::wantsAllDefinitions`.
+  std::vector<DefinitionData> otherDefinitions;
+
+  /// The canonical locations (file and offset) of all recorded definitions.
+  /// The files are interned in the `StringPool`.
+  std::set<std::pair<llvm::StringRef, unsigned>> definitionLocations;
+
+  /// The first error the query failed with, if any.
+  llvm::Optional<Error> error;
+
+  /// The point in time after which the query stops, if it has a timeout.
+  llvm::Optional<Clock::time_point> deadline;
+
+  /// The pool that the strings of everything the query collects are interned
+  /// in. Shared with the `Result`, which keeps it alive.
+  std::shared_ptr<StringPool> strings;
+
   /// The `Options` of the query (i.e. what information the user wants).
   const Options options;
 };
@@ -41,9 +41,10 @@ namespace ClangExpand {
 struct Range {
   /// Constructs a range from a `clang::SourceRange` and `clang::SourceManager`,
   /// used to obtain the
-  /// strat and end `Offset`s.
+  /// strat and end `Offset`s in the given `encoding`.
   Range(const clang::SourceRange& range,
-        const clang::SourceManager& sourceManager);
+        const clang::SourceManager& sourceManager,
+        Offset::Encoding encoding = Offset::Encoding::LineColumn);
 
   /// Constructor.
   Range(Offset begin_, Offset end_);
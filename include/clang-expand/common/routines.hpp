@@ -64,6 +64,9 @@ std::string getSourceText(const clang::SourceRange& range,
 std::string makeAbsolute(const std::string& filename);
 
 /// Prints an error message to stderr and exits. the program.
+///
+/// This is only meant for the command line tool. The library reports errors
+/// through `ClangExpand::Error` instead.
 [[noreturn]] void error(const char* message);
 
 /// Prints an error message to stderr and exits. the program. The message is
@@ -0,0 +1,71 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_COMMON_STRING_POOL_HPP
+#define CLANG_EXPAND_COMMON_STRING_POOL_HPP
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/Allocator.h>
+
+// Standard includes
+#include <cstddef>
+#include <shared_mutex>
+
+namespace ClangExpand {
+
+/// Stores every distinct string once, in an arena.
+///
+/// Filenames and names recur in almost every `Location`, `DeclarationData` or
+/// `AssigneeData` we create, and batch searches create one of those for every
+/// call they find. Rather than giving each of them its own heap copy of the
+/// same absolute path, they refer to the copy interned here. Strings are
+/// bump-allocated from slabs and freed all at once with the pool.
+///
+/// Each `Search` owns a pool, which its `Query` objects intern into and every
+/// `Result` shares, so that the references stay valid for as long as the
+/// result does, and no longer. Only strings from a bounded set (paths,
+/// identifiers, type names, USRs) should be interned; source text stays owned
+/// by the structure holding it.
+class StringPool {
+ public:
+  /// Returns the pool's copy of the `string`, copying it into the pool the
+  /// first time it is seen. Thread-safe; strings already in the pool are
+  /// looked up concurrently.
+  llvm::StringRef intern(llvm::StringRef string);
+
+  /// Returns the number of distinct strings in the pool.
+  std::size_t size() const;
+
+ private:
+  /// Guards `_strings`. Shared by lookups, exclusive for insertions.
+  mutable std::shared_timed_mutex _mutex;
+
+  /// The interned strings, allocated from the set's bump allocator.
+  llvm::StringSet<llvm::BumpPtrAllocator> _strings;
+};
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_COMMON_STRING_POOL_HPP
@@ -0,0 +1,87 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_COMMON_TRANSLATION_UNIT_HPP
+#define CLANG_EXPAND_COMMON_TRANSLATION_UNIT_HPP
+
+// Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+
+// LLVM includes
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+
+// Standard includes
+#include <cstdint>
+#include <memory>
+
+namespace clang {
+class ASTUnit;
+class CompilerInvocation;
+namespace tooling {
+struct CompileCommand;
+}
+}
+
+namespace ClangExpand {
+namespace TranslationUnit {
+using FileSystemPointer = llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>;
+
+/// Parses the translation unit described by the compile command into a
+/// `clang::ASTUnit`, with diagnostics suppressed.
+///
+/// Unlike `clang::tooling::ClangTool`, which changes the working directory of
+/// the whole process for every compile command, this resolves relative paths
+/// with `-working-directory`, so any number of translation units can be parsed
+/// on different threads at once.
+///
+/// If `precompilesPreamble` is set, the includes at the top of the main file
+/// are precompiled, so that `clang::ASTUnit::Reparse` only parses the rest of
+/// the main file again, as long as its includes did not change.
+///
+/// \returns The AST, or null if the translation unit could not be parsed.
+std::unique_ptr<clang::ASTUnit>
+parse(const clang::tooling::CompileCommand& command,
+      FileSystemPointer fileSystem,
+      bool precompilesPreamble = false);
+
+/// Runs the driver over the compile command, like `parse()` does, without
+/// parsing anything. The invocation holds, among other things, every directory
+/// the preprocessor searches for headers, including those the driver adds for
+/// the standard library and clang's builtin headers.
+///
+/// \returns The invocation, or null if the driver rejects the command.
+std::unique_ptr<clang::CompilerInvocation>
+createInvocation(const clang::tooling::CompileCommand& command);
+
+/// Returns the memory (in bytes) retained by a parsed AST and its source
+/// buffers. This is the bulk of what parsing the translation unit took, but
+/// not its peak: memory the parser and semantic analysis freed again before
+/// the parse was done is not counted. Parses on other threads share the
+/// process, so the peak of a single parse cannot be measured directly.
+std::uint64_t measureMemory(const clang::ASTUnit& unit);
+
+}  // namespace TranslationUnit
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_COMMON_TRANSLATION_UNIT_HPP
@@ -0,0 +1,83 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_DEFINITION_SEARCH_AST_FILES_HPP
+#define CLANG_EXPAND_DEFINITION_SEARCH_AST_FILES_HPP
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+
+// Standard includes
+#include <string>
+
+namespace clang {
+namespace tooling {
+struct CompileCommand;
+}
+}
+
+namespace ClangExpand {
+struct Query;
+namespace DefinitionSearch {
+class IncludeGraph;
+}
+}
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace ASTFiles {
+
+/// \ingroup DefinitionSearch
+///
+/// Finds the serialized AST file that the build emitted (with `-emit-ast`) for
+/// the translation unit described by the `command`. The AST file is expected
+/// next to the object file, i.e. at the path given by `-o` with the extension
+/// replaced by `.ast` (or named after the source in the working directory if
+/// there is no `-o`).
+///
+/// \returns The path of the AST file if it exists and is newer than every file
+/// in the include closure of the translation unit, else `None` (also if the
+/// closure cannot be determined completely).
+llvm::Optional<std::string>
+findUpToDate(const clang::tooling::CompileCommand& command,
+             IncludeGraph& includeGraph);
+
+/// \ingroup DefinitionSearch
+///
+/// Loads a serialized AST file and runs the `DefinitionSearch::Consumer` on
+/// it, instead of parsing the translation unit from source. Translation units
+/// whose main file is the `skippedFile` are not searched (see
+/// `DefinitionSearch::Action`).
+///
+/// \returns False if the AST file could not be loaded, in which case the
+/// translation unit should be parsed from source instead, else true.
+bool search(const std::string& astFile,
+            const std::string& skippedFile,
+            Query& query);
+
+}  // namespace ASTFiles
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_DEFINITION_SEARCH_AST_FILES_HPP
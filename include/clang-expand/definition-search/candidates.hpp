@@ -0,0 +1,107 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_DEFINITION_SEARCH_CANDIDATES_HPP
+#define CLANG_EXPAND_DEFINITION_SEARCH_CANDIDATES_HPP
+
+// LLVM includes
+#include <llvm/Support/ErrorOr.h>
+
+// Standard includes
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tooling {
+class CompilationDatabase;
+}
+}
+
+namespace llvm {
+class StringRef;
+}
+
+namespace ClangExpand {
+struct Location;
+namespace DefinitionSearch {
+class IncludeGraph;
+}
+}
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace Candidates {
+using SourceVector = std::vector<std::string>;
+
+/// \ingroup DefinitionSearch
+///
+/// Reads a list of source paths from a file, one path per line. Empty lines and
+/// lines starting with `#` are skipped. This is useful for source sets that are
+/// too large to pass on the command line.
+llvm::ErrorOr<SourceVector> readSourceList(const llvm::StringRef& filename);
+
+/// \ingroup DefinitionSearch
+///
+/// Assembles the set of sources to consider for definition search. These are
+/// the `sources` passed explicitly and, if `allSources` is true, every file in
+/// the compilation database. All paths are made absolute and duplicates are
+/// removed, keeping the first occurrence.
+SourceVector
+collect(const clang::tooling::CompilationDatabase& compilationDatabase,
+        const SourceVector& sources,
+        bool allSources);
+
+/// \ingroup DefinitionSearch
+///
+/// Orders candidate sources by their locality to the location of a
+/// declaration. Sources with the same stem as the declaring file (e.g.
+/// `foo.cpp` for `foo.h`) come first, then sources in the same directory and
+/// then everything else. The order within each of these groups is preserved.
+void orderByLocality(SourceVector& sources, const Location& declaration);
+
+/// \ingroup DefinitionSearch
+///
+/// Keeps only the sources belonging to shard `index` of `count`, for searches
+/// split across processes. Sources are assigned to shards by a hash of their
+/// path, so every process computes the same partition regardless of the order
+/// (or machine) in which it collected the sources.
+void keepShard(SourceVector& sources, unsigned index, unsigned count);
+
+/// \ingroup DefinitionSearch
+///
+/// Removes all sources whose include closure, according to the
+/// `IncludeGraph`, cannot contain the file of the declaration. Such sources
+/// cannot hold an out-of-line definition of the function. Sources without a
+/// compile command are kept, since we know nothing about them.
+void pruneByIncludes(
+    SourceVector& sources,
+    const clang::tooling::CompilationDatabase& compilationDatabase,
+    const Location& declaration,
+    IncludeGraph& includeGraph);
+
+}  // namespace Candidates
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_DEFINITION_SEARCH_CANDIDATES_HPP
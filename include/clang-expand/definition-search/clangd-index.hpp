@@ -0,0 +1,62 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_DEFINITION_SEARCH_CLANGD_INDEX_HPP
+#define CLANG_EXPAND_DEFINITION_SEARCH_CLANGD_INDEX_HPP
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <string>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace ClangdIndex {
+
+/// \ingroup DefinitionSearch
+///
+/// Looks up the file defining the function with the given `usr` in the shards
+/// of a clangd background index (usually found under `.cache/clangd/index` in
+/// the project root).
+///
+/// Each shard is a RIFF container holding, among others, a string table and the
+/// symbols declared in one file. clangd identifies symbols by the first eight
+/// bytes of the SHA1 hash of their USR, so we compute that ID and look for it
+/// in the symbol chunk of every shard. Only the leading fields of a symbol
+/// record (up to the file of its definition) are decoded. Shards written in a
+/// format version whose symbol layout we do not know are ignored, as are
+/// shards that are corrupt or compressed when zlib is not available.
+///
+/// \returns The path of the defining file, or `None` if no shard knows where
+/// the function is defined.
+llvm::Optional<std::string> lookup(llvm::StringRef indexDirectory,
+                                   llvm::StringRef usr);
+
+}  // namespace ClangdIndex
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_DEFINITION_SEARCH_CLANGD_INDEX_HPP
@@ -30,6 +30,7 @@
 
 // Clang includes
 #include <clang/AST/ASTConsumer.h>
+#include <clang/AST/DeclGroup.h>
 
 namespace clang {
 class ASTContext;
@@ -54,6 +55,9 @@ class Consumer : public clang::ASTConsumer {
   /// Constructor, taking the ongoing `Query` object.
   explicit Consumer(Query& query);
 
+  /// Stops parsing once the query is cancelled.
+  bool HandleTopLevelDecl(clang::DeclGroupRef) override;
+
   /// Creates an ASTMatcher expression and dispatches it on the translation
   /// unit. The goal is to find functions with the same names as the function
   /// found in the `DeclarationData`.
@@ -0,0 +1,61 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_DEFINITION_SEARCH_EXTERNAL_DEFINITION_MAP_HPP
+#define CLANG_EXPAND_DEFINITION_SEARCH_EXTERNAL_DEFINITION_MAP_HPP
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <string>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace ExternalDefinitionMap {
+
+/// \ingroup DefinitionSearch
+///
+/// Looks up the file defining the function with the given `usr` in an external
+/// definition map, as produced by `clang-extdef-mapping` (or its predecessor
+/// `clang-func-mapping`) for clang's cross translation unit analysis.
+///
+/// Each line of such a map holds a USR and the path of the file that defines
+/// it, separated by a space. Newer versions of the tool prefix the USR with its
+/// length and a colon (`<length>:<usr> <path>`), since USRs may contain spaces;
+/// both formats are understood. Relative paths are resolved against the
+/// directory of the map. The path may name a source file or, for older
+/// pipelines, a serialized AST file.
+///
+/// \returns The absolute path of the defining file, or `None` if the map could
+/// not be read or does not contain the USR.
+llvm::Optional<std::string> lookup(llvm::StringRef mapFile,
+                                   llvm::StringRef usr);
+
+}  // namespace ExternalDefinitionMap
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_DEFINITION_SEARCH_EXTERNAL_DEFINITION_MAP_HPP
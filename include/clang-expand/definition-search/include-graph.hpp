@@ -0,0 +1,252 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_DEFINITION_SEARCH_INCLUDE_GRAPH_HPP
+#define CLANG_EXPAND_DEFINITION_SEARCH_INCLUDE_GRAPH_HPP
+
+// Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+
+// LLVM includes
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+
+// Standard includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tooling {
+struct CompileCommand;
+}
+}
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+
+/// \ingroup DefinitionSearch
+///
+/// A cheap approximation of the include graph of a set of translation units.
+///
+/// An out-of-line definition must see its declaration, so only translation
+/// units whose include closure contains the declaring file can hold the
+/// definition. Rather than running the preprocessor, this class raw-lexes every
+/// file for `#include`, `#include_next` and `#import` directives and resolves
+/// them against the header search paths the driver derives from the
+/// translation unit's compile command (including those of the standard
+/// library and of clang's builtin headers). Conditional compilation is
+/// ignored, so the closure over-approximates the real one, which is what we
+/// want for pruning. Directives whose target is a macro, and directives that
+/// cannot be resolved, may lead anywhere, so any file containing one is treated
+/// as possibly reaching everything. The exception are unresolved includes in
+/// system headers, which are mostly for other platforms and are assumed not to
+/// lead back into the project.
+///
+/// The directives of each file are cached on disk, keyed by the file's path
+/// and invalidated by its modification time and size.
+class IncludeGraph {
+ public:
+  using FileSystemPointer = llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>;
+
+  /// Constructor, taking the path of the on-disk cache (which may be empty to
+  /// disable caching) and the file system to read files from.
+  explicit IncludeGraph(std::string cacheFile,
+                        FileSystemPointer fileSystem =
+                            clang::vfs::getRealFileSystem());
+
+  /// Tests whether the translation unit described by the `command` may include
+  /// the `target` file, directly or transitively. A relative `target` is
+  /// resolved against the command's directory, and files are compared by their
+  /// real paths, so that symbolic links to the `target` are found too.
+  bool mayReach(const clang::tooling::CompileCommand& command,
+                const llvm::StringRef& target);
+
+  /// Returns the latest modification time (in nanoseconds) of any file in the
+  /// include closure of the translation unit described by the `command`, or
+  /// `None` if the closure cannot be determined completely.
+  llvm::Optional<std::int64_t>
+  getLatestModificationTime(const clang::tooling::CompileCommand& command);
+
+  /// Returns the total size (in bytes) of the files in the include closure of
+  /// the translation unit described by the `command`. Files that cannot be
+  /// read or found do not count, so this is a lower bound of what the
+  /// preprocessor reads.
+  std::uint64_t getClosureSize(const clang::tooling::CompileCommand& command);
+
+  /// Returns the absolute paths of the files included in the block of include
+  /// directives at the very top of the command's main file, in order. The
+  /// block ends at the first line of code, the first other directive or the
+  /// first include that cannot be resolved.
+  std::vector<std::string>
+  getLeadingIncludes(const clang::tooling::CompileCommand& command);
+
+  /// Writes the cache back to disk, if any file was scanned since it was
+  /// loaded. Files other processes scanned in the meantime are kept.
+  void save() const;
+
+ private:
+  /// A single include directive.
+  struct Directive {
+    /// The file name as it was spelled inside the quotes or angle brackets.
+    std::string spelling;
+
+    /// Whether the file name was spelled in angle brackets.
+    bool isAngled;
+  };
+
+  /// The scanned directives of a single file.
+  struct File {
+    /// The modification time of the file when it was scanned, in nanoseconds.
+    std::int64_t modificationTime;
+
+    /// The size of the file when it was scanned.
+    std::uint64_t size;
+
+    /// The include directives of the file, in order of appearance.
+    std::vector<Directive> directives;
+
+    /// Whether the file has an include directive whose target is a macro.
+    bool hasComputedInclude{false};
+
+    /// How many of the `directives` are in the block of includes at the very
+    /// top of the file.
+    unsigned leadingDirectives{0};
+
+    /// Whether the entry was validated against the file system in this run.
+    bool isValidated{false};
+  };
+
+  /// A directory to resolve include directives against.
+  struct SearchDirectory {
+    /// The absolute path of the directory.
+    std::string path;
+
+    /// Whether the directory holds frameworks (`-F`), whose headers are
+    /// included as `<Name/Header.h>`.
+    bool isFramework;
+
+    /// Whether headers found in the directory are system headers.
+    bool isSystem;
+  };
+
+  /// The directories to resolve include directives against.
+  struct SearchPaths {
+    /// Directories only searched for quoted includes (`-iquote`).
+    std::vector<SearchDirectory> quoted;
+
+    /// Directories searched for both quoted and angled includes, in the order
+    /// the preprocessor searches them.
+    std::vector<SearchDirectory> angled;
+
+    /// Files included implicitly before the main file (`-include`).
+    std::vector<std::string> forced;
+  };
+
+  /// A resolved include directive.
+  struct Header {
+    /// The absolute path of the included file.
+    std::string filename;
+
+    /// Whether the file is a system header.
+    bool isSystem;
+  };
+
+  /// A callback for `_traverse`, receiving the path of each file in the
+  /// include closure, its scanned directives (or null if the file cannot be
+  /// read) and whether the file may include anything at all (see
+  /// `IncludeGraph`). Returning false stops the traversal.
+  using Visitor =
+      llvm::function_ref<bool(const std::string&, const File*, bool)>;
+
+  /// Visits every file in the include closure of the command's main file,
+  /// including any files included implicitly via `-include`.
+  /// \returns False if the `visitor` stopped the traversal, else true.
+  bool _traverse(const clang::tooling::CompileCommand& command,
+                 Visitor visitor);
+
+  /// Returns the search paths of a compile command, as the driver derives them.
+  /// If the driver rejects the command, the search paths are empty. Memoizes
+  /// results by command line.
+  const SearchPaths&
+  _getSearchPaths(const clang::tooling::CompileCommand& command);
+
+  /// Returns the (possibly cached) scanned directives of a file, or null if
+  /// the file cannot be read.
+  const File* _getFile(const std::string& filename);
+
+  /// Resolves an include directive found in a file inside the
+  /// `includerDirectory`, which is a system header if `isIncluderSystem`, to
+  /// an absolute path.
+  llvm::Optional<Header> _resolve(const Directive& directive,
+                                  const llvm::StringRef& includerDirectory,
+                                  bool isIncluderSystem,
+                                  const SearchPaths& searchPaths);
+
+  /// Tests whether a regular file exists at the given path, memoizing results.
+  bool _exists(const std::string& filename);
+
+  /// Returns the real path of the (absolute) `filename`, with all symbolic
+  /// links resolved, or the `filename` itself if it has none (e.g. because it
+  /// only exists in memory). Memoizes results.
+  const std::string& _getRealPath(const std::string& filename);
+
+  /// Reads the on-disk cache in the `cacheFile` into the `files`. A corrupt or
+  /// outdated cache is ignored.
+  static void _read(const std::string& cacheFile, llvm::StringMap<File>& files);
+
+  /// Loads the on-disk cache, if it exists and is valid.
+  void _load();
+
+  /// The path of the on-disk cache.
+  std::string _cacheFile;
+
+  /// The file system to read files from.
+  FileSystemPointer _fileSystem;
+
+  /// The scanned files, keyed by absolute path.
+  llvm::StringMap<File> _files;
+
+  /// Memoized results of `_exists`.
+  llvm::StringMap<bool> _existence;
+
+  /// Memoized results of `_getRealPath`.
+  llvm::StringMap<std::string> _realPaths;
+
+  /// Memoized results of `_getSearchPaths`, by directory and command line
+  /// (without the main file).
+  llvm::StringMap<SearchPaths> _searchPaths;
+
+  /// The files (re-)scanned since the cache was loaded.
+  llvm::StringSet<> _scanned;
+};
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_DEFINITION_SEARCH_INCLUDE_GRAPH_HPP
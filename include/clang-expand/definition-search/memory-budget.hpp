@@ -0,0 +1,101 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_DEFINITION_SEARCH_MEMORY_BUDGET_HPP
+#define CLANG_EXPAND_DEFINITION_SEARCH_MEMORY_BUDGET_HPP
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/STLExtras.h>
+
+// Standard includes
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+
+/// \ingroup DefinitionSearch
+///
+/// Admits concurrent parses only while the memory they are expected to take
+/// fits into a budget, so that parsing several big translation units at once
+/// does not run the process out of memory.
+///
+/// Parses declare their expected memory up front and wait until it fits next
+/// to the memory of the parses already admitted. A parse is always admitted
+/// when no other one is, so that a single translation unit bigger than the
+/// whole budget is parsed on its own rather than never.
+class MemoryBudget {
+ public:
+  using StopPredicate = llvm::function_ref<bool()>;
+
+  /// Constructor, taking the budget in bytes. Zero means the budget is
+  /// detected with `detect()`, and is unlimited if that fails.
+  explicit MemoryBudget(std::uint64_t bytes);
+
+  /// Whether the budget limits anything at all. If not, estimating memory for
+  /// `acquire()` is a waste of time.
+  bool isLimited() const noexcept;
+
+  /// Returns the budget in bytes, or `None` if it is unlimited.
+  llvm::Optional<std::uint64_t> getLimit() const noexcept;
+
+  /// Blocks until `bytes` fit into the budget and admits them, unless
+  /// `shouldStop` returns true first. `shouldStop` is checked whenever memory
+  /// is released and on `interrupt()`.
+  ///
+  /// \returns True if the bytes were admitted, else false.
+  bool acquire(std::uint64_t bytes, StopPredicate shouldStop);
+
+  /// Returns previously admitted bytes to the budget.
+  void release(std::uint64_t bytes);
+
+  /// Makes all waiting `acquire()` calls check their `shouldStop` predicate.
+  void interrupt();
+
+  /// Returns the memory (in bytes) that may still be taken before the process
+  /// risks being killed: the headroom under the limit of its memory cgroup or
+  /// the memory available to the system, whichever is smaller. Part of that is
+  /// left for the thread parsing the call. `None` if neither can be found.
+  static llvm::Optional<std::uint64_t> detect();
+
+ private:
+  /// The budget in bytes, or `None` if it is unlimited.
+  llvm::Optional<std::uint64_t> _budget;
+
+  /// The bytes admitted and not released yet.
+  std::uint64_t _admitted{0};
+
+  /// Guards `_admitted`.
+  std::mutex _mutex;
+
+  /// Signaled whenever memory is released or waiters are interrupted.
+  std::condition_variable _released;
+};
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_DEFINITION_SEARCH_MEMORY_BUDGET_HPP
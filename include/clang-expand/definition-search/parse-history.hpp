@@ -0,0 +1,108 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_DEFINITION_SEARCH_PARSE_HISTORY_HPP
+#define CLANG_EXPAND_DEFINITION_SEARCH_PARSE_HISTORY_HPP
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+
+// Standard includes
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+
+/// \ingroup DefinitionSearch
+///
+/// Remembers what parsing each source cost the last time (memory, time and
+/// the number of files read), so that the cost of parsing it again can be
+/// estimated before doing so.
+///
+/// The history is kept on disk between runs and may be shared by concurrent
+/// parses within a run.
+class ParseHistory {
+ public:
+  /// The cost of parsing a single source.
+  struct Cost {
+    /// The memory (in bytes) the AST and its source buffers held once the
+    /// parse was done (see `TranslationUnit::measureMemory()`). The real peak
+    /// of the parse is somewhat higher, so this is only an approximation of
+    /// what the parse needs.
+    std::uint64_t retainedMemory;
+
+    /// The wall time (in milliseconds) the parse took.
+    std::uint64_t milliseconds;
+
+    /// The number of files (the source and its includes) the parse read.
+    unsigned includes;
+  };
+
+  /// Constructor, taking the path of the on-disk history (which may be empty,
+  /// in which case nothing is remembered between runs).
+  explicit ParseHistory(std::string file);
+
+  /// Returns the cost of the last parse of the `source`, or `None` if it was
+  /// never parsed.
+  llvm::Optional<Cost> getCost(llvm::StringRef source) const;
+
+  /// Returns the cost of the last parse of the `source` or, if it was never
+  /// parsed, a rough estimate from the total size of the files it reads (in
+  /// bytes).
+  Cost estimateCost(llvm::StringRef source, std::uint64_t sourceBytes) const;
+
+  /// Records the cost of a parse of the `source`.
+  void recordCost(llvm::StringRef source, const Cost& cost);
+
+  /// Writes the history back to disk, if anything was recorded since it was
+  /// loaded. Costs other processes saved in the meantime are merged in, except
+  /// for the sources parsed here.
+  void save() const;
+
+ private:
+  /// Reads the history from disk.
+  void _load();
+
+  /// The path of the on-disk history.
+  std::string _file;
+
+  /// The cost of the last parse of each source, by absolute path.
+  llvm::StringMap<Cost> _costs;
+
+  /// The sources whose cost was recorded since the history was loaded.
+  llvm::StringSet<> _recorded;
+
+  /// Guards the history against concurrent parses.
+  mutable std::mutex _mutex;
+};
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_DEFINITION_SEARCH_PARSE_HISTORY_HPP
@@ -0,0 +1,159 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_DEFINITION_SEARCH_PARSE_POOL_HPP
+#define CLANG_EXPAND_DEFINITION_SEARCH_PARSE_POOL_HPP
+
+// Project includes
+#include "clang-expand/definition-search/memory-budget.hpp"
+#include "clang-expand/definition-search/parse-history.hpp"
+
+// Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+#include <clang/Tooling/CompilationDatabase.h>
+
+// LLVM includes
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/ThreadPool.h>
+
+// Standard includes
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTUnit;
+}
+
+namespace ClangExpand {
+struct Options;
+}
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+
+/// \ingroup DefinitionSearch
+///
+/// Parses translation units on a fixed number of background threads, within a
+/// `MemoryBudget`. Shared by speculative parses of definition search and the
+/// scan for callers.
+///
+/// Parses go through `TranslationUnit::parse`, so any number of them can run
+/// at once. Each is admitted by the budget with its cost from the
+/// `ParseHistory` (or an estimate from the size of its sources), is queued
+/// longest first and records its actual cost in the history.
+class ParsePool {
+ public:
+  using FileSystemPointer = llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>;
+  using SizeFunction = llvm::function_ref<std::uint64_t()>;
+
+  /// A translation unit to parse.
+  struct Job {
+    /// The main file of the translation unit.
+    std::string source;
+
+    /// The compile command to parse it with.
+    clang::tooling::CompileCommand command;
+
+    /// What parsing it is expected to cost.
+    ParseHistory::Cost cost;
+  };
+
+  using JobFunction = std::function<void(const Job&)>;
+
+  /// Constructor, taking the file system to parse with, the options of the
+  /// query (for the budget and history) and the number of threads.
+  ParsePool(FileSystemPointer fileSystem,
+            const Options& options,
+            unsigned threadCount);
+
+  /// Waits for all jobs and saves the parse history.
+  ~ParsePool();
+
+  /// Returns the cost of the last parse of the `source` or, if it was never
+  /// parsed, an estimate from the size of the files it reads, as returned by
+  /// `getSize` (which is only called in that case).
+  ParseHistory::Cost estimateCost(llvm::StringRef source,
+                                  SizeFunction getSize) const;
+
+  /// Queues the `jobs` longest first, by the time they took the last time, so
+  /// that a big translation unit started last does not keep the others waiting
+  /// while the remaining threads are idle. Each job is passed to `run` on the
+  /// next idle thread.
+  ///
+  /// \returns A future for each job, in the order given, which becomes ready
+  /// once `run` has returned.
+  std::vector<std::shared_future<void>> enqueue(std::vector<Job> jobs,
+                                                JobFunction run);
+
+  /// Runs the `task` on the next idle thread, like a job that parses nothing.
+  std::shared_future<void> async(std::function<void()> task);
+
+  /// Waits until the budget admits the memory of the `job` (unless
+  /// `shouldStop` returns true first), parses it and records its cost in the
+  /// history. Meant to be called from a `JobFunction`.
+  ///
+  /// \returns The AST, whose memory (the `retainedMemory` of the job's cost)
+  /// stays admitted until it is `release()`d, or null if the job was stopped
+  /// or could not be parsed (in which case there is nothing to release).
+  std::unique_ptr<clang::ASTUnit> parse(const Job& job,
+                                        MemoryBudget::StopPredicate shouldStop);
+
+  /// Returns the memory (in bytes) admitted for an AST that was dropped to
+  /// the budget.
+  void release(std::uint64_t memory);
+
+  /// Makes parses waiting for memory check whether they should stop.
+  void interrupt();
+
+  /// Waits until all jobs queued so far have run.
+  void wait();
+
+  /// Returns the budget parses are admitted by.
+  const MemoryBudget& getBudget() const noexcept;
+
+ private:
+  /// The file system to parse with.
+  FileSystemPointer _fileSystem;
+
+  /// The costs of earlier parses.
+  ParseHistory _history;
+
+  /// Admits parses while their memory fits.
+  MemoryBudget _budget;
+
+  /// The threads parsing. Declared last, so that they are joined before
+  /// anything they use is destroyed.
+  llvm::ThreadPool _threadPool;
+};
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_DEFINITION_SEARCH_PARSE_POOL_HPP
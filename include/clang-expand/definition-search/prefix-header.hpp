@@ -0,0 +1,112 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_DEFINITION_SEARCH_PREFIX_HEADER_HPP
+#define CLANG_EXPAND_DEFINITION_SEARCH_PREFIX_HEADER_HPP
+
+// Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+
+// LLVM includes
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/StringSet.h>
+
+// Standard includes
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tooling {
+class CompilationDatabase;
+struct CompileCommand;
+}
+}
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+class IncludeGraph;
+
+/// \ingroup DefinitionSearch
+///
+/// A precompiled header for the block of includes shared by the candidate
+/// sources of definition search.
+///
+/// Most sources of a project begin with the same framework includes, which
+/// definition search would otherwise parse again for every translation unit.
+/// This class finds the largest group of candidate sources compiled with
+/// identical flags, determines the longest common sequence of leading includes
+/// among them and precompiles a header that includes exactly that sequence.
+/// The precompiled header is then injected into the compile commands of the
+/// group via `-include-pch`, so that include guards (or `#pragma once`) make
+/// the includes of each source no-ops.
+///
+/// The header and PCH are kept in a cache directory, keyed by a hash of the
+/// flags and the included files, and are rebuilt only when a file in their
+/// include closure is newer than the PCH.
+class PrefixHeader {
+ public:
+  using SourceVector = std::vector<std::string>;
+  using FileSystemPointer = llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>;
+
+  /// Constructor, taking the directory in which to cache precompiled headers
+  /// and the file system to use when building them.
+  PrefixHeader(std::string cacheDirectory, FileSystemPointer fileSystem);
+
+  /// Finds the common include prefix of the `sources` and builds (or reuses)
+  /// a precompiled header for it.
+  /// \returns True if there is a precompiled header to inject, else false.
+  bool prepare(const clang::tooling::CompilationDatabase& compilationDatabase,
+               const SourceVector& sources,
+               IncludeGraph& includeGraph);
+
+  /// Returns an arguments adjuster that injects the precompiled header into
+  /// the compile commands of all sources it was built for. The adjuster
+  /// refers to this object, which must outlive it.
+  clang::tooling::ArgumentsAdjuster getArgumentsAdjuster() const;
+
+ private:
+  /// Builds the precompiled header for the prefix header at `headerFile`,
+  /// using the flags of the `command`.
+  bool _build(const clang::tooling::CompileCommand& command,
+              const std::string& headerFile) const;
+
+  /// The directory in which to cache prefix headers and their PCHs.
+  std::string _cacheDirectory;
+
+  /// The file system to use when building precompiled headers.
+  FileSystemPointer _fileSystem;
+
+  /// The path of the precompiled header, once prepared.
+  std::string _pchFile;
+
+  /// The file names (as they appear in their compile commands) of the sources
+  /// that the precompiled header is compatible with.
+  llvm::StringSet<> _compatibleSources;
+};
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_DEFINITION_SEARCH_PREFIX_HEADER_HPP
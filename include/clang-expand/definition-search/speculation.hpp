@@ -0,0 +1,189 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_DEFINITION_SEARCH_SPECULATION_HPP
+#define CLANG_EXPAND_DEFINITION_SEARCH_SPECULATION_HPP
+
+// Project includes
+#include "clang-expand/definition-search/parse-pool.hpp"
+
+// Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+
+// LLVM includes
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTUnit;
+namespace tooling {
+class CompilationDatabase;
+}
+}
+
+namespace ClangExpand {
+struct Options;
+struct Query;
+}
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+
+/// \ingroup DefinitionSearch
+///
+/// Parses candidate translation units for the definition while symbol search
+/// is still running.
+///
+/// Symbol search needs a full parse of the target translation unit before it
+/// knows the `DeclarationData` that definition search matches against. The
+/// name of the function, however, is known as soon as the token under the
+/// cursor has been lexed. With that name, a `Speculation` picks the candidate
+/// sources that mention it (closest to the target file first), queues as many
+/// as the memory budget could hold, parses up to one per core at a time in the
+/// background and keeps the ASTs of those that define a function of that
+/// name. Once symbol search is done, definition search asks
+/// the `Speculation` for each candidate before parsing it itself, and matches
+/// the kept ASTs against the now known declaration.
+///
+/// Background parses go through `clang::ASTUnit` with `-working-directory`
+/// rather than `clang::tooling::ClangTool`, since the latter changes the
+/// working directory of the whole process for every compile command.
+///
+/// Parses run in a `ParsePool`, estimated by the size of their include closure
+/// when they have no history yet. An admitted parse holds its memory until
+/// the AST is dropped, so kept ASTs count against the budget too.
+class Speculation {
+ public:
+  using CompilationDatabase = clang::tooling::CompilationDatabase;
+  using FileSystemPointer = llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>;
+  using SourceVector = std::vector<std::string>;
+
+  /// Constructor, taking the compilation database and the `candidates` of
+  /// definition search, the `targetFile` (which is never searched), the file
+  /// system to parse with and the options of the query.
+  Speculation(CompilationDatabase& compilationDatabase,
+              SourceVector candidates,
+              const std::string& targetFile,
+              FileSystemPointer fileSystem,
+              const Options& options);
+
+  /// Waits for the parses that are already running, which cannot be
+  /// interrupted, and saves the parse history. Parses that have not started
+  /// yet (or are waiting for memory) are abandoned.
+  ~Speculation();
+
+  /// Starts parsing, in the background, the candidates that mention a function
+  /// with the `spelling`. Must be called at most once.
+  void start(llvm::StringRef spelling);
+
+  /// Searches the speculatively parsed translation unit of the `source` for
+  /// the definition, like `DefinitionSearch::Consumer`, after waiting for its
+  /// parse to finish.
+  ///
+  /// A parse that was not admitted yet is abandoned rather than waited for,
+  /// since the memory it waits for may be held by ASTs that are searched only
+  /// later.
+  ///
+  /// \returns True if the source was parsed speculatively, in which case it
+  /// need not be parsed again, else false.
+  bool search(const std::string& source, Query& query);
+
+ private:
+  /// The outcome of parsing one candidate.
+  struct Parse {
+    /// Becomes ready when the parse has finished (or was abandoned).
+    std::shared_future<void> finished;
+
+    /// Set by whichever comes first: the background thread starting the
+    /// parse or `search()` giving up on it.
+    std::atomic<bool> isClaimed{false};
+
+    /// Set by `search()` to stop the parse from waiting for memory.
+    std::atomic<bool> isSkipped{false};
+
+    /// The memory (in bytes) admitted by the budget and not released yet.
+    std::uint64_t admittedMemory{0};
+
+    /// The AST, kept only if it defines a function with the spelling.
+    std::unique_ptr<clang::ASTUnit> unit;
+
+    /// Whether the candidate could be parsed at all.
+    bool succeeded{false};
+  };
+
+  /// Picks the candidates to parse and schedules their parses.
+  void _plan(const std::string& spelling);
+
+  /// Parses a candidate, once the budget admits it, and keeps its AST if it
+  /// defines a function with the spelling.
+  void _parse(const ParsePool::Job& job,
+              const std::string& spelling,
+              Parse& parse);
+
+  /// The compilation database of the project.
+  CompilationDatabase& _compilationDatabase;
+
+  /// The candidates of definition search.
+  SourceVector _candidates;
+
+  /// The file containing the call, which is never searched.
+  std::string _targetFile;
+
+  /// The file system to parse with.
+  FileSystemPointer _fileSystem;
+
+  /// The file in which the include graph is cached, for estimates.
+  std::string _includeGraphCache;
+
+  /// The number of background threads, i.e. the maximum number of candidates
+  /// parsed at once.
+  const unsigned _threadCount;
+
+  /// Set once the speculation is no longer needed.
+  std::atomic<bool> _abandoned{false};
+
+  /// Becomes ready once all parses have been scheduled.
+  std::shared_future<void> _planned;
+
+  /// The parses, by source. Only modified before `_planned` becomes ready.
+  std::map<std::string, Parse> _parses;
+
+  /// Parses in the background. Declared last, so that its threads are joined
+  /// before anything they use is destroyed.
+  ParsePool _pool;
+};
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_DEFINITION_SEARCH_SPECULATION_HPP
@@ -29,8 +29,8 @@
 #include <clang/Frontend/FrontendAction.h>
 #include <clang/Tooling/Tooling.h>
 
-// Standard includes
-#include <iosfwd>
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
 
 namespace ClangExpand {
 struct Query;
@@ -50,8 +50,9 @@ class ToolFactory : public clang::tooling::FrontendActionFactory {
   /// Constructor, taking the file in which the declaration was found and the
   /// ongoing `Query`. This tool will skip the `declarationFile`, since its
   /// definition would already have been picked up during symbol search, if it
-  /// had one.
-  explicit ToolFactory(const std::string& declarationFile, Query& query);
+  /// had one. The `declarationFile` must outlive the factory (as interned
+  /// strings do).
+  explicit ToolFactory(llvm::StringRef declarationFile, Query& query);
 
   /// Creates the action of the definition search phase.
   /// \returns A `DefinitionSearch::Action`.
@@ -59,7 +60,7 @@ class ToolFactory : public clang::tooling::FrontendActionFactory {
 
  private:
   /// The file in which the declaration was found.
-  const std::string& _declarationFile;
+  llvm::StringRef _declarationFile;
 
   /// The ongoing `Query` object.
   Query& _query;
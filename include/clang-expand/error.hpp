@@ -0,0 +1,127 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_ERROR_HPP
+#define CLANG_EXPAND_ERROR_HPP
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <string>
+#include <system_error>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace ClangExpand {
+
+/// The kinds of failures a `Search` can end with.
+enum class ErrorKind {
+  /// A file could not be found or loaded.
+  FileNotFound,
+
+  /// The location does not exist in the file or no token could be lexed there.
+  InvalidLocation,
+
+  /// The token at the location is neither an identifier nor an operator.
+  InvalidToken,
+
+  /// The token at the location is not a call to anything we know about.
+  UnknownSymbol,
+
+  /// The call cannot be expanded, because of the context it appears in or
+  /// because the function cannot be rewritten for that context.
+  RefusedExpansion,
+
+  /// No definition of the function was found in any source.
+  DefinitionNotFound,
+
+  /// A clang tool failed, e.g. because the target file does not compile.
+  ToolFailure,
+
+  /// The search was cancelled through its `CancellationToken`.
+  Cancelled,
+
+  /// The search could not be set up, e.g. because the compilation database
+  /// could not be loaded.
+  InvalidConfiguration,
+
+  /// The partial results of a sharded search contradict each other or do not
+  /// cover all shards.
+  InconsistentShards,
+};
+
+/// An error ending a `Search`, usable with `llvm::Error` and `llvm::Expected`.
+///
+/// Errors are not printed or acted upon by the library. Instead, every
+/// function that can fail returns an `llvm::Expected` (or records the error in
+/// the `Query`, where clang's interfaces give us no other choice), so that the
+/// library can be embedded in processes that run many searches.
+class Error : public llvm::ErrorInfo<Error> {
+ public:
+  /// The identifier required by `llvm::ErrorInfo`.
+  static char ID;
+
+  /// Constructor.
+  Error(ErrorKind kind, std::string message);
+
+  /// Returns a short, stable name for the `kind` (e.g. "definition-not-found"),
+  /// for use in machine-readable output.
+  static const char* getKindName(ErrorKind kind) noexcept;
+
+  /// Writes the message to the `stream`.
+  void log(llvm::raw_ostream& stream) const override;
+
+  /// \returns `llvm::inconvertibleErrorCode()`, since our errors do not
+  /// correspond to any `std::error_code`.
+  std::error_code convertToErrorCode() const override;
+
+  /// Converts the `Error` to JSON, with its kind and message.
+  nlohmann::json toJson() const;
+
+  /// \returns The kind of the error.
+  ErrorKind getKind() const noexcept {
+    return _kind;
+  }
+
+  /// \returns The human-readable message of the error.
+  const std::string& getMessage() const noexcept {
+    return _message;
+  }
+
+ private:
+  /// The kind of the error.
+  ErrorKind _kind;
+
+  /// The human-readable message of the error.
+  std::string _message;
+};
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_ERROR_HPP
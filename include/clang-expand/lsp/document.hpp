@@ -0,0 +1,105 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_LSP_DOCUMENT_HPP
+#define CLANG_EXPAND_LSP_DOCUMENT_HPP
+
+// Project includes
+#include "clang-expand/common/offset.hpp"
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <cstddef>
+#include <string>
+
+namespace ClangExpand {
+namespace LSP {
+
+/// \ingroup LSP
+///
+/// A position as the protocol defines it: a 0-based line and a 0-based
+/// character offset into that line, counted in UTF-16 code units.
+struct Position {
+  /// The 0-based line.
+  unsigned line;
+
+  /// The 0-based offset into the line, in UTF-16 code units.
+  unsigned character;
+};
+
+/// \ingroup LSP
+///
+/// The contents of a text document, as far as the editor told us about it.
+///
+/// clang (and thus all of clang-expand) counts 1-based lines and 1-based byte
+/// columns, while the protocol counts 0-based lines and UTF-16 code units. A
+/// `Document` converts between the two, which requires the text of the line.
+/// Lines beyond the end of the text are converted as if all their characters
+/// were ASCII.
+class Document {
+ public:
+  /// Constructor, taking the full text of the document.
+  explicit Document(std::string text = {});
+
+  /// Replaces the full text of the document.
+  void setText(std::string text);
+
+  /// Replaces the text between the two positions (as sent by incremental
+  /// `textDocument/didChange` notifications).
+  void replace(const Position& begin,
+               const Position& end,
+               llvm::StringRef text);
+
+  /// Converts a protocol position to a clang `Offset`.
+  Offset getOffset(const Position& position) const;
+
+  /// Converts a clang `Offset` to a protocol position.
+  Position getPosition(const Offset& offset) const;
+
+  /// Returns the full text of the document.
+  const std::string& getText() const noexcept {
+    return _text;
+  }
+
+ private:
+  /// Returns the byte offset of the start of the 0-based line, or `npos` if
+  /// the document has fewer lines.
+  std::size_t _getLineStart(unsigned line) const;
+
+  /// Returns the (0-based) line without its terminator.
+  llvm::StringRef _getLine(unsigned line) const;
+
+  /// Returns the byte offset of the position in the text, clamped to the text.
+  std::size_t _getByteOffset(const Position& position) const;
+
+  /// The text of the document.
+  std::string _text;
+};
+
+}  // namespace LSP
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_LSP_DOCUMENT_HPP
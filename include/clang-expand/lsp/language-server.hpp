@@ -0,0 +1,137 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_LSP_LANGUAGE_SERVER_HPP
+#define CLANG_EXPAND_LSP_LANGUAGE_SERVER_HPP
+
+// Project includes
+#include "clang-expand/lsp/document.hpp"
+#include "clang-expand/options.hpp"
+#include "clang-expand/session.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+namespace ClangExpand {
+struct Result;
+
+namespace LSP {
+
+/// \ingroup LSP
+///
+/// A language server answering requests one at a time, in the order they
+/// arrive.
+///
+/// The server keeps a `Session` (compilation database and file cache) alive
+/// for its whole lifetime, and tracks the buffers the editor has open. Their
+/// contents are mapped over the file system for every search, so expansions
+/// and definitions always reflect what the user sees, saved or not. The
+/// session retains the AST of every open buffer, so that searching in it only
+/// reparses the buffer itself, not the headers it includes.
+///
+/// Supported are `initialize`, `shutdown`, `exit`, `textDocument/didOpen`,
+/// `textDocument/didChange` (full and incremental), `textDocument/didClose`,
+/// `textDocument/codeAction` (which offers to expand the call at the start of
+/// the range) and `textDocument/definition`.
+///
+/// The compilation database is taken from the `compilationDatabasePath` of
+/// the `initializationOptions`, else from the root of the workspace (or its
+/// `build` directory), else it is detected from the first file a request
+/// refers to.
+class LanguageServer {
+ public:
+  /// Reads messages from the input and answers them on the output, until the
+  /// client sends `exit` or closes the input.
+  ///
+  /// \returns The exit code of the process, which is only successful if the
+  /// client sent `shutdown` before exiting.
+  int run(std::FILE* input, std::FILE* output);
+
+ private:
+  /// Handles a request or notification.
+  void _handle(const nlohmann::json& message);
+
+  /// Answers a request, returning its result (or an error).
+  llvm::Expected<nlohmann::json> _answer(const std::string& method,
+                                         const nlohmann::json& params);
+
+  /// Applies a notification.
+  void _apply(const std::string& method, const nlohmann::json& params);
+
+  /// Answers `initialize`, loading the compilation database if possible.
+  nlohmann::json _initialize(const nlohmann::json& params);
+
+  /// Answers `textDocument/codeAction`.
+  llvm::Expected<nlohmann::json> _codeAction(const nlohmann::json& params);
+
+  /// Answers `textDocument/definition`.
+  llvm::Expected<nlohmann::json> _definition(const nlohmann::json& params);
+
+  /// Runs a search at the position in the file.
+  llvm::Expected<Result> _search(const std::string& file,
+                                 const Position& position,
+                                 Options options);
+
+  /// Returns the open document for the file, or else its contents on disk.
+  Document _getDocument(const std::string& file) const;
+
+  /// Returns the session, detecting the compilation database from the file if
+  /// there is no session yet.
+  llvm::Expected<Session&> _getSession(const std::string& file);
+
+  /// The output messages are written to.
+  std::FILE* _output{nullptr};
+
+  /// The session shared by all searches, once we have found a compilation
+  /// database.
+  std::unique_ptr<Session> _session;
+
+  /// The documents the editor has open, by absolute path.
+  llvm::StringMap<Document> _documents;
+
+  /// How long a single search may take (zero for no limit), from the
+  /// `timeoutMs` initialization option.
+  std::chrono::milliseconds _timeout{0};
+
+  /// Whether the client has sent `shutdown`.
+  bool _isShutDown{false};
+
+  /// Whether the client has sent `exit`.
+  bool _hasExited{false};
+};
+
+}  // namespace LSP
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_LSP_LANGUAGE_SERVER_HPP
@@ -0,0 +1,65 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_LSP_TRANSPORT_HPP
+#define CLANG_EXPAND_LSP_TRANSPORT_HPP
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+
+// Standard includes
+#include <cstdio>
+#include <string>
+
+namespace ClangExpand {
+namespace LSP {
+
+/// \defgroup LSP LSP
+///
+/// With `--lsp`, clang-expand speaks the Language Server Protocol on stdio, so
+/// that editors can keep one warm process around instead of spawning one per
+/// request. Expansion is offered as a code action and go-to-definition is
+/// answered from the same session.
+
+/// \ingroup LSP
+///
+/// Reads the content of the next message (framed by a `Content-Length`
+/// header) from the input.
+///
+/// \returns The content, or `llvm::None` at the end of the input or if the
+/// header is malformed.
+llvm::Optional<std::string> readMessage(std::FILE* input);
+
+/// \ingroup LSP
+///
+/// Writes the message to the output, framed by a `Content-Length` header.
+void writeMessage(std::FILE* output, const nlohmann::json& message);
+
+}  // namespace LSP
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_LSP_TRANSPORT_HPP
@@ -0,0 +1,58 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_MERGE_HPP
+#define CLANG_EXPAND_MERGE_HPP
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <vector>
+
+namespace ClangExpand {
+
+/// Combines the JSON results of the shards of a sharded search (see
+/// `Options::shardIndex`) into the result of the whole search.
+///
+/// All shards must be present exactly once and must agree on the call and the
+/// declaration, which they all found in the same file. Of the definitions
+/// found by different shards, the one in the lexicographically lowest file
+/// (and then at the lowest position) wins, which makes the merge independent
+/// of the order of the shards. With `Options::wantsAllDefinitions`, the
+/// definitions of all shards are combined, without duplicates and in the same
+/// order. The merged result is partial if any shard is.
+///
+/// \returns The merged result, or an `ErrorKind::InconsistentShards` error if
+/// the shards do not fit together, or an `ErrorKind::DefinitionNotFound` error
+/// if no shard found the definition.
+llvm::Expected<nlohmann::json>
+mergeShards(const std::vector<nlohmann::json>& shards);
+
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_MERGE_HPP
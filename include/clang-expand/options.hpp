@@ -25,7 +25,18 @@
 #ifndef CLANG_EXPAND_OPTIONS_HPP
 #define CLANG_EXPAND_OPTIONS_HPP
 
+// LLVM includes
+#include <llvm/ADT/StringMap.h>
+
+// Standard includes
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
 namespace ClangExpand {
+class CancellationToken;
+
 /// Options for a query.
 struct Options {
   /// Whether to include information about the function call in the result.
@@ -40,6 +51,92 @@ struct Options {
   /// Whether to include the rewritten funtcion body information for the
   /// function.
   bool wantsRewritten;
+
+  /// Whether to include file cache statistics in the result.
+  bool wantsStatistics{false};
+
+  /// Whether to report positions (of the call, declaration and definitions)
+  /// as byte offsets into their files instead of `(line, column)` pairs. This
+  /// spares the source manager from computing the lines of every file a
+  /// position is reported in.
+  bool wantsByteOffsets{false};
+
+  /// Whether to report every definition of the function (e.g. per-platform
+  /// implementations or ODR violations) instead of stopping at the first.
+  /// Definitions are de-duplicated by their canonical location, so an inline
+  /// function in a header counts once no matter how many sources include it.
+  bool wantsAllDefinitions{false};
+
+  /// Whether definition search should consider every source in the
+  /// compilation database, in addition to the sources passed explicitly.
+  bool searchAllSources{false};
+
+  /// Whether definition search should skip sources that cannot include the
+  /// file in which the function was declared.
+  bool pruneByIncludes{false};
+
+  /// The file in which to cache the include graph used for pruning. May be
+  /// empty, in which case nothing is cached.
+  std::string includeGraphCache;
+
+  /// The directory in which to cache a precompiled header for the includes
+  /// shared by the candidate sources of definition search. May be empty, in
+  /// which case no precompiled header is used.
+  std::string prefixHeaderCache;
+
+  /// Whether definition search should load the serialized AST files emitted
+  /// by the build (with `-emit-ast`) instead of parsing sources, where they
+  /// are up to date.
+  bool useASTFiles{false};
+
+  /// An external definition map (as produced by `clang-extdef-mapping`) from
+  /// which to look up the file defining the function by its USR. May be empty,
+  /// in which case definition search scans all candidate sources.
+  std::string externalDefinitionMap;
+
+  /// The directory holding the shards of a clangd background index (usually
+  /// `.cache/clangd/index`), from which to look up the file defining the
+  /// function by its USR. May be empty, in which case no index is consulted.
+  std::string clangdIndex;
+
+  /// Whether definition search should start parsing candidate sources in the
+  /// background while symbol search is still running, as soon as the name of
+  /// the function is known.
+  bool speculate{false};
+
+  /// The memory (in bytes) that background parses may take at once. Zero
+  /// means the budget is derived from the memory cgroup limit or the memory
+  /// available to the system.
+  std::uint64_t memoryBudget{0};
+
+  /// The file in which to remember what parsing each source cost (memory,
+  /// time and includes), by which background parses are admitted and ordered.
+  /// May be empty, in which case costs are estimated from the size of each
+  /// source's includes.
+  std::string parseHistory;
+
+  /// The shard of the candidate sources definition search is restricted to,
+  /// out of `shardCount`, for searches split across processes. With more than
+  /// one shard, not finding the definition is not an error, and the
+  /// declaration is always reported so that shards can be checked against
+  /// each other when merging their results.
+  unsigned shardIndex{0};
+
+  /// The number of shards the candidate sources are split into.
+  unsigned shardCount{1};
+
+  /// The contents of files that were modified but not saved (e.g. the dirty
+  /// buffers of an editor), keyed by absolute path. These are mapped over the
+  /// real file system for both symbol and definition search.
+  llvm::StringMap<std::string> unsavedFiles;
+
+  /// A token through which the query can be cancelled from another thread.
+  /// May be null, in which case the query cannot be cancelled.
+  std::shared_ptr<const CancellationToken> cancellation;
+
+  /// How long the query may run before it stops and returns whatever it has
+  /// found so far, flagged as partial. Zero means there is no deadline.
+  std::chrono::milliseconds timeout{0};
 };
 }  // namespace ClangExpand
 
@@ -26,6 +26,7 @@
 #define CLANG_EXPAND_RESULT_HPP
 
 // Project includes
+#include "clang-expand/common/caching-file-system.hpp"
 #include "clang-expand/common/declaration-data.hpp"
 #include "clang-expand/common/definition-data.hpp"
 #include "clang-expand/common/range.hpp"
@@ -36,12 +37,19 @@
 // Third party includes
 #include <third-party/json.hpp>
 
+// Standard includes
+#include <memory>
+#include <utility>
+#include <vector>
+
 namespace llvm {
 class raw_ostream;
 }
 
 namespace ClangExpand {
+class StringPool;
 struct Query;
+
 /// Stores the result of a `Query`.
 ///
 /// Converting this structure to YAML gives the full (nested) output of
@@ -67,6 +75,26 @@ struct Result {
 
   /// The definition data of the call.
   llvm::Optional<DefinitionData> definition;
+
+  /// All definitions found, starting with `definition`, if all of them were
+  /// requested.
+  std::vector<DefinitionData> definitions;
+
+  /// Whether the search ran past its deadline, so that some of the requested
+  /// information may be missing.
+  bool isPartial{false};
+
+  /// The index and count of the shard this is the partial result of, if the
+  /// search was sharded.
+  llvm::Optional<std::pair<unsigned, unsigned>> shard;
+
+  /// Hit and miss counters of the file cache shared by all clang tools of the
+  /// search, if requested.
+  llvm::Optional<CachingFileSystem::Statistics> cacheStatistics;
+
+  /// The pool that the filenames and names of the result are interned in,
+  /// kept alive for as long as the result is.
+  std::shared_ptr<const StringPool> strings;
 };
 }  // namespace ClangExpand
 
@@ -27,15 +27,31 @@
 
 /// \defgroup SymbolSearch
 /// \defgroup DefinitionSearch
+/// \defgroup CallerSearch
 
 // Project includes
+#include "clang-expand/common/caching-file-system.hpp"
 #include "clang-expand/common/location.hpp"
+#include "clang-expand/common/string-pool.hpp"
+
+// Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+
+// LLVM includes
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
 
 // Standard includes
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace clang {
+class ASTUnit;
 namespace tooling {
 class CompilationDatabase;
 }
@@ -43,8 +59,16 @@ class CompilationDatabase;
 
 namespace ClangExpand {
 struct Query;
+struct Range;
 struct Result;
 struct Options;
+namespace CallerSearch {
+struct Expansions;
+}
+namespace DefinitionSearch {
+class IncludeGraph;
+class Speculation;
+}
 
 /// Represents a single run of the clang-expand tool.
 ///
@@ -117,6 +141,12 @@ struct Options;
 /// name, its contexts and parameter types are compared to the target
 /// declaration.
 ///
+/// The candidate sources are the sources passed explicitly and, optionally,
+/// every source in the compilation database. They are searched in order of
+/// their locality to the declaration: sources with the same stem as the
+/// declaring file come first, then sources in the same directory and finally
+/// everything else. The search stops at the first matching definition.
+///
 /// Once a definition is found, definition search will collect location and
 /// source information about it. Moreover, it is at this point that the function
 /// body can be inspected and rewritten to perform *expansion* of the original
@@ -194,34 +224,165 @@ struct Options;
 /// }
 /// z = 5 + 1;
 /// ```
+///
+/// ### Caller Search
+///
+/// Instead of following a call to its definition, `findCallers()` goes the
+/// other way: once symbol search has found the declaration of the function
+/// under the cursor, every translation unit of the compilation database is
+/// parsed concurrently and scanned for calls whose callee has the same USR as
+/// that declaration. Each call is reported as soon as it is found.
+///
+/// `expandCallers()` goes one step further and expands each of these calls,
+/// resolving the definition only once, into replacements for
+/// `clang-apply-replacements`. Calls that cannot be expanded are listed with
+/// the reason, just as a single expansion of them would fail.
 class Search {
  public:
   using CompilationDatabase = clang::tooling::CompilationDatabase;
   using SourceVector = std::vector<std::string>;
+  using FileSystemPointer = llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>;
+  using CallFunction = llvm::function_ref<void(llvm::StringRef, const Range&)>;
 
   /// Constructs a new `Search` object with the `file`, `line` and `column`
   /// options from the command line.
   Search(const std::string& file, unsigned line, unsigned column);
 
+  /// Constructs a new `Search` object that uses the given file system cache,
+  /// which may be shared with other (consecutive) searches.
+  Search(const std::string& file,
+         unsigned line,
+         unsigned column,
+         llvm::IntrusiveRefCntPtr<CachingFileSystem> fileSystem);
+
   /// Runs the search on the given sources and with the given options.
-  /// \returns A `Result`, ready to be printed to the console.
-  Result run(CompilationDatabase& compilationDatabase,
-             const SourceVector& sources,
-             const Options& options);
+  ///
+  /// Nothing is printed and the process is never exited, so a single process
+  /// may run any number of searches.
+  ///
+  /// \returns A `Result`, ready to be printed to the console, or an `Error`
+  /// describing why the search failed.
+  llvm::Expected<Result> run(CompilationDatabase& compilationDatabase,
+                             const SourceVector& sources,
+                             const Options& options);
+
+  /// Finds all calls to the function at the location, in every source of the
+  /// compilation database (as well as the given `sources`). `onCall` is called
+  /// with the real path of the file and the range of each call as soon as it
+  /// is found, one call at a time. Calls found in several translation units
+  /// (i.e. in headers) are reported once. Only the declaration-related options
+  /// apply, besides those for sharding, pruning, memory and time.
+  ///
+  /// If the search times out, the calls reported so far may be incomplete.
+  ///
+  /// \returns The number of calls found, or an `Error` describing why the
+  /// search failed.
+  llvm::Expected<unsigned> findCallers(CompilationDatabase& compilationDatabase,
+                                       const SourceVector& sources,
+                                       const Options& options,
+                                       CallFunction onCall);
+
+  /// Expands every call to the function at the location, in every source of
+  /// the compilation database (as well as the given `sources`). The definition
+  /// is searched for as by `run()`, with sharding applying only to the sources
+  /// scanned for calls, so that each shard yields its own replacements.
+  ///
+  /// \returns The replacements of all expanded calls and the calls that were
+  /// refused, or an `Error` describing why the search failed.
+  llvm::Expected<CallerSearch::Expansions>
+  expandCallers(CompilationDatabase& compilationDatabase,
+                const SourceVector& sources,
+                const Options& options);
+
+  /// Makes symbol search use the `unit` of the file at the location instead of
+  /// parsing the file from scratch. A null `unit` is parsed (with a
+  /// precompiled preamble), any other one is reparsed, which only parses the
+  /// main file again. The `unit` is kept up to date for the caller to pass to
+  /// later searches. It must outlive the search.
+  void retainTranslationUnit(std::unique_ptr<clang::ASTUnit>& unit) noexcept;
 
  private:
   /// Performs the symbol search phase. Decorates the `Query` with
   /// `DeclarationData` and `CallData`, as well as possibly `DefinitionData`.
-  void _symbolSearch(CompilationDatabase& compilationDatabase, Query& query);
+  /// If given, the `speculation` is started as soon as the name of the
+  /// function is known.
+  llvm::Error _symbolSearch(CompilationDatabase& compilationDatabase,
+                            Query& query,
+                            DefinitionSearch::Speculation* speculation);
+
+  /// Performs symbol search on the retained translation unit, parsing or
+  /// reparsing it first.
+  /// \returns False if symbol search must parse the file as usual instead,
+  /// else true.
+  bool _searchRetainedUnit(
+      CompilationDatabase& compilationDatabase,
+      Query& query,
+      const std::function<void(llvm::StringRef)>& onSpelling);
 
   /// Performs the definition search phase. Decorates the `Query` with
-  /// `DefinitionData`.
-  void _definitionSearch(CompilationDatabase& compilationDatabase,
-                         const SourceVector& sources,
-                         Query& query);
+  /// `DefinitionData`, or records an error in it. Sources the `speculation`
+  /// (if any) has already parsed are not parsed again.
+  ///
+  /// \returns The number of candidate sources that failed to compile.
+  unsigned _definitionSearch(CompilationDatabase& compilationDatabase,
+                             const SourceVector& sources,
+                             Query& query,
+                             DefinitionSearch::Speculation* speculation);
+
+  /// Collects the sources that may call the function declared at the
+  /// `declaration`: the shard of all `sources` in the compilation database
+  /// (see `options.shardIndex`), pruned to those including the declaration if
+  /// `options.pruneByIncludes` is set.
+  SourceVector
+  _collectCallerCandidates(CompilationDatabase& compilationDatabase,
+                           const SourceVector& sources,
+                           const Options& options,
+                           const Location& declaration);
+
+  /// Returns the error for a cancelled search.
+  llvm::Error _cancelled() const;
+
+  /// Returns whatever a search that ran past its deadline found, flagged as
+  /// partial.
+  Result _partial(Query&& query) const;
+
+  /// Maps the (unsaved) `files` over the `_cachingFileSystem` in memory.
+  FileSystemPointer
+  _overlayUnsavedFiles(const llvm::StringMap<std::string>& files);
+
+  /// Searches the single file that the external definition map or clangd
+  /// index given in the options lists as defining the function's USR.
+  /// \returns True if the definition was found, else false.
+  bool _searchIndexedDefinition(CompilationDatabase& compilationDatabase,
+                                Query& query);
+
+  /// Searches the serialized AST file the build emitted for the `source`, if
+  /// it exists and is up to date.
+  /// \returns False if the source must be parsed instead, else true.
+  bool _searchASTFile(CompilationDatabase& compilationDatabase,
+                      const std::string& source,
+                      DefinitionSearch::IncludeGraph& includeGraph,
+                      Query& query);
+
+  /// The pool that filenames and names of the search are interned in, shared
+  /// with its results. Declared before anything interned in it.
+  std::shared_ptr<StringPool> _strings;
 
   /// The target location, created from the constructor arguments.
   Location _location;
+
+  /// Caches `stat` results and file contents of the real file system across
+  /// translation units.
+  llvm::IntrusiveRefCntPtr<CachingFileSystem> _cachingFileSystem;
+
+  /// The file system shared by all clang tools of the search. This is the
+  /// `_cachingFileSystem`, possibly with the unsaved files of the query
+  /// overlaid in memory.
+  FileSystemPointer _fileSystem;
+
+  /// The translation unit of the file at the location, kept by the caller
+  /// across searches, if any.
+  std::unique_ptr<clang::ASTUnit>* _retainedUnit{nullptr};
 };
 }  // namespace ClangExpand
 
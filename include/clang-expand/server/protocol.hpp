@@ -0,0 +1,113 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_SERVER_PROTOCOL_HPP
+#define CLANG_EXPAND_SERVER_PROTOCOL_HPP
+
+// Standard includes
+#include <string>
+#include <vector>
+
+namespace ClangExpand {
+namespace Server {
+
+/// \defgroup Server Server
+///
+/// A resident clang-expand process (started with `--server=<socket>`) accepts
+/// queries over a Unix domain socket, so that a small client that does not
+/// link LLVM (`clang-expand-client`) can forward its command line instead of
+/// loading and initializing clang for every invocation.
+///
+/// The protocol is deliberately trivial, as both ends run on the same machine
+/// and are built from the same sources: every message is a sequence of fields,
+/// each a native 32-bit length followed by that many bytes. One connection
+/// carries exactly one request and one response.
+///
+/// Nothing in this header (or its implementation) may depend on LLVM, since
+/// it is shared with the client.
+
+/// \ingroup Server
+///
+/// A command line to run on the server, with the context it was invoked in.
+struct Request {
+  /// The working directory of the client.
+  std::string workingDirectory;
+
+  /// The command line arguments of the client, without the program name.
+  std::vector<std::string> arguments;
+
+  /// The input of the client (the contents of unsaved files, see `-unsaved`).
+  std::string input;
+};
+
+/// \ingroup Server
+///
+/// The outcome of running a `Request`.
+struct Response {
+  /// The exit code the client should exit with.
+  int exitCode;
+
+  /// What the client should print to stdout.
+  std::string output;
+
+  /// What the client should print to stderr.
+  std::string errors;
+};
+
+/// \ingroup Server
+///
+/// Returns the socket through which clients talk to the server by default.
+/// This is `$CLANG_EXPAND_SOCKET` if set, else `clang-expand.sock` inside a
+/// directory only accessible to the current user (`$XDG_RUNTIME_DIR`, or
+/// `/tmp/clang-expand-<uid>`, which is created if necessary).
+std::string getDefaultSocketPath();
+
+/// \ingroup Server
+///
+/// Writes a `Request` to the socket.
+/// \returns True on success, else false.
+bool sendRequest(int socket, const Request& request);
+
+/// \ingroup Server
+///
+/// Reads a `Request` from the socket.
+/// \returns True on success, else false.
+bool receiveRequest(int socket, Request& request);
+
+/// \ingroup Server
+///
+/// Writes a `Response` to the socket.
+/// \returns True on success, else false.
+bool sendResponse(int socket, const Response& response);
+
+/// \ingroup Server
+///
+/// Reads a `Response` from the socket.
+/// \returns True on success, else false.
+bool receiveResponse(int socket, Response& response);
+
+}  // namespace Server
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_SERVER_PROTOCOL_HPP
@@ -0,0 +1,92 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_SERVER_SERVER_HPP
+#define CLANG_EXPAND_SERVER_SERVER_HPP
+
+// Project includes
+#include "clang-expand/server/protocol.hpp"
+
+// Standard includes
+#include <functional>
+#include <string>
+
+namespace ClangExpand {
+namespace Server {
+
+/// \ingroup Server
+///
+/// Handles a `Request`, returning the exit code of the command line it holds.
+/// Anything the handler writes to stdout or stderr is sent back to the client.
+using Handler = std::function<int(const Request&)>;
+
+/// \ingroup Server
+///
+/// Prepares the server for a `Request` before it is handled, e.g. by reading
+/// files the request is likely to need. In fork mode, this runs in the server
+/// itself, so that whatever it builds up is inherited by the child answering
+/// the request and by every child forked after it.
+using Preparer = std::function<void(const Request&)>;
+
+/// \ingroup Server
+///
+/// How the server answers requests.
+enum class Mode {
+  /// One after the other, in the server process. State built up by one request
+  /// (such as cached files) benefits all later requests, but a crash in one
+  /// request takes the server down.
+  InProcess,
+
+  /// In a forked copy of the server per request, which inherits all state the
+  /// server built up before it started listening or while preparing requests
+  /// (copy-on-write) and exits after answering. Crashes (and `exit()`s) only
+  /// affect their own request, and up to one request per core is answered
+  /// concurrently.
+  Fork,
+};
+
+/// \ingroup Server
+///
+/// Accepts requests on the socket and answers them with the handler, one at a
+/// time (or concurrently, see `Mode`), until no request arrives for
+/// `idleTimeoutSeconds`. In fork mode, each request is first passed to
+/// `prepare` (if given) in the server process.
+///
+/// If another server is already listening on the socket, returns immediately
+/// (so that clients racing to start a server are harmless). A socket left
+/// behind by a server that died is replaced. Starting and stopping servers is
+/// serialized by a lock on the file `<socketPath>.lock`, and a server only
+/// removes the socket on exit if it is still the one it created.
+///
+/// \returns The exit code for the server process.
+int serve(const std::string& socketPath,
+          const Handler& handler,
+          Mode mode = Mode::InProcess,
+          unsigned idleTimeoutSeconds = 30 * 60,
+          const Preparer& prepare = nullptr);
+
+}  // namespace Server
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_SERVER_SERVER_HPP
@@ -0,0 +1,134 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_EXPAND_SESSION_HPP
+#define CLANG_EXPAND_SESSION_HPP
+
+// Project includes
+#include "clang-expand/common/caching-file-system.hpp"
+#include "clang-expand/common/cancellation-token.hpp"
+#include "clang-expand/options.hpp"
+
+// LLVM includes
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTUnit;
+namespace tooling {
+class CompilationDatabase;
+}
+}
+
+namespace ClangExpand {
+struct Result;
+
+/// State shared by consecutive searches of a long-lived process (e.g. an
+/// editor that links clang-expand as a library).
+///
+/// A `Session` owns the compilation database and the file system cache, which
+/// are kept alive across searches so that only the first search pays for
+/// loading and reading them. The cache is refreshed before every search, so
+/// files changed on disk in the meantime are read again. Files that are
+/// searched often (e.g. those open in an editor) can be `retain()`ed, which
+/// keeps their AST alive and only reparses what changed for every search.
+///
+/// Searches of one session run one at a time; `run()` may be called from
+/// several threads, but blocks until earlier searches have finished. The
+/// search currently running, along with any waiting for it, can be cancelled
+/// from any thread with `cancel()`.
+class Session {
+ public:
+  using CompilationDatabase = clang::tooling::CompilationDatabase;
+  using SourceVector = std::vector<std::string>;
+
+  /// Loads the compilation database from the `buildDirectory` (i.e. the
+  /// directory containing `compile_commands.json`) and creates a session for
+  /// it. The `sources` are searched for definitions in addition to any found
+  /// through the options.
+  static llvm::Expected<std::unique_ptr<Session>>
+  Load(const std::string& buildDirectory, SourceVector sources);
+
+  /// Constructor, taking the compilation database and sources to search for
+  /// definitions.
+  Session(std::unique_ptr<CompilationDatabase> compilationDatabase,
+          SourceVector sources);
+
+  /// Destructor.
+  ~Session();
+
+  /// Runs a `Search` for the function called at the given location.
+  ///
+  /// The `cancellation` of the `options` is replaced with a token of the
+  /// session's own, created for this search as soon as it is called.
+  llvm::Expected<Result>
+  run(const std::string& file, unsigned line, unsigned column, Options options);
+
+  /// Keeps the AST of the `file` alive after searches in it, so that symbol
+  /// search in it only reparses the main file (see
+  /// `Search::retainTranslationUnit()`). The AST is parsed on the first search.
+  void retain(const std::string& file);
+
+  /// Drops the AST of the `file`, if it was retained.
+  void release(const std::string& file);
+
+  /// Cancels the search currently running, if any, as well as all searches
+  /// waiting for it to finish. May be called from any thread.
+  void cancel() noexcept;
+
+ private:
+  /// The compilation database of the project.
+  std::unique_ptr<CompilationDatabase> _compilationDatabase;
+
+  /// Sources to search for definitions.
+  SourceVector _sources;
+
+  /// The file system cache shared by all searches.
+  llvm::IntrusiveRefCntPtr<CachingFileSystem> _fileSystem;
+
+  /// The ASTs of retained files (null until their first search), by absolute
+  /// path. Guarded by the `_mutex`.
+  llvm::StringMap<std::unique_ptr<clang::ASTUnit>> _units;
+
+  /// The tokens of the search currently running and those waiting to run,
+  /// through which `cancel()` reaches them.
+  std::vector<std::shared_ptr<CancellationToken>> _cancellations;
+
+  /// Guards the `_cancellations`. Never held for longer than it takes to
+  /// update or walk them, unlike the `_mutex`.
+  std::mutex _cancellationMutex;
+
+  /// Serializes searches.
+  std::mutex _mutex;
+};
+}  // namespace ClangExpand
+
+#endif  // CLANG_EXPAND_SESSION_HPP
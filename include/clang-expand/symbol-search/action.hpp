@@ -33,15 +33,18 @@
 #include <clang/Frontend/FrontendAction.h>
 
 // Standard includes
+#include <functional>
 #include <memory>
 #include <string>
 
 namespace clang {
+class ASTUnit;
 class CompilerInstance;
 class ASTConsumer;
 }
 
 namespace llvm {
+class Error;
 class StringRef;
 }
 
@@ -73,10 +76,15 @@ class Action : public clang::ASTFrontendAction {
  public:
   using super = clang::ASTFrontendAction;
   using ASTConsumerPointer = std::unique_ptr<clang::ASTConsumer>;
+  using SpellingCallback = std::function<void(llvm::StringRef)>;
 
   /// Constructor, taking the location at which to look for a function call and
-  /// the ongoing `Query` object.
-  Action(Location targetLocation, Query& query);
+  /// the ongoing `Query` object. The optional `onSpelling` is called with the
+  /// spelling of the token under the cursor as soon as it is known, long
+  /// before the translation unit has been parsed.
+  Action(Location targetLocation,
+         Query& query,
+         SpellingCallback onSpelling = {});
 
   /// Attempts to translate the `targetLocation` to a `clang::SourceLocation`
   /// and install preprocessor hooks for macros.
@@ -88,6 +96,10 @@ class Action : public clang::ASTFrontendAction {
                                        llvm::StringRef filename) override;
 
  private:
+  /// Records the `error` in the `Query`.
+  /// \returns False, to abort the action.
+  bool _fail(llvm::Error error);
+
   /// Given a `clang::CompilerInstance`, installs appropriate preprocessor
   /// hooks for macro search (looking for macros with the name of the target
   /// function) with the `CompilerInstance`.
@@ -96,6 +108,9 @@ class Action : public clang::ASTFrontendAction {
   /// The spelling (name/string) of the token under the cursor.
   std::string _spelling;
 
+  /// Called with the `_spelling` once it is known.
+  SpellingCallback _onSpelling;
+
   /// The ongoing `Query` object.
   Query& _query;
 
@@ -109,6 +124,21 @@ class Action : public clang::ASTFrontendAction {
   clang::SourceLocation _callLocation;
 };
 
+/// \ingroup SymbolSearch
+///
+/// Does the work of an `Action` on the already parsed `unit` of the file
+/// containing the `targetLocation`, instead of parsing it again. Macros are
+/// only seen while preprocessing, so a token that ever named a macro is left
+/// to an `Action`.
+///
+/// \returns False if the `unit` cannot answer the `query` (because the token
+/// under the cursor may be a macro), else true, even if an error was recorded
+/// in the `query`.
+bool searchUnit(clang::ASTUnit& unit,
+                const Location& targetLocation,
+                Query& query,
+                const Action::SpellingCallback& onSpelling = {});
+
 }  // namespace SymbolSearch
 }  // namespace ClangExpand
 
@@ -30,6 +30,7 @@
 
 // Clang includes
 #include <clang/AST/ASTConsumer.h>
+#include <clang/AST/DeclGroup.h>
 
 // Standard includes
 #include <string>
@@ -84,6 +85,9 @@ class Consumer : public clang::ASTConsumer {
            std::string callSpelling,
            Query& query);
 
+  /// Stops parsing once the query is cancelled.
+  bool HandleTopLevelDecl(clang::DeclGroupRef) override;
+
   /// Creates an appropriate match expression and dispatches the
   /// `SymbolSearch::MatchHandler`
   void HandleTranslationUnit(clang::ASTContext& context) override;
@@ -92,6 +96,9 @@ class Consumer : public clang::ASTConsumer {
   /// The spelling (string representation) of the invoked function.
   const std::string _callSpelling;
 
+  /// The ongoing `Query` object.
+  Query& _query;
+
   /// Our callback class for ASTMatcher matches.
   MatchHandler _matchHandler;
 };
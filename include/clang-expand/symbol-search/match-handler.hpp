@@ -27,6 +27,10 @@
 
 // Clang includes
 #include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/ASTMatchers/ASTMatchers.h>
+
+// Standard includes
+#include <string>
 
 namespace clang {
 class SourceLocation;
@@ -76,6 +80,22 @@ class MatchHandler : public clang::ast_matchers::MatchFinder::MatchCallback {
   Query& _query;
 };
 
+/// \ingroup SymbolSearch
+///
+/// Creates the matcher for function or method call expressions as well as
+/// constructor invocations with the `spelling`, whose matches the
+/// `MatchHandler` (and `collectMatch()`) handle.
+clang::ast_matchers::StatementMatcher
+createMatcher(const std::string& spelling);
+
+/// \ingroup SymbolSearch
+///
+/// Does the work of the `MatchHandler` for a match of `createMatcher()`,
+/// regardless of where the call is: collects `CallData` (if wanted),
+/// `DeclarationData` and, if the declaration is also a definition,
+/// `DefinitionData` into the `query`, or records why it failed.
+void collectMatch(const MatchHandler::MatchResult& result, Query& query);
+
 }  // namespace SymbolSearch
 }  // namespace ClangExpand
 
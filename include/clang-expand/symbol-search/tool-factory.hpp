@@ -25,6 +25,9 @@
 #ifndef CLANG_EXPAND_SYMBOL_SEARCH_TOOL_FACTORY_HPP
 #define CLANG_EXPAND_SYMBOL_SEARCH_TOOL_FACTORY_HPP
 
+// Project includes
+#include "clang-expand/symbol-search/action.hpp"
+
 // Clang includes
 #include <clang/Frontend/FrontendAction.h>
 #include <clang/Tooling/Tooling.h>
@@ -45,9 +48,14 @@ namespace SymbolSearch {
 /// does not allow passing parameters to an action.
 class ToolFactory : public clang::tooling::FrontendActionFactory {
  public:
-  /// Constructor, taking the location the user invoked clang-expand with and
-  /// the fresh `Query` object.
-  explicit ToolFactory(const Location& _targetLocation, Query& query);
+  using SpellingCallback = Action::SpellingCallback;
+
+  /// Constructor, taking the location the user invoked clang-expand with, the
+  /// fresh `Query` object and an optional callback for the spelling of the
+  /// token under the cursor (see `SymbolSearch::Action`).
+  explicit ToolFactory(const Location& _targetLocation,
+                       Query& query,
+                       SpellingCallback onSpelling = {});
 
   /// Creates the action of the symbol search phase.
   /// \returns A `SymbolSearch::Action`.
@@ -59,6 +67,9 @@ class ToolFactory : public clang::tooling::FrontendActionFactory {
 
   /// The newly created `Query` object.
   Query& _query;
+
+  /// Passed on to every `SymbolSearch::Action`.
+  SpellingCallback _onSpelling;
 };
 }  // namespace SymbolSearch
 }  // namespace ClangExpand
@@ -0,0 +1,167 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/clang-expand.h"
+#include "clang-expand/common/routines.hpp"
+#include "clang-expand/error.hpp"
+#include "clang-expand/options.hpp"
+#include "clang-expand/result.hpp"
+#include "clang-expand/session.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct clang_expand_session {
+  /// The session doing the work.
+  std::unique_ptr<ClangExpand::Session> session;
+
+  /// The `clang_expand_session_flags` the session was created with.
+  unsigned flags;
+
+  /// How long each query may take, in milliseconds (zero for no limit).
+  std::atomic<unsigned> timeout{0};
+};
+
+struct clang_expand_result {
+  /// The result or error, as JSON.
+  std::string json;
+
+  /// Whether the query failed.
+  bool isError;
+};
+
+namespace {
+/// Creates the options for a query from the session and query flags.
+ClangExpand::Options makeOptions(unsigned sessionFlags, unsigned queryFlags) {
+  // clang-format off
+  ClangExpand::Options options = {
+    (queryFlags & CLANG_EXPAND_QUERY_CALL) != 0,
+    (queryFlags & CLANG_EXPAND_QUERY_DECLARATION) != 0,
+    (queryFlags & CLANG_EXPAND_QUERY_DEFINITION) != 0,
+    (queryFlags & CLANG_EXPAND_QUERY_REWRITE) != 0
+  };
+  // clang-format on
+  options.wantsStatistics = (queryFlags & CLANG_EXPAND_QUERY_STATISTICS) != 0;
+  options.wantsAllDefinitions =
+      (queryFlags & CLANG_EXPAND_QUERY_ALL_DEFINITIONS) != 0;
+  options.wantsByteOffsets =
+      (queryFlags & CLANG_EXPAND_QUERY_BYTE_OFFSETS) != 0;
+  options.searchAllSources =
+      (sessionFlags & CLANG_EXPAND_SESSION_ALL_SOURCES) != 0;
+  options.pruneByIncludes = (sessionFlags & CLANG_EXPAND_SESSION_PRUNE) != 0;
+  return options;
+}
+}  // namespace
+
+unsigned clang_expand_get_version(void) {
+  return CLANG_EXPAND_C_API_VERSION;
+}
+
+clang_expand_session* clang_expand_session_create(const char* build_directory,
+                                                  const char* const* sources,
+                                                  unsigned num_sources,
+                                                  unsigned flags) {
+  if (build_directory == nullptr) return nullptr;
+
+  ClangExpand::Session::SourceVector sourceVector;
+  for (unsigned index = 0; index < num_sources; ++index) {
+    sourceVector.emplace_back(sources[index]);
+  }
+
+  auto session = ClangExpand::Session::Load(build_directory,
+                                            std::move(sourceVector));
+  if (!session) {
+    llvm::consumeError(session.takeError());
+    return nullptr;
+  }
+
+  return new clang_expand_session{std::move(*session), flags};
+}
+
+void clang_expand_session_dispose(clang_expand_session* session) {
+  delete session;
+}
+
+clang_expand_result*
+clang_expand_query(clang_expand_session* session,
+                   const char* file,
+                   unsigned line,
+                   unsigned column,
+                   unsigned flags,
+                   const clang_expand_unsaved_file* unsaved_files,
+                   unsigned num_unsaved_files) {
+  auto options = makeOptions(session->flags, flags);
+  options.timeout = std::chrono::milliseconds(session->timeout.load());
+  for (unsigned index = 0; index < num_unsaved_files; ++index) {
+    const auto& unsaved = unsaved_files[index];
+    const auto path = ClangExpand::Routines::makeAbsolute(unsaved.filename);
+    options.unsavedFiles[path].assign(unsaved.contents, unsaved.length);
+  }
+
+  auto result =
+      session->session->run(file, line, column, std::move(options));
+  if (!result) {
+    nlohmann::json json;
+    llvm::handleAllErrors(result.takeError(),
+                          [&json](const ClangExpand::Error& error) {
+                            json["error"] = error.toJson();
+                          });
+    return new clang_expand_result{json.dump(), true};
+  }
+
+  return new clang_expand_result{result->toJson().dump(), false};
+}
+
+void clang_expand_session_set_timeout(clang_expand_session* session,
+                                      unsigned milliseconds) {
+  session->timeout.store(milliseconds);
+}
+
+void clang_expand_cancel(clang_expand_session* session) {
+  session->session->cancel();
+}
+
+int clang_expand_result_is_error(const clang_expand_result* result) {
+  return result->isError ? 1 : 0;
+}
+
+const char* clang_expand_result_get_json(const clang_expand_result* result) {
+  return result->json.c_str();
+}
+
+void clang_expand_result_dispose(clang_expand_result* result) {
+  delete result;
+}
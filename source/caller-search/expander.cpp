@@ -0,0 +1,330 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/caller-search/expander.hpp"
+#include "clang-expand/caller-search/match-handler.hpp"
+#include "clang-expand/caller-search/scanner.hpp"
+#include "clang-expand/common/call-data.hpp"
+#include "clang-expand/common/canonical-location.hpp"
+#include "clang-expand/common/declaration-data.hpp"
+#include "clang-expand/common/expansion-template.hpp"
+#include "clang-expand/common/query.hpp"
+#include "clang-expand/options.hpp"
+#include "clang-expand/symbol-search/match-handler.hpp"
+
+// Clang includes
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/AST/Expr.h>
+#include <clang/AST/ExprCXX.h>
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/Basic/CharInfo.h>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Index/USRGeneration.h>
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <tuple>
+#include <utility>
+
+namespace ClangExpand {
+namespace CallerSearch {
+namespace {
+/// Finds the definition of the function with the USR of the declaration.
+const clang::FunctionDecl*
+findDefinition(clang::ASTContext& context,
+               const DeclarationData& declaration) {
+  using namespace clang::ast_matchers;  // NOLINT(build/namespaces)
+  const auto matcher =
+      functionDecl(isDefinition(), hasName(declaration.name)).bind("fn");
+
+  for (const auto& nodes : match(decl(matcher), context)) {
+    const auto* function = nodes.getNodeAs<clang::FunctionDecl>("fn");
+    llvm::SmallString<128> usr;
+    if (clang::index::generateUSRForDecl(function, usr)) continue;
+    if (usr == declaration.usr) return function;
+  }
+
+  return nullptr;
+}
+
+/// Returns the call or construction of a match, or null if the function bound
+/// in the match is only mentioned somewhere inside a call to something else
+/// (e.g. passed as an argument).
+const clang::Expr* getCall(const Expander::MatchResult& result,
+                           const clang::FunctionDecl& function) {
+  if (const auto* call = result.Nodes.getNodeAs<clang::CallExpr>("call")) {
+    const auto* callee = call->getDirectCallee();
+    if (callee == nullptr) return nullptr;
+    if (callee->getCanonicalDecl() != function.getCanonicalDecl()) {
+      return nullptr;
+    }
+    return call;
+  }
+
+  return result.Nodes.getNodeAs<clang::CXXConstructExpr>("construct");
+}
+
+/// Indents all but the first line of the `text` like the line beginning at
+/// the `location`, so that the expansion lines up with the code around it.
+std::string indentLike(const std::string& text,
+                       const clang::SourceLocation& location,
+                       const clang::SourceManager& sourceManager) {
+  const auto column = sourceManager.getSpellingColumnNumber(location);
+  bool invalid = false;
+  const char* data = sourceManager.getCharacterData(location, &invalid);
+  if (invalid || column <= 1) return text;
+
+  const llvm::StringRef linePrefix(data - (column - 1), column - 1);
+  const auto indentation = linePrefix.take_while(
+      [](char character) { return clang::isHorizontalWhitespace(character); });
+
+  llvm::SmallVector<llvm::StringRef, 16> lines;
+  llvm::StringRef(text).split(lines, '\n');
+
+  std::string indented = lines.front();
+  for (unsigned index = 1; index < lines.size(); ++index) {
+    indented += '\n';
+    if (lines[index].empty()) continue;
+    indented += indentation;
+    indented += lines[index];
+  }
+
+  return indented;
+}
+}  // namespace
+
+nlohmann::json Refusal::toJson() const {
+  // clang-format off
+  return {
+    {"filename", filename},
+    {"range", range.toJson()},
+    {"reason", reason}
+  };
+  // clang-format on
+}
+
+nlohmann::json Expansions::toJson() const {
+  auto refused = nlohmann::json::array();
+  for (const auto& refusal : refusals) {
+    refused.push_back(refusal.toJson());
+  }
+
+  // clang-format off
+  return {
+    {"expanded", replacements.Replacements.size()},
+    {"refused", std::move(refused)}
+  };
+  // clang-format on
+}
+
+Expander::Expander(const Query& query,
+                   Scanner& scanner,
+                   std::unique_ptr<clang::ASTUnit> definitionUnit)
+: _query(query), _scanner(scanner) {
+  if (!definitionUnit) return;
+
+  auto& context = definitionUnit->getASTContext();
+  if (const auto* definition = findDefinition(context, *_query.declaration)) {
+    _outOfLineTemplate = ExpansionTemplate::Build(*definition, context);
+  }
+}
+
+void Expander::expandCalls(clang::ASTContext& context) {
+  // Templates of definitions in this translation unit die with its AST.
+  struct Handler : clang::ast_matchers::MatchFinder::MatchCallback {
+    explicit Handler(Expander& expander_) : expander(expander_) {
+    }
+
+    void run(const MatchResult& result) override {
+      expander._expand(result, templates);
+    }
+
+    Expander& expander;
+    TemplateMap templates;
+  };
+
+  Handler handler(*this);
+  const auto matcher = SymbolSearch::createMatcher(_query.declaration->name);
+  clang::ast_matchers::MatchFinder finder;
+  finder.addMatcher(matcher, &handler);
+  finder.matchAST(context);
+}
+
+void Expander::_expand(const MatchResult& result, TemplateMap& templates) {
+  if (_query.isCancelled()) return;
+
+  const auto* function = result.Nodes.getNodeAs<clang::FunctionDecl>("fn");
+  assert(function != nullptr && "Got null function node in expander");
+
+  const auto* call = getCall(result, *function);
+  if (call == nullptr) return;
+
+  llvm::SmallString<128> usr;
+  if (clang::index::generateUSRForDecl(function, usr)) return;
+  if (usr != _query.declaration->usr) return;
+
+  const auto& sourceManager = result.Context->getSourceManager();
+  const auto range = getCallRange(*call, *result.Context);
+  if (range.isInvalid()) return;
+
+  const CanonicalLocation canonical(range.getBegin(), sourceManager);
+  const auto filename = canonical.getFilename(*_query.strings);
+  if (!_scanner.claim(filename, canonical.offset)) return;
+
+  // Refused calls are reported in the encoding the user asked for.
+  const auto encoding = _query.getOffsetEncoding();
+
+  // The text of a macro is shared by all its expansions.
+  if (call->getLocStart().isMacroID()) {
+    _refuse(filename,
+            Range(range, sourceManager, encoding),
+            "Refuse to expand call inside a macro expansion");
+    return;
+  }
+
+  // Only the call and the parameter map are collected for each call, the
+  // definition is rewritten from its template. Cancellation is up to the
+  // whole search, not each call. Byte offsets are all a replacement needs,
+  // and spare computing the lines of every file with a call.
+  // clang-format off
+  Options options = {
+    /*wantsCall=*/true,
+    /*wantsDeclaration=*/true,
+    /*wantsDefinition=*/false,
+    /*wantsRewritten=*/false
+  };
+  // clang-format on
+
+  options.wantsByteOffsets = true;
+
+  Query callQuery(std::move(options), _query.strings);
+  SymbolSearch::collectMatch(result, callQuery);
+  if (callQuery.error) {
+    _refuse(filename,
+            Range(range, sourceManager, encoding),
+            callQuery.error->getMessage());
+    return;
+  }
+
+  assert(callQuery.call && "Should have call data after collecting the match");
+
+  const ExpansionTemplate* expansionTemplate = nullptr;
+  const clang::FunctionDecl* definition = nullptr;
+  if (function->hasBody(definition)) {
+    auto iterator = templates.find(definition);
+    if (iterator == templates.end()) {
+      auto built = ExpansionTemplate::Build(*definition, *result.Context);
+      iterator = templates.insert({definition, std::move(built)}).first;
+    }
+    expansionTemplate = &iterator->second;
+  } else if (_outOfLineTemplate) {
+    expansionTemplate = _outOfLineTemplate.getPointer();
+  } else {
+    _refuse(filename,
+            Range(range, sourceManager, encoding),
+            "Could not find the definition in a translation unit of its own");
+    return;
+  }
+
+  auto text = expansionTemplate->instantiate(
+      callQuery.declaration->parameterMap, *callQuery.call);
+  if (!text) {
+    _refuse(filename,
+            Range(range, sourceManager, encoding),
+            llvm::toString(text.takeError()));
+    return;
+  }
+
+  // The extent reaches from any declared variable to the semicolon, which is
+  // included in it.
+  const auto& extent = callQuery.call->extent;
+  const auto offset = extent.begin.byte;
+  const auto length = extent.end.byte + 1 - offset;
+  const auto fileID = sourceManager.getFileID(range.getBegin());
+  const auto begin = sourceManager.getComposedLoc(fileID, offset);
+
+  clang::tooling::Replacement replacement(filename,
+                                          offset,
+                                          length,
+                                          indentLike(*text,
+                                                     begin,
+                                                     sourceManager));
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _replacements.emplace_back(std::move(replacement));
+}
+
+Expansions Expander::takeExpansions(const std::string& mainSourceFile) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  std::sort(_replacements.begin(),
+            _replacements.end(),
+            [](const auto& a, const auto& b) {
+              return std::make_tuple(a.getFilePath(), a.getOffset()) <
+                     std::make_tuple(b.getFilePath(), b.getOffset());
+            });
+
+  std::sort(_refusals.begin(),
+            _refusals.end(),
+            [](const Refusal& a, const Refusal& b) {
+              return std::tie(a.filename,
+                              a.range.begin.line,
+                              a.range.begin.column,
+                              a.range.begin.byte) <
+                     std::tie(b.filename,
+                              b.range.begin.line,
+                              b.range.begin.column,
+                              b.range.begin.byte);
+            });
+
+  Expansions expansions;
+  expansions.replacements.MainSourceFile = mainSourceFile;
+  expansions.replacements.Replacements = std::move(_replacements);
+  expansions.refusals = std::move(_refusals);
+  _replacements.clear();
+  _refusals.clear();
+
+  return expansions;
+}
+
+void Expander::_refuse(llvm::StringRef filename,
+                       Range range,
+                       std::string reason) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _refusals.push_back({filename.str(), range, std::move(reason)});
+}
+
+}  // namespace CallerSearch
+}  // namespace ClangExpand
@@ -0,0 +1,106 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/caller-search/match-handler.hpp"
+#include "clang-expand/common/canonical-location.hpp"
+#include "clang-expand/common/declaration-data.hpp"
+#include "clang-expand/common/query.hpp"
+#include "clang-expand/common/range.hpp"
+
+// Clang includes
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/AST/DeclCXX.h>
+#include <clang/AST/Expr.h>
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Index/USRGeneration.h>
+#include <clang/Lex/Lexer.h>
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+
+// Standard includes
+#include <cassert>
+#include <string>
+
+namespace ClangExpand {
+namespace CallerSearch {
+
+MatchHandler::MatchHandler(const Query& query, ReportFunction report)
+: _query(query), _report(report) {
+}
+
+clang::ast_matchers::StatementMatcher MatchHandler::getMatcher() const {
+  using namespace clang::ast_matchers;  // NOLINT(build/namespaces)
+
+  const auto& name = _query.declaration->name;
+  // Constructors are called without their name, so they are matched by their
+  // declaration instead.
+  return expr(anyOf(callExpr(callee(functionDecl(hasName(name)).bind("fn"))),
+                    cxxConstructExpr(hasDeclaration(
+                        cxxConstructorDecl(hasName(name)).bind("fn")))))
+      .bind("call");
+}
+
+void MatchHandler::run(const MatchResult& result) {
+  if (_query.isCancelled()) return;
+
+  const auto* function = result.Nodes.getNodeAs<clang::FunctionDecl>("fn");
+  assert(function != nullptr && "Got null function node in match handler");
+
+  llvm::SmallString<128> usr;
+  if (clang::index::generateUSRForDecl(function, usr)) return;
+  if (usr != _query.declaration->usr) return;
+
+  const auto* call = result.Nodes.getNodeAs<clang::Expr>("call");
+  assert(call != nullptr && "Got null call node in match handler");
+
+  const auto range = getCallRange(*call, *result.Context);
+  if (range.isInvalid()) return;
+
+  const auto& sourceManager = result.Context->getSourceManager();
+  const CanonicalLocation canonical(range.getBegin(), sourceManager);
+  _report(canonical.getFilename(*_query.strings),
+          canonical.offset,
+          Range(range, sourceManager, _query.getOffsetEncoding()));
+}
+
+clang::SourceRange getCallRange(const clang::Expr& call,
+                                const clang::ASTContext& context) {
+  // Calls inside macros are reported where the macro is expanded, since that
+  // is the text the user can edit.
+  const auto& sourceManager = context.getSourceManager();
+  auto range = sourceManager.getExpansionRange(call.getSourceRange());
+  range.setEnd(clang::Lexer::getLocForEndOfToken(range.getEnd(),
+                                                 /*Offset=*/0,
+                                                 sourceManager,
+                                                 context.getLangOpts()));
+  return range;
+}
+
+}  // namespace CallerSearch
+}  // namespace ClangExpand
@@ -0,0 +1,128 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/caller-search/scanner.hpp"
+#include "clang-expand/caller-search/match-handler.hpp"
+#include "clang-expand/common/query.hpp"
+#include "clang-expand/common/range.hpp"
+#include "clang-expand/common/string-pool.hpp"
+#include "clang-expand/options.hpp"
+
+// Clang includes
+#include <clang/AST/ASTContext.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Tooling/CompilationDatabase.h>
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ClangExpand {
+namespace CallerSearch {
+
+Scanner::Scanner(CompilationDatabase& compilationDatabase,
+                 FileSystemPointer fileSystem,
+                 const Query& query)
+: _compilationDatabase(compilationDatabase)
+, _fileSystem(std::move(fileSystem))
+, _query(query)
+, _pool(_fileSystem,
+        query.options,
+        std::max(std::thread::hardware_concurrency(), 1u)) {
+}
+
+unsigned Scanner::scan(const SourceVector& sources, CallFunction onCall) {
+  std::mutex mutex;
+  unsigned count = 0;
+
+  auto report = [this, onCall, &mutex, &count](llvm::StringRef filename,
+                                               unsigned offset,
+                                               const Range& range) {
+    if (!claim(filename, offset)) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    onCall(filename, range);
+    ++count;
+  };
+
+  parseEach(sources, [this, &report](clang::ASTContext& context) {
+    MatchHandler handler(_query, report);
+    clang::ast_matchers::MatchFinder finder;
+    finder.addMatcher(handler.getMatcher(), &handler);
+    finder.matchAST(context);
+  });
+
+  return count;
+}
+
+void Scanner::parseEach(const SourceVector& sources, UnitFunction visit) {
+  using Job = DefinitionSearch::ParsePool::Job;
+
+  std::vector<Job> jobs;
+  for (const auto& source : sources) {
+    auto commands = _compilationDatabase.getCompileCommands(source);
+    if (commands.empty()) continue;
+
+    auto cost = _pool.estimateCost(source, [this, &source] {
+      auto status = _fileSystem->status(source);
+      return status ? status->getSize() : std::uint64_t{0};
+    });
+    jobs.push_back({source, std::move(commands.front()), cost});
+  }
+
+  _pool.enqueue(std::move(jobs),
+                [this, visit](const Job& job) { _parse(job, visit); });
+  _pool.wait();
+}
+
+bool Scanner::claim(llvm::StringRef filename, unsigned offset) {
+  const auto file = _query.strings->intern(filename);
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _claimed.insert({file, offset}).second;
+}
+
+void Scanner::_parse(const DefinitionSearch::ParsePool::Job& job,
+                     UnitFunction visit) {
+  auto shouldStop = [this] { return _query.isCancelled(); };
+  if (shouldStop()) return;
+
+  auto unit = _pool.parse(job, shouldStop);
+  if (!unit) return;
+
+  visit(unit->getASTContext());
+  unit.reset();
+  _pool.release(job.cost.retainedMemory);
+}
+
+}  // namespace CallerSearch
+}  // namespace ClangExpand
@@ -24,6 +24,7 @@
 
 // Project includes
 #include "clang-expand/common/assignee-data.hpp"
+#include "clang-expand/common/string-pool.hpp"
 
 // LLVM includes
 #include <llvm/ADT/Optional.h>
@@ -37,24 +38,24 @@
 
 namespace ClangExpand {
 
-AssigneeData::Type::Type(std::string name_,
-                         bool isDefaultConstructible_) noexcept
-: name(std::move(name_)), isDefaultConstructible(isDefaultConstructible_) {
+AssigneeData::Type::Type(llvm::StringRef name_, bool isDefaultConstructible_)
+: name(name_)
+, isDefaultConstructible(isDefaultConstructible_) {
 }
 
-AssigneeData::Builder::Builder(AssigneeData&& assignee)
-: _assignee(std::move(assignee)) {
+AssigneeData::Builder::Builder(StringPool& strings, AssigneeData&& assignee)
+: _assignee(std::move(assignee)), _strings(strings) {
 }
 
 AssigneeData::Builder&
 AssigneeData::Builder::name(const llvm::StringRef& name) {
-  _assignee.name = name.rtrim();
+  _assignee.name = _strings.intern(name.rtrim());
   return *this;
 }
 
 AssigneeData::Builder& AssigneeData::Builder::type(
     const llvm::StringRef& name, bool isDefaultConstructible) {
-  _assignee.type.emplace(name, isDefaultConstructible);
+  _assignee.type.emplace(_strings.intern(name), isDefaultConstructible);
   return *this;
 }
 
@@ -0,0 +1,258 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/common/caching-file-system.hpp"
+#include "clang-expand/common/line-table.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+// Standard includes
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace ClangExpand {
+namespace {
+/// A file opened through the `CachingFileSystem`. Its status comes from the
+/// `stat` cache and its contents from the buffer cache.
+class CachedFile : public clang::vfs::File {
+ public:
+  /// Constructor.
+  CachedFile(CachingFileSystem& fileSystem,
+             clang::vfs::Status status,
+             std::string key)
+  : _fileSystem(fileSystem)
+  , _status(std::move(status))
+  , _key(std::move(key)) {
+  }
+
+  /// Returns the status of the file.
+  llvm::ErrorOr<clang::vfs::Status> status() override {
+    return _status;
+  }
+
+  /// Returns the (cached) contents of the file.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+  getBuffer(const llvm::Twine&,
+            std::int64_t,
+            bool requiresNullTerminator,
+            bool) override {
+    return _fileSystem.getCachedBuffer(_key, requiresNullTerminator);
+  }
+
+  /// Nothing to close, the contents are owned by the file system.
+  std::error_code close() override {
+    return {};
+  }
+
+ private:
+  /// The file system that owns the contents of this file.
+  CachingFileSystem& _fileSystem;
+
+  /// The status of the file, with the name it was opened with.
+  clang::vfs::Status _status;
+
+  /// The cache key of the file.
+  std::string _key;
+};
+
+/// Checks if a cached `stat` result still describes the file.
+bool isUpToDate(const llvm::ErrorOr<clang::vfs::Status>& cached,
+                const llvm::ErrorOr<clang::vfs::Status>& current) {
+  if (!cached || !current) return !cached && !current;
+  return cached->getType() == current->getType() &&
+         cached->getSize() == current->getSize() &&
+         cached->getLastModificationTime() ==
+             current->getLastModificationTime();
+}
+}  // namespace
+
+nlohmann::json CachingFileSystem::Statistics::toJson() const {
+  // clang-format off
+  return {
+    {"stat", {{"hits", statHits}, {"misses", statMisses}}},
+    {"read", {{"hits", readHits}, {"misses", readMisses}}}
+  };
+  // clang-format on
+}
+
+CachingFileSystem::CachingFileSystem(FileSystemPointer underlying)
+: _underlying(std::move(underlying)) {
+}
+
+CachingFileSystem::~CachingFileSystem() {
+  for (const auto& entry : _buffers) {
+    LineTable::forget(entry.getValue()->getBuffer());
+  }
+}
+
+llvm::ErrorOr<clang::vfs::Status>
+CachingFileSystem::status(const llvm::Twine& path) {
+  const auto name = path.str();
+  const auto key = _makeKey(name);
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto iterator = _statuses.find(key);
+    if (iterator != _statuses.end()) {
+      ++_statHits;
+      const auto& status = iterator->getValue();
+      if (!status) return status.getError();
+      return clang::vfs::Status::copyWithNewName(*status, name);
+    }
+  }
+
+  ++_statMisses;
+  auto status = _underlying->status(key);
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _statuses.insert({key, status});
+  }
+
+  if (!status) return status.getError();
+  return clang::vfs::Status::copyWithNewName(*status, name);
+}
+
+llvm::ErrorOr<std::unique_ptr<clang::vfs::File>>
+CachingFileSystem::openFileForRead(const llvm::Twine& path) {
+  const auto name = path.str();
+  auto fileStatus = status(name);
+  if (!fileStatus) return fileStatus.getError();
+  if (fileStatus->isDirectory()) {
+    return std::make_error_code(std::errc::is_a_directory);
+  }
+
+  return std::make_unique<CachedFile>(*this,
+                                      std::move(*fileStatus),
+                                      _makeKey(name));
+}
+
+clang::vfs::directory_iterator
+CachingFileSystem::dir_begin(const llvm::Twine& directory,
+                             std::error_code& error) {
+  return _underlying->dir_begin(directory, error);
+}
+
+llvm::ErrorOr<std::string>
+CachingFileSystem::getCurrentWorkingDirectory() const {
+  return _underlying->getCurrentWorkingDirectory();
+}
+
+std::error_code
+CachingFileSystem::setCurrentWorkingDirectory(const llvm::Twine& path) {
+  return _underlying->setCurrentWorkingDirectory(path);
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+CachingFileSystem::getCachedBuffer(const llvm::Twine& path,
+                                   bool requiresNullTerminator) {
+  const auto key = _makeKey(path);
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto iterator = _buffers.find(key);
+    if (iterator != _buffers.end()) {
+      ++_readHits;
+      const auto reference = iterator->getValue()->getMemBufferRef();
+      return llvm::MemoryBuffer::getMemBuffer(reference,
+                                              requiresNullTerminator);
+    }
+  }
+
+  ++_readMisses;
+  auto file = _underlying->openFileForRead(key);
+  if (!file) return file.getError();
+
+  auto buffer = (*file)->getBuffer(key,
+                                   /*FileSize=*/-1,
+                                   /*RequiresNullTerminator=*/true,
+                                   /*IsVolatile=*/false);
+  if (!buffer) return buffer.getError();
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  // If another thread read the same file in the meantime, keep its buffer.
+  auto inserted = _buffers.insert({key, std::move(*buffer)});
+  if (inserted.second) {
+    LineTable::track(inserted.first->getValue()->getBuffer());
+  }
+  const auto reference = inserted.first->getValue()->getMemBufferRef();
+  return llvm::MemoryBuffer::getMemBuffer(reference, requiresNullTerminator);
+}
+
+CachingFileSystem::Statistics CachingFileSystem::getStatistics() const
+    noexcept {
+  return {_statHits, _statMisses, _readHits, _readMisses};
+}
+
+void CachingFileSystem::refresh() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto iterator = _statuses.begin(); iterator != _statuses.end();) {
+    // Erasing from a StringMap leaves other iterators valid.
+    auto entry = iterator++;
+    const auto key = entry->getKey();
+    if (isUpToDate(entry->getValue(), _underlying->status(key))) continue;
+
+    auto buffer = _buffers.find(key);
+    if (buffer != _buffers.end()) {
+      LineTable::forget(buffer->getValue()->getBuffer());
+      _buffers.erase(buffer);
+    }
+    _statuses.erase(entry);
+  }
+}
+
+std::string CachingFileSystem::_makeKey(const llvm::Twine& path) const {
+  llvm::SmallString<256> key;
+  path.toVector(key);
+
+  if (!llvm::sys::path::is_absolute(key)) {
+    auto workingDirectory = _underlying->getCurrentWorkingDirectory();
+    if (workingDirectory) {
+      llvm::SmallString<256> absolute(*workingDirectory);
+      llvm::sys::path::append(absolute, key);
+      key = std::move(absolute);
+    }
+  }
+
+  llvm::sys::path::remove_dots(key, /*remove_dot_dot=*/false);
+  return key.str();
+}
+
+}  // namespace ClangExpand
@@ -24,12 +24,15 @@
 
 // Project includes
 #include "clang-expand/common/canonical-location.hpp"
+#include "clang-expand/common/routines.hpp"
+#include "clang-expand/common/string-pool.hpp"
 
 // Clang includes
+#include <clang/Basic/FileManager.h>
 #include <clang/Basic/SourceManager.h>
 
-// Standard includes
-#include <utility>
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
 
 namespace ClangExpand {
 CanonicalLocation::CanonicalLocation(
@@ -49,4 +52,13 @@ bool CanonicalLocation::operator!=(const CanonicalLocation& other) const
     noexcept {
   return !(*this == other);
 }
+
+llvm::StringRef CanonicalLocation::getFilename(StringPool& strings) const {
+  if (file == nullptr) return {};
+
+  const auto realPath = file->tryGetRealPathName();
+  if (!realPath.empty()) return strings.intern(realPath);
+
+  return strings.intern(Routines::makeAbsolute(file->getName()));
+}
 }  // namespace ClangExpand
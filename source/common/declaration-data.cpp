@@ -25,24 +25,30 @@
 // Project includes
 #include "clang-expand/common/declaration-data.hpp"
 #include "clang-expand/common/location.hpp"
+#include "clang-expand/common/string-pool.hpp"
 
 // Third party includes
 #include <third-party/json.hpp>
 
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+
 // Standard includes
 #include <string>
 #include <utility>
 
 namespace ClangExpand {
-DeclarationData::DeclarationData(std::string name_, Location location_)
-: name(std::move(name_)), location(std::move(location_)) {
+DeclarationData::DeclarationData(llvm::StringRef name_,
+                                 Location location_,
+                                 StringPool& strings)
+: name(strings.intern(name_)), location(std::move(location_)) {
 }
 
 nlohmann::json DeclarationData::toJson() const {
   // clang-format off
     return {
       {"location", location.toJson()},
-      {"name", name},
+      {"name", name.str()},
       {"text", text}
     };
   // clang-format on
@@ -24,11 +24,10 @@
 
 // Project includes
 #include "clang-expand/common/definition-rewriter.hpp"
-#include "clang-expand/common/assignee-data.hpp"
-#include "clang-expand/common/call-data.hpp"
-#include "clang-expand/common/routines.hpp"
+#include "clang-expand/common/expansion-template.hpp"
 
 // Clang includes
+#include <clang/AST/ASTContext.h>
 #include <clang/AST/Decl.h>
 #include <clang/AST/DeclTemplate.h>
 #include <clang/AST/Expr.h>
@@ -37,63 +36,56 @@
 #include <clang/AST/Type.h>
 #include <clang/AST/TypeLoc.h>
 #include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/SourceManager.h>
 #include <clang/Rewrite/Core/Rewriter.h>
 
 // LLVM includes
 #include <llvm/ADT/APInt.h>
-#include <llvm/ADT/Optional.h>
 #include <llvm/ADT/SmallPtrSet.h>
-#include <llvm/ADT/SmallVector.h>
-#include <llvm/ADT/StringMap.h>
 #include <llvm/Support/Casting.h>
 
 // Standard includes
-#include <cassert>
+#include <algorithm>
 #include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 
 namespace ClangExpand {
 namespace {
+using HoleKind = ExpansionTemplate::HoleKind;
 
-/// Dies with an error message warning that the function could not be expanded
-/// because the assigned type is not default constructible (like `int&`).
-[[noreturn]] void dieBecauseNotDefaultConstructible() {
-  Routines::error(
-      "Could not expand function because "
-      "assignee is not default-constructible");
-}
-
-/// Tries to get the parent of a node as the given type `T`, or else errors and
-/// dies.
+/// Tries to get the parent of a node as the given type `T`.
+/// \returns The parent, or null if it is not of type `T`.
 template <typename T, typename Node>
-const T* tryToGetParentOrDie(clang::ASTContext& context, const Node& node) {
+const T* tryToGetParent(clang::ASTContext& context, const Node& node) {
   if (const auto* parent = context.getParents(node).begin()) {
-    if (const auto* asType = parent->template get<T>()) {
-      return asType;
-    }
+    return parent->template get<T>();
   }
 
-  dieBecauseNotDefaultConstructible();
+  return nullptr;
 }
 
-/// Ensures that a `ReturnStmt` would allow default construction of a variable.
+/// Checks that a `ReturnStmt` would allow default construction of a variable.
 /// This is the case if this is a top-level `return`, i.e. whose parent is the
 /// `CompoundStmt` of a function.
-void ensureReturnAllowsDefaultConstruction(
-    clang::ASTContext& context, const clang::ReturnStmt& returnStatement) {
+bool returnAllowsDefaultConstruction(clang::ASTContext& context,
+                                     const clang::ReturnStmt& returnStatement) {
   const auto* compound =
-      tryToGetParentOrDie<clang::CompoundStmt>(context, returnStatement);
-  tryToGetParentOrDie<clang::FunctionDecl>(context, *compound);
+      tryToGetParent<clang::CompoundStmt>(context, returnStatement);
+  if (!compound) return false;
+  return tryToGetParent<clang::FunctionDecl>(context, *compound) != nullptr;
 }
 }  // namespace
 
-DefinitionRewriter::DefinitionRewriter(clang::Rewriter& rewriter,
-                                       const ParameterMap& parameterMap,
-                                       const CallData& call,
+DefinitionRewriter::DefinitionRewriter(ExpansionTemplate& expansionTemplate,
+                                       const clang::SourceLocation& bodyBegin,
+                                       clang::Rewriter& rewriter,
                                        clang::ASTContext& context)
-: _rewriter(rewriter)
-, _parameterMap(parameterMap)
-, _call(call)
+: _template(expansionTemplate)
+, _bodyBegin(bodyBegin)
+, _rewriter(rewriter)
 , _context(context) {
 }
 
@@ -101,19 +93,16 @@ bool DefinitionRewriter::VisitStmt(clang::Stmt* statement) {
   const auto* nonType =
       llvm::dyn_cast<clang::SubstNonTypeTemplateParmExpr>(statement);
   if (nonType) {
-    _rewriteNonTypeTemplateParameterExpression(*nonType);
+    _recordNonTypeTemplateParameterExpression(*nonType);
   }
 
-  if (llvm::isa<clang::ReturnStmt>(statement)) {
-    if (auto* rtn = llvm::dyn_cast<clang::ReturnStmt>(statement)) {
-      _recordReturn(*rtn, _call);
-      return true;
-    }
+  if (const auto* rtn = llvm::dyn_cast<clang::ReturnStmt>(statement)) {
+    _recordReturn(*rtn);
   }
 
   if (const auto* member = llvm::dyn_cast<clang::MemberExpr>(statement)) {
     if (llvm::isa<clang::CXXThisExpr>(member->getBase()->IgnoreImplicit())) {
-      _rewriteMemberExpression(*member);
+      _recordMemberExpression(*member);
     }
   }
 
@@ -124,15 +113,12 @@ bool DefinitionRewriter::VisitStmt(clang::Stmt* statement) {
       llvm::dyn_cast<clang::ParmVarDecl>(reference->getDecl());
   if (!declaration) return true;
 
-  const auto name = declaration->getName();
+  ExpansionTemplate::Hole hole;
+  hole.kind = HoleKind::Parameter;
+  hole.text = declaration->getName();
 
-  auto iterator = _parameterMap.find(name);
-  if (iterator != _parameterMap.end()) {
-    const auto& argument = iterator->getValue();
-    bool error = _rewriter.ReplaceText(reference->getSourceRange(), argument);
-    (void)error;
-    assert(!error && "Error replacing text in definition");
-  }
+  const auto range = reference->getSourceRange();
+  _addHole(std::move(hole), range.getBegin(), _rewriter.getRangeSize(range));
 
   return true;
 }
@@ -148,87 +134,84 @@ bool DefinitionRewriter::VisitTypeLoc(clang::TypeLoc typeLocation) {
   const auto end =
       typeLocation.getLocStart().getLocWithOffset(original.length() - 1);
 
-  const auto replacement = templateType->getReplacementType().getAsString();
-  _rewriter.ReplaceText({start, end}, replacement);
-
-  return true;
-}
-
-bool DefinitionRewriter::rewriteReturnsToAssignments(const clang::Stmt& body) {
-  assert(_call.assignee.hasValue() &&
-         "Cannot rewrite returns to assignments without an assignee");
-  assert(!_returnLocations.empty() &&
-         "Assigning to a function call that doesn't return?");
-
-  if (_returnLocations.size() == 1) {
-    _rewriteReturn(_returnLocations.front(), _call.assignee->toAssignment());
-    return false;
-  }
-
-  assert(_call.assignee->isDefaultConstructible());
+  ExpansionTemplate::Hole hole;
+  hole.kind = HoleKind::Substitution;
+  hole.text = templateType->getReplacementType().getAsString();
 
-  for (const auto& location : _returnLocations) {
-    _rewriteReturn(location, _call.assignee->toAssignment(/*withType=*/false));
-  }
+  _addHole(std::move(hole), start, _rewriter.getRangeSize({start, end}));
 
-  return _call.requiresDeclaration();
+  return true;
 }
 
-void DefinitionRewriter::_recordReturn(const clang::ReturnStmt& returnStatement,
-                                       const CallData& call) {
-  if (!call.assignee.hasValue()) return;
-  if (!call.assignee->isDefaultConstructible()) {
-    // If we already found a return statement on the top level of the function,
-    // then die. This is a super-duper edge case when the code has two return
-    // statements on the top function level (making everything underneath the
-    // first return dead code).
-    if (_returnLocations.empty()) {
-      ensureReturnAllowsDefaultConstruction(_context, returnStatement);
-    } else {
-      dieBecauseNotDefaultConstructible();
+void DefinitionRewriter::finish() {
+  auto& holes = _template.holes;
+  // Insertions (members accessed implicitly) come before a replacement at the
+  // same offset, which they do not overlap.
+  std::stable_sort(holes.begin(),
+                   holes.end(),
+                   [](const auto& a, const auto& b) {
+                     return std::tie(a.offset, a.length) <
+                            std::tie(b.offset, b.length);
+                   });
+
+  std::vector<ExpansionTemplate::Hole> disjoint;
+  for (auto& hole : holes) {
+    if (!disjoint.empty()) {
+      const auto& previous = disjoint.back();
+      if (hole.offset < previous.offset + previous.length) continue;
+      if (hole.offset == previous.offset && hole.length == 0 &&
+          previous.length == 0) {
+        continue;
+      }
     }
+    disjoint.emplace_back(std::move(hole));
   }
 
-  auto location = returnStatement.getSourceRange().getBegin();
-  _returnLocations.emplace_back(location);  // trivially-copyable
+  holes = std::move(disjoint);
+  _template.returnCount = std::count_if(holes.begin(),
+                                        holes.end(),
+                                        [](const auto& hole) {
+                                          return hole.kind == HoleKind::Return;
+                                        });
 }
 
-void DefinitionRewriter::_rewriteReturn(const clang::SourceLocation& begin,
-                                        const std::string& replacement) {
+void DefinitionRewriter::_recordReturn(
+    const clang::ReturnStmt& returnStatement) {
   static constexpr auto lengthOfTheWordReturn = 6;
 
+  const auto begin = returnStatement.getSourceRange().getBegin();
   const auto end = begin.getLocWithOffset(lengthOfTheWordReturn);
-  const bool error = _rewriter.ReplaceText({begin, end}, replacement);
-  assert(!error && "Error replacing return statement in definition");
-  (void)error;
+
+  ExpansionTemplate::Hole hole;
+  hole.kind = HoleKind::Return;
+  hole.isTopLevel = returnAllowsDefaultConstruction(_context, returnStatement);
+
+  _addHole(std::move(hole), begin, _rewriter.getRangeSize({begin, end}));
 }
 
-void DefinitionRewriter::_rewriteMemberExpression(
+void DefinitionRewriter::_recordMemberExpression(
     const clang::MemberExpr& member) {
-  // If the base is empty, this means (should mean) that this function was an
-  // implicit access, e.g. calling `f()` inside the class that declares `f()`.
-  // Therefore all member expressions will already be valid and don't need any
-  // change anyway (i.e. referencing the field `x` by `x` will be fine).
-  if (_call.base.empty()) return;
-  if (_rewrittenMembers.count(&member)) return;
+  if (_recordedMembers.count(&member)) return;
+
+  ExpansionTemplate::Hole hole;
+  hole.kind = HoleKind::Member;
 
   if (member.isImplicitAccess()) {
-    _rewriter.InsertText(member.getMemberLoc(), _call.base);
+    _addHole(std::move(hole), member.getMemberLoc(), 0);
   } else {
     // Gobble up any kind of 'this->' statement or qualifier (e.g. super::x,
     // where 'super' is typedef for the base class, i.e. still an implicit
     // access).
     const auto start = member.getLocStart();
     const auto end = member.getMemberLoc().getLocWithOffset(-1);
-    _rewriter.ReplaceText({start, end}, _call.base);
+    _addHole(std::move(hole), start, _rewriter.getRangeSize({start, end}));
   }
 
   // I've encountered cases where the exact same member will match twice.
-
-  _rewrittenMembers.insert(&member);
+  _recordedMembers.insert(&member);
 }
 
-void DefinitionRewriter::_rewriteNonTypeTemplateParameterExpression(
+void DefinitionRewriter::_recordNonTypeTemplateParameterExpression(
     const clang::SubstNonTypeTemplateParmExpr& nonType) {
   const auto* expression =
       nonType.getReplacement()->IgnoreImplicit()->IgnoreCasts();
@@ -237,13 +220,33 @@ void DefinitionRewriter::_rewriteNonTypeTemplateParameterExpression(
 
   const bool isUnsigned =
       nonType.getParameter()->getType().getTypePtr()->isUnsignedIntegerType();
-  const auto replacement =
-      integer->getValue().toString(10, /*Signed=*/!isUnsigned);
+
+  ExpansionTemplate::Hole hole;
+  hole.kind = HoleKind::Substitution;
+  hole.text = integer->getValue().toString(10, /*Signed=*/!isUnsigned);
 
   const auto range = nonType.getSourceRange();
-  const bool error = _rewriter.ReplaceText(range, replacement);
-  assert(!error && "Error replacing non-type template parameter expression");
-  (void)error;
+  _addHole(std::move(hole), range.getBegin(), _rewriter.getRangeSize(range));
+}
+
+void DefinitionRewriter::_addHole(ExpansionTemplate::Hole hole,
+                                  const clang::SourceLocation& location,
+                                  int length) {
+  // The rewriter cannot replace text in macros either.
+  if (length < 0 || !location.isFileID()) return;
+
+  const auto& sourceManager = _context.getSourceManager();
+  const auto begin = sourceManager.getDecomposedLoc(_bodyBegin);
+  const auto decomposed = sourceManager.getDecomposedLoc(location);
+  if (decomposed.first != begin.first || decomposed.second < begin.second) {
+    return;
+  }
+
+  hole.offset = decomposed.second - begin.second;
+  hole.length = static_cast<unsigned>(length);
+  if (hole.offset + hole.length > _template.body.size()) return;
+
+  _template.holes.emplace_back(std::move(hole));
 }
 
 }  // namespace ClangExpand
@@ -0,0 +1,238 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/common/expansion-template.hpp"
+#include "clang-expand/common/assignee-data.hpp"
+#include "clang-expand/common/call-data.hpp"
+#include "clang-expand/common/definition-rewriter.hpp"
+#include "clang-expand/error.hpp"
+
+// Clang includes
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Decl.h>
+#include <clang/AST/Stmt.h>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Rewrite/Core/Rewriter.h>
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/Casting.h>
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <cassert>
+#include <cstddef>
+#include <regex>
+#include <string>
+#include <utility>
+
+namespace ClangExpand {
+namespace {
+/// Removes all excess whitespace around the string, and from the start of each
+/// line. This is necessary so that the body of the function can be returned
+/// without any extra padding on the left, as it would normally have at least
+/// one level of indenting if simply cut out of a real function.
+///
+/// For example, given this function that we want to rewrite:
+///
+/// ```.cpp
+/// bool f(int x) {
+///   int y = 5;
+///   if (x + y > 5) {
+///     return true;
+///   }
+///   return false;
+/// }
+/// ```
+///
+/// We may extract the body first as such:
+///
+/// ```.cpp
+///   int y = 5;
+///   if (x + y > 5) {
+///     return true;
+///   }
+///   return false;
+/// ```
+/// and this function then turns it into this normalized snippet:
+///
+/// ```.cpp
+/// int y = 5;
+/// if (x + y > 5) {
+///   return true;
+/// }
+/// return false;
+/// ```
+///
+/// Note how only the first level of indentation is removed. Further levels are
+/// maintained as expected.
+///
+std::string withoutIndentation(std::string text) {
+  // clang-format off
+  static const std::regex whitespacePattern(
+    R"(^\s*\n(\s+)\S|(\s+))", std::regex::ECMAScript | std::regex::optimize);
+  // clang-format on
+
+  std::smatch match;
+  if (!std::regex_search(text, match, whitespacePattern)) {
+    return text;
+  }
+
+  assert(match[1].matched || match[2].matched);
+  const std::string excess = match[1].matched ? match.str(1) : match.str(2);
+
+  // C++ regex doesn't have a multiline option (or at least clang doesn't have
+  // one yet, should be in C++17), so we need to hack.
+  const std::regex excessPattern("\\n" + excess, std::regex::optimize);
+
+  const auto trimmed = llvm::StringRef(text).trim().str();
+  return std::regex_replace(trimmed, excessPattern, "\n");
+}
+
+/// Creates the error for a function that could not be expanded because the
+/// assigned type is not default constructible (like `int&`).
+Error notDefaultConstructibleError() {
+  return {ErrorKind::RefusedExpansion,
+          "Could not expand function because "
+          "assignee is not default-constructible"};
+}
+}  // namespace
+
+ExpansionTemplate ExpansionTemplate::Build(const clang::FunctionDecl& function,
+                                           clang::ASTContext& context) {
+  assert(function.hasBody() &&
+         "Function should have a body to build an expansion template");
+  auto* body = llvm::cast<clang::CompoundStmt>(function.getBody());
+
+  const auto afterBrace = body->getLocStart().getLocWithOffset(+1);
+  const auto beforeBrace = body->getLocEnd().getLocWithOffset(-1);
+  const clang::SourceRange range(afterBrace, beforeBrace);
+
+  // The rewriter only measures ranges (and cuts out the body), it never
+  // rewrites anything.
+  clang::Rewriter rewriter(context.getSourceManager(), context.getLangOpts());
+
+  ExpansionTemplate expansionTemplate;
+  expansionTemplate.body = rewriter.getRewrittenText(range);
+
+  DefinitionRewriter definitionRewriter(expansionTemplate,
+                                        afterBrace,
+                                        rewriter,
+                                        context);
+  definitionRewriter.TraverseStmt(body);
+  definitionRewriter.finish();
+
+  return expansionTemplate;
+}
+
+llvm::Expected<std::string>
+ExpansionTemplate::instantiate(const ParameterMap& parameterMap,
+                               const CallData& call) const {
+  // An empty body expands to nothing, whatever the call.
+  if (llvm::StringRef(body).trim().empty()) return std::string();
+
+  const auto& assignee = call.assignee;
+  const bool assigns = assignee.hasValue();
+
+  if (assigns) {
+    assert(returnCount > 0 &&
+           "Assigning to a function call that doesn't return?");
+
+    // A variable that cannot be default constructed can only be initialized by
+    // a single return statement on the top level of the function.
+    if (!assignee->isDefaultConstructible()) {
+      for (const auto& hole : holes) {
+        if (hole.kind != HoleKind::Return) continue;
+        if (returnCount > 1 || !hole.isTopLevel) {
+          return llvm::make_error<Error>(notDefaultConstructibleError());
+        }
+      }
+    }
+  }
+
+  // With a single return, a declared assignee is initialized right there.
+  std::string assignment;
+  if (assigns) {
+    const bool withType = returnCount == 1 && assignee->type.hasValue();
+    assignment = assignee->toAssignment(withType);
+  }
+
+  std::string text;
+  text.reserve(body.size());
+
+  std::size_t position = 0;
+  for (const auto& hole : holes) {
+    text.append(body, position, hole.offset - position);
+    position = hole.offset + hole.length;
+
+    const auto original = llvm::StringRef(body).substr(hole.offset,
+                                                       hole.length);
+    switch (hole.kind) {
+      case HoleKind::Parameter: {
+        auto iterator = parameterMap.find(hole.text);
+        if (iterator != parameterMap.end()) {
+          text += iterator->getValue();
+        } else {
+          text += original;
+        }
+        break;
+      }
+      case HoleKind::Member:
+        // If the base is empty, this means (should mean) that this function
+        // was an implicit access, e.g. calling `f()` inside the class that
+        // declares `f()`. Therefore all member expressions will already be
+        // valid and don't need any change anyway.
+        if (call.base.empty()) {
+          text += original;
+        } else {
+          text += call.base;
+        }
+        break;
+      case HoleKind::Return:
+        if (assigns) {
+          text += assignment;
+        } else {
+          text += original;
+        }
+        break;
+      case HoleKind::Substitution: text += hole.text; break;
+    }
+  }
+  text.append(body, position, std::string::npos);
+
+  auto rewritten = withoutIndentation(std::move(text));
+
+  const bool shouldDeclare =
+      assigns && returnCount > 1 && call.requiresDeclaration();
+  if (shouldDeclare) {
+    const std::string declaration = assignee->toDeclaration();
+    return (declaration + llvm::Twine("\n") + rewritten).str();
+  }
+
+  return rewritten;
+}
+
+}  // namespace ClangExpand
@@ -0,0 +1,158 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/common/line-table.hpp"
+
+// LLVM includes
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MathExtras.h>
+
+// System includes
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLANG_EXPAND_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+// Standard includes
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace ClangExpand {
+namespace {
+/// Checks if a character ends a line.
+bool isLineBreak(char character) noexcept {
+  return character == '\n' || character == '\r';
+}
+
+/// The tables of the tracked buffers, keyed by where the buffers begin.
+/// Tracked buffers whose table was not asked for yet map to null.
+struct Registry {
+  /// Guards `tables`.
+  std::mutex mutex;
+
+  /// The tables, keyed by the start of their buffer.
+  llvm::DenseMap<const char*, LineTable::TablePointer> tables;
+};
+
+/// Returns the registry shared by the whole process.
+Registry& getRegistry() {
+  static Registry registry;
+  return registry;
+}
+}  // namespace
+
+LineTable::LineTable(llvm::StringRef buffer) : _lineStarts{0} {
+  const char* data = buffer.data();
+  const std::size_t size = buffer.size();
+
+  // The line after the break at `index` begins after it, or after the pair of
+  // `\r\n` or `\n\r` it begins. The second character of a pair has an index
+  // below the last line start, which is how it is skipped.
+  auto addBreak = [this, data, size](std::size_t index) {
+    if (index < _lineStarts.back()) return;
+    auto next = index + 1;
+    if (next < size && isLineBreak(data[next]) && data[next] != data[index]) {
+      ++next;
+    }
+    _lineStarts.push_back(static_cast<unsigned>(next));
+  };
+
+  std::size_t position = 0;
+#if defined(CLANG_EXPAND_HAS_SSE2)
+  const auto newline = _mm_set1_epi8('\n');
+  const auto carriageReturn = _mm_set1_epi8('\r');
+  for (; position + 16 <= size; position += 16) {
+    const auto chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+    const auto breaks = _mm_or_si128(_mm_cmpeq_epi8(chunk, newline),
+                                     _mm_cmpeq_epi8(chunk, carriageReturn));
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(breaks));
+    for (; mask != 0; mask &= mask - 1) {
+      addBreak(position + llvm::countTrailingZeros(mask));
+    }
+  }
+#endif
+
+  for (; position < size; ++position) {
+    if (isLineBreak(data[position])) addBreak(position);
+  }
+}
+
+std::pair<unsigned, unsigned>
+LineTable::getLineAndColumn(unsigned offset) const {
+  // The line is the last one beginning at or before the offset.
+  const auto next =
+      std::upper_bound(_lineStarts.begin(), _lineStarts.end(), offset);
+  assert(next != _lineStarts.begin() && "The first line begins at zero");
+
+  const auto line = static_cast<unsigned>(next - _lineStarts.begin());
+  const auto column = offset - *std::prev(next) + 1;
+  return {line, column};
+}
+
+unsigned LineTable::getLineCount() const noexcept {
+  return static_cast<unsigned>(_lineStarts.size());
+}
+
+LineTable::TablePointer LineTable::find(llvm::StringRef buffer) {
+  auto& registry = getRegistry();
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto iterator = registry.tables.find(buffer.data());
+    if (iterator == registry.tables.end()) return nullptr;
+    if (iterator->second) return iterator->second;
+  }
+
+  // Other lookups need not wait for the scan. Should two threads build the
+  // same table, both are correct and the first one is kept.
+  auto table = std::make_shared<const LineTable>(buffer);
+
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto iterator = registry.tables.find(buffer.data());
+  if (iterator == registry.tables.end()) return table;
+  if (!iterator->second) iterator->second = std::move(table);
+  return iterator->second;
+}
+
+void LineTable::track(llvm::StringRef buffer) {
+  auto& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.tables.insert({buffer.data(), nullptr});
+}
+
+void LineTable::forget(llvm::StringRef buffer) {
+  auto& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.tables.erase(buffer.data());
+}
+}  // namespace ClangExpand
@@ -24,6 +24,7 @@
 
 // Project includes
 #include "clang-expand/common/location.hpp"
+#include "clang-expand/common/string-pool.hpp"
 
 // Third party includes
 #include <third-party/json.hpp>
@@ -36,21 +37,24 @@
 
 namespace ClangExpand {
 Location::Location(const clang::SourceLocation& location,
-                   const clang::SourceManager& sourceManager)
-: filename(sourceManager.getFilename(location))
-, offset(location, sourceManager) {
+                   const clang::SourceManager& sourceManager,
+                   StringPool& strings,
+                   Offset::Encoding encoding)
+: filename(strings.intern(sourceManager.getFilename(location)))
+, offset(location, sourceManager, encoding) {
 }
 
 Location::Location(const llvm::StringRef& filename_,
                    unsigned line,
-                   unsigned column)
-: filename(filename_), offset{line, column} {
+                   unsigned column,
+                   StringPool& strings)
+: filename(strings.intern(filename_)), offset{line, column} {
 }
 
 nlohmann::json Location::toJson() const {
   // clang-format off
   return {
-    {"filename", filename},
+    {"filename", filename.str()},
     {"offset", offset.toJson()}
   };
   // clang-format on
@@ -24,6 +24,7 @@
 
 // Project includes
 #include "clang-expand/common/offset.hpp"
+#include "clang-expand/common/line-table.hpp"
 
 // Third party includes
 #include <third-party/json.hpp>
@@ -31,11 +32,46 @@
 // Clang includes
 #include <clang/Basic/SourceManager.h>
 
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <tuple>
+#include <utility>
+
 namespace ClangExpand {
+namespace {
+/// Converts a location to a `(line, column)` pair through the memoized
+/// `LineTable` of its file, if the file has one. Else the source manager
+/// computes (and memoizes for its translation unit) the lines of the file.
+std::pair<unsigned, unsigned>
+getLineAndColumn(const clang::SourceLocation& location,
+                 const clang::SourceManager& sourceManager) {
+  const auto spelling = sourceManager.getSpellingLoc(location);
+  const auto decomposed = sourceManager.getDecomposedLoc(spelling);
+
+  bool invalid = false;
+  const auto buffer = sourceManager.getBufferData(decomposed.first, &invalid);
+  if (!invalid) {
+    if (const auto table = LineTable::find(buffer)) {
+      return table->getLineAndColumn(decomposed.second);
+    }
+  }
+
+  return {sourceManager.getSpellingLineNumber(location),
+          sourceManager.getSpellingColumnNumber(location)};
+}
+}  // namespace
+
 Offset::Offset(const clang::SourceLocation& location,
-               const clang::SourceManager& sourceManager)
-: line(sourceManager.getSpellingLineNumber(location))
-, column(sourceManager.getSpellingColumnNumber(location)) {
+               const clang::SourceManager& sourceManager,
+               Encoding encoding_)
+: line(0), column(0), encoding(encoding_) {
+  if (encoding == Encoding::Bytes) {
+    byte = sourceManager.getFileOffset(sourceManager.getSpellingLoc(location));
+  } else {
+    std::tie(line, column) = getLineAndColumn(location, sourceManager);
+  }
 }
 
 Offset::Offset(unsigned line_, unsigned column_)
@@ -43,6 +79,8 @@ Offset::Offset(unsigned line_, unsigned column_)
 }
 
 nlohmann::json Offset::toJson() const {
+  if (encoding == Encoding::Bytes) return byte;
+
   // clang-format off
   return {
     {"line", line},
@@ -34,8 +34,10 @@
 
 namespace ClangExpand {
 Range::Range(const clang::SourceRange& range,
-             const clang::SourceManager& sourceManager)
-: begin(range.getBegin(), sourceManager), end(range.getEnd(), sourceManager) {
+             const clang::SourceManager& sourceManager,
+             Offset::Encoding encoding)
+: begin(range.getBegin(), sourceManager, encoding)
+, end(range.getEnd(), sourceManager, encoding) {
 }
 
 Range::Range(Offset begin_, Offset end_) : begin(begin_), end(end_) {
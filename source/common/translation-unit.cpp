@@ -0,0 +1,145 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/common/translation-unit.hpp"
+
+// Clang includes
+#include <clang/AST/ASTContext.h>
+#include <clang/Basic/Diagnostic.h>
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Basic/SourceManager.h>
+#include <clang/Basic/VirtualFileSystem.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/PCHContainerOperations.h>
+#include <clang/Frontend/Utils.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/CompilationDatabase.h>
+
+// LLVM includes
+#include <llvm/ADT/None.h>
+
+// Standard includes
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ClangExpand {
+namespace TranslationUnit {
+namespace {
+/// Builds the arguments for `clang::ASTUnit::LoadFromCommandLine` from the
+/// compile command, the way `clang::tooling::ClangTool` would, but resolving
+/// relative paths with `-working-directory` instead of changing directories.
+std::vector<std::string>
+makeArguments(const clang::tooling::CompileCommand& command) {
+  using namespace clang::tooling;  // NOLINT(build/namespaces)
+
+  auto arguments = command.CommandLine;
+  arguments = getClangSyntaxOnlyAdjuster()(arguments, command.Filename);
+  arguments = getClangStripOutputAdjuster()(arguments, command.Filename);
+
+  // The driver only parses what follows the program name, so that stays first.
+  if (arguments.empty()) arguments.emplace_back("clang");
+  arguments.insert(std::next(arguments.begin()),
+                   "-working-directory=" + command.Directory);
+
+  return arguments;
+}
+
+/// Returns the directory of clang's builtin headers, found relative to our
+/// executable just like `clang::tooling::ClangTool` does.
+const std::string& getResourcesPath() {
+  static int anchor;
+  static const auto path =
+      clang::CompilerInvocation::GetResourcesPath("clang-expand", &anchor);
+  return path;
+}
+}  // namespace
+
+std::unique_ptr<clang::ASTUnit>
+parse(const clang::tooling::CompileCommand& command,
+      FileSystemPointer fileSystem,
+      bool precompilesPreamble) {
+  const auto arguments = makeArguments(command);
+  std::vector<const char*> argv;
+  for (const auto& argument : arguments) argv.emplace_back(argument.c_str());
+
+  // Whoever needs the diagnostics parses the source with a clang tool.
+  auto diagnostics = clang::CompilerInstance::createDiagnostics(
+      new clang::DiagnosticOptions(), new clang::IgnoringDiagConsumer());
+
+  return std::unique_ptr<clang::ASTUnit>(clang::ASTUnit::LoadFromCommandLine(
+      argv.data(),
+      argv.data() + argv.size(),
+      std::make_shared<clang::PCHContainerOperations>(),
+      diagnostics,
+      getResourcesPath(),
+      /*OnlyLocalDecls=*/false,
+      /*CaptureDiagnostics=*/false,
+      /*RemappedFiles=*/llvm::None,
+      /*RemappedFilesKeepOriginalName=*/true,
+      /*PrecompilePreambleAfterNParses=*/precompilesPreamble ? 1 : 0,
+      clang::TU_Complete,
+      /*CacheCodeCompletionResults=*/false,
+      /*IncludeBriefCommentsInCodeCompletion=*/false,
+      /*AllowPCHWithCompilerErrors=*/false,
+      /*SkipFunctionBodies=*/false,
+      /*UserFilesAreVolatile=*/false,
+      /*ForSerialization=*/false,
+      /*ModuleFormat=*/llvm::None,
+      /*ErrAST=*/nullptr,
+      std::move(fileSystem)));
+}
+
+std::unique_ptr<clang::CompilerInvocation>
+createInvocation(const clang::tooling::CompileCommand& command) {
+  auto arguments = makeArguments(command);
+  arguments.emplace_back("-resource-dir=" + getResourcesPath());
+  std::vector<const char*> argv;
+  for (const auto& argument : arguments) argv.emplace_back(argument.c_str());
+
+  auto diagnostics = clang::CompilerInstance::createDiagnostics(
+      new clang::DiagnosticOptions(), new clang::IgnoringDiagConsumer());
+
+  return std::unique_ptr<clang::CompilerInvocation>(
+      clang::createInvocationFromCommandLine(argv, diagnostics));
+}
+
+std::uint64_t measureMemory(const clang::ASTUnit& unit) {
+  const auto& context = unit.getASTContext();
+  const auto& sourceManager = unit.getSourceManager();
+  const auto buffers = sourceManager.getMemoryBufferSizes();
+  return context.getASTAllocatedMemory() +
+         context.getSideTableAllocatedMemory() +
+         sourceManager.getDataStructureSizes() + buffers.malloc_bytes +
+         buffers.mmap_bytes;
+}
+
+}  // namespace TranslationUnit
+}  // namespace ClangExpand
@@ -24,6 +24,7 @@
 
 // Project includes
 #include "clang-expand/definition-search/action.hpp"
+#include "clang-expand/common/query.hpp"
 #include "clang-expand/common/routines.hpp"
 #include "clang-expand/definition-search/consumer.hpp"
 
@@ -41,8 +42,9 @@ Action::Action(const std::string& declarationFile, Query& query)
 
 Action::ASTConsumerPointer Action::CreateASTConsumer(clang::CompilerInstance&,
                                                      llvm::StringRef filename) {
-  // Skip the file we found the declaration in
-  if (filename == _declarationFile) return nullptr;
+  // Skip the file we found the declaration in, and everything once the query
+  // is cancelled.
+  if (filename == _declarationFile || _query.isCancelled()) return nullptr;
   return std::make_unique<Consumer>(_query);
 }
 
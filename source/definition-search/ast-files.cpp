@@ -0,0 +1,142 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/definition-search/ast-files.hpp"
+#include "clang-expand/common/routines.hpp"
+#include "clang-expand/definition-search/consumer.hpp"
+#include "clang-expand/definition-search/include-graph.hpp"
+
+// Clang includes
+#include <clang/Basic/Diagnostic.h>
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Basic/FileSystemOptions.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/PCHContainerOperations.h>
+#include <clang/Tooling/CompilationDatabase.h>
+
+// LLVM includes
+#include <llvm/ADT/None.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+
+// Standard includes
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace ASTFiles {
+namespace {
+/// Returns the modification time of a file in nanoseconds, or `None` if the
+/// file does not exist.
+llvm::Optional<std::int64_t> getModificationTime(const llvm::Twine& filename) {
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(filename, status)) return llvm::None;
+  if (!llvm::sys::fs::exists(status)) return llvm::None;
+
+  using std::chrono::nanoseconds;
+  const auto time = status.getLastModificationTime().time_since_epoch();
+  return std::chrono::duration_cast<nanoseconds>(time).count();
+}
+
+/// Returns the path where the build would have put the AST file for the
+/// command.
+std::string getASTFilePath(const clang::tooling::CompileCommand& command) {
+  llvm::StringRef output;
+  const auto& arguments = command.CommandLine;
+  for (std::size_t index = 1; index < arguments.size(); ++index) {
+    const llvm::StringRef argument(arguments[index]);
+    if (argument == "-o" && index + 1 < arguments.size()) {
+      output = arguments[index + 1];
+      break;
+    }
+    if (argument.startswith("-o") && !argument.startswith("-objc")) {
+      output = argument.drop_front(2);
+      break;
+    }
+  }
+
+  if (output.empty()) output = llvm::sys::path::filename(command.Filename);
+
+  llvm::SmallString<256> path;
+  if (!llvm::sys::path::is_absolute(output)) path = command.Directory;
+  llvm::sys::path::append(path, output);
+  llvm::sys::path::replace_extension(path, "ast");
+
+  return path.str();
+}
+}  // namespace
+
+llvm::Optional<std::string>
+findUpToDate(const clang::tooling::CompileCommand& command,
+             IncludeGraph& includeGraph) {
+  auto astFile = getASTFilePath(command);
+  const auto astTime = getModificationTime(astFile);
+  if (!astTime) return llvm::None;
+
+  // Without the complete include closure, any header may have changed since
+  // the AST file was written, so it cannot be trusted.
+  const auto latestInput = includeGraph.getLatestModificationTime(command);
+  if (!latestInput || *astTime < *latestInput) return llvm::None;
+
+  return astFile;
+}
+
+bool search(const std::string& astFile,
+            const std::string& skippedFile,
+            Query& query) {
+  // Loading may fail for stale or incompatible AST files, which is expected
+  // and handled by parsing from source, so stay quiet about it.
+  auto diagnostics = clang::CompilerInstance::createDiagnostics(
+      new clang::DiagnosticOptions(), new clang::IgnoringDiagConsumer());
+  auto containerOperations = std::make_shared<clang::PCHContainerOperations>();
+
+  auto unit =
+      clang::ASTUnit::LoadFromASTFile(astFile,
+                                      containerOperations->getRawReader(),
+                                      diagnostics,
+                                      clang::FileSystemOptions());
+  if (!unit) return false;
+
+  if (Routines::makeAbsolute(unit->getMainFileName()) == skippedFile) {
+    return true;
+  }
+
+  Consumer consumer(query);
+  consumer.HandleTranslationUnit(unit->getASTContext());
+
+  return true;
+}
+
+}  // namespace ASTFiles
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
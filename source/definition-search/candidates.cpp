@@ -0,0 +1,170 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/definition-search/candidates.hpp"
+#include "clang-expand/common/location.hpp"
+#include "clang-expand/common/routines.hpp"
+#include "clang-expand/definition-search/include-graph.hpp"
+
+// Clang includes
+#include <clang/Tooling/CompilationDatabase.h>
+
+// LLVM includes
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+// Standard includes
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace Candidates {
+namespace {
+/// The locality groups of a candidate source, in the order in which they are
+/// searched.
+enum class Locality { SameStem, SameDirectory, Elsewhere };
+
+/// Determines the locality group of a source w.r.t. the declaring file.
+Locality getLocality(const llvm::StringRef& source,
+                     const llvm::StringRef& declarationStem,
+                     const llvm::StringRef& declarationDirectory) {
+  if (llvm::sys::path::stem(source) == declarationStem) {
+    return Locality::SameStem;
+  }
+  if (llvm::sys::path::parent_path(source) == declarationDirectory) {
+    return Locality::SameDirectory;
+  }
+  return Locality::Elsewhere;
+}
+
+/// Appends all `sources` to `output` as absolute paths, skipping any that were
+/// already `seen`.
+void appendUnique(const std::vector<std::string>& sources,
+                  llvm::StringSet<>& seen,
+                  SourceVector& output) {
+  for (const auto& source : sources) {
+    auto absolute = Routines::makeAbsolute(source);
+    if (seen.insert(absolute).second) {
+      output.emplace_back(std::move(absolute));
+    }
+  }
+}
+}  // namespace
+
+llvm::ErrorOr<SourceVector> readSourceList(const llvm::StringRef& filename) {
+  auto buffer = llvm::MemoryBuffer::getFile(filename);
+  if (!buffer) return buffer.getError();
+
+  llvm::SmallVector<llvm::StringRef, 64> lines;
+  (*buffer)->getBuffer().split(lines, '\n', -1, /*KeepEmpty=*/false);
+
+  SourceVector sources;
+  for (auto line : lines) {
+    line = line.trim();
+    if (line.empty() || line.startswith("#")) continue;
+    sources.emplace_back(line.str());
+  }
+
+  return sources;
+}
+
+SourceVector
+collect(const clang::tooling::CompilationDatabase& compilationDatabase,
+        const SourceVector& sources,
+        bool allSources) {
+  SourceVector candidates;
+  llvm::StringSet<> seen;
+
+  appendUnique(sources, seen, candidates);
+  if (allSources) {
+    appendUnique(compilationDatabase.getAllFiles(), seen, candidates);
+  }
+
+  return candidates;
+}
+
+void orderByLocality(SourceVector& sources, const Location& declaration) {
+  const llvm::StringRef declarationFile(declaration.filename);
+  const auto stem = llvm::sys::path::stem(declarationFile);
+  const auto directory = llvm::sys::path::parent_path(declarationFile);
+
+  std::stable_sort(sources.begin(),
+                   sources.end(),
+                   [stem, directory](const auto& first, const auto& second) {
+                     return getLocality(first, stem, directory) <
+                            getLocality(second, stem, directory);
+                   });
+}
+
+void keepShard(SourceVector& sources, unsigned index, unsigned count) {
+  if (count <= 1) return;
+
+  // FNV-1a, since std::hash may differ between standard libraries.
+  auto getShard = [count](const std::string& source) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const auto character : source) {
+      hash ^= static_cast<unsigned char>(character);
+      hash *= 1099511628211ull;
+    }
+    return static_cast<unsigned>(hash % count);
+  };
+
+  sources.erase(std::remove_if(sources.begin(),
+                               sources.end(),
+                               [index, &getShard](const auto& source) {
+                                 return getShard(source) != index;
+                               }),
+                sources.end());
+}
+
+void pruneByIncludes(
+    SourceVector& sources,
+    const clang::tooling::CompilationDatabase& compilationDatabase,
+    const Location& declaration,
+    IncludeGraph& includeGraph) {
+  auto cannotReach = [&](const std::string& source) {
+    const auto commands = compilationDatabase.getCompileCommands(source);
+    if (commands.empty()) return false;
+    return std::none_of(commands.begin(),
+                        commands.end(),
+                        [&](const auto& command) {
+                          return includeGraph.mayReach(command,
+                                                       declaration.filename);
+                        });
+  };
+
+  sources.erase(std::remove_if(sources.begin(), sources.end(), cannotReach),
+                sources.end());
+}
+
+}  // namespace Candidates
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
@@ -0,0 +1,274 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/definition-search/clangd-index.hpp"
+
+// LLVM includes
+#include <llvm/ADT/None.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Compression.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
+
+// Standard includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace ClangdIndex {
+namespace {
+/// The oldest and newest shard format versions whose symbol records start with
+/// the ID, kind, language, name, scope, template arguments and definition.
+constexpr std::uint32_t oldestKnownVersion = 12;
+constexpr std::uint32_t newestKnownVersion = 19;
+
+/// The number of bytes of the SHA1 hash of a USR that make up a symbol ID.
+constexpr std::size_t symbolIDSize = 8;
+
+/// Reads little-endian integers and variable-length integers (seven bits per
+/// byte, the high bit marking continuation) from a buffer. Reading past the
+/// end of the buffer sets an error flag rather than crashing.
+class Reader {
+ public:
+  explicit Reader(llvm::StringRef data) : _data(data) {
+  }
+
+  std::uint32_t read32() {
+    if (_data.size() < 4) return _fail();
+    const auto value = llvm::support::endian::read32le(_data.data());
+    _data = _data.drop_front(4);
+    return value;
+  }
+
+  std::uint32_t readVar() {
+    std::uint32_t value = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+      if (_data.empty()) return _fail();
+      const auto byte = static_cast<unsigned char>(_data.front());
+      _data = _data.drop_front();
+      value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return value;
+    }
+    return _fail();
+  }
+
+  void skip(std::size_t bytes) {
+    if (_data.size() < bytes) {
+      _fail();
+    } else {
+      _data = _data.drop_front(bytes);
+    }
+  }
+
+  bool failed() const noexcept {
+    return _failed;
+  }
+
+ private:
+  std::uint32_t _fail() {
+    _failed = true;
+    _data = llvm::StringRef();
+    return 0;
+  }
+
+  llvm::StringRef _data;
+  bool _failed{false};
+};
+
+/// Splits a RIFF file with form type `CdIx` into its chunks.
+llvm::Optional<llvm::StringMap<llvm::StringRef>>
+readChunks(llvm::StringRef file) {
+  if (file.size() < 12 || !file.startswith("RIFF")) return llvm::None;
+  if (file.substr(8, 4) != "CdIx") return llvm::None;
+
+  const auto length = llvm::support::endian::read32le(file.data() + 4);
+  if (length < 4 || file.size() - 8 < length) return llvm::None;
+
+  llvm::StringMap<llvm::StringRef> chunks;
+  auto body = file.substr(12, length - 4);
+  while (body.size() >= 8) {
+    const auto id = body.take_front(4);
+    const auto size = llvm::support::endian::read32le(body.data() + 4);
+    if (body.size() - 8 < size) return llvm::None;
+    chunks[id] = body.substr(8, size);
+    // Chunks are padded to an even size.
+    const auto padded = 8 + static_cast<std::size_t>(size) + (size & 1);
+    body = body.drop_front(std::min(body.size(), padded));
+  }
+
+  return chunks;
+}
+
+/// Reads the string table of a shard. The table may be zlib-compressed, in
+/// which case the decompressed data is kept in the `storage`.
+llvm::Optional<std::vector<llvm::StringRef>>
+readStrings(llvm::StringRef chunk, llvm::SmallVectorImpl<char>& storage) {
+  Reader reader(chunk);
+  const auto uncompressedSize = reader.read32();
+  if (reader.failed()) return llvm::None;
+
+  auto data = chunk.drop_front(4);
+  if (uncompressedSize != 0) {
+    if (!llvm::zlib::isAvailable()) return llvm::None;
+    const auto status =
+        llvm::zlib::uncompress(data, storage, uncompressedSize);
+    if (status != llvm::zlib::StatusOK) return llvm::None;
+    data = llvm::StringRef(storage.data(), storage.size());
+  }
+
+  // Every string, including the last, is terminated by a null byte.
+  std::vector<llvm::StringRef> strings;
+  while (!data.empty()) {
+    const auto end = data.find('\0');
+    if (end == llvm::StringRef::npos) return llvm::None;
+    strings.emplace_back(data.take_front(end));
+    data = data.drop_front(end + 1);
+  }
+
+  return strings;
+}
+
+/// Converts a `file://` URI to a path, undoing percent-encoding.
+llvm::Optional<std::string> uriToPath(llvm::StringRef uri) {
+  if (!uri.consume_front("file://")) return llvm::None;
+
+  std::string path;
+  path.reserve(uri.size());
+  for (std::size_t index = 0; index < uri.size(); ++index) {
+    const auto high = index + 2 < uri.size()
+                          ? llvm::hexDigitValue(uri[index + 1])
+                          : -1U;
+    const auto low = index + 2 < uri.size()
+                         ? llvm::hexDigitValue(uri[index + 2])
+                         : -1U;
+    if (uri[index] == '%' && high != -1U && low != -1U) {
+      path += static_cast<char>(high * 16 + low);
+      index += 2;
+    } else {
+      path += uri[index];
+    }
+  }
+
+  return path;
+}
+
+/// Looks for the symbol with the given ID in one shard.
+/// \returns The path of the file defining the symbol, if the shard knows it.
+llvm::Optional<std::string> searchShard(llvm::StringRef file,
+                                        llvm::StringRef symbolID) {
+  // Most shards do not contain the symbol at all, so check the raw bytes
+  // before bothering to decode anything.
+  if (file.find(symbolID) == llvm::StringRef::npos) return llvm::None;
+
+  const auto chunks = readChunks(file);
+  if (!chunks) return llvm::None;
+
+  const auto meta = chunks->find("meta");
+  const auto symbols = chunks->find("symb");
+  const auto stringTable = chunks->find("stri");
+  if (meta == chunks->end() || symbols == chunks->end() ||
+      stringTable == chunks->end()) {
+    return llvm::None;
+  }
+
+  Reader metaReader(meta->second);
+  const auto version = metaReader.read32();
+  if (metaReader.failed() || version < oldestKnownVersion ||
+      version > newestKnownVersion) {
+    return llvm::None;
+  }
+
+  // We cannot skip from record to record without decoding every field of the
+  // symbol layout, so look for the ID directly and decode from there.
+  const auto symbolChunk = symbols->second;
+  auto position = symbolChunk.find(symbolID);
+  if (position == llvm::StringRef::npos) return llvm::None;
+
+  llvm::SmallString<0> storage;
+  const auto strings = readStrings(stringTable->second, storage);
+  if (!strings) return llvm::None;
+
+  for (; position != llvm::StringRef::npos;
+       position = symbolChunk.find(symbolID, position + 1)) {
+    Reader reader(symbolChunk.drop_front(position + symbolIDSize));
+    reader.skip(2);  // Kind and language
+    reader.readVar();  // Name
+    reader.readVar();  // Scope
+    reader.readVar();  // Template specialization arguments
+    const auto definitionFile = reader.readVar();
+    if (reader.failed() || definitionFile >= strings->size()) continue;
+
+    // Symbols that are only declared in this shard have an empty definition.
+    const auto uri = (*strings)[definitionFile];
+    if (auto path = uriToPath(uri)) return path;
+  }
+
+  return llvm::None;
+}
+}  // namespace
+
+llvm::Optional<std::string> lookup(llvm::StringRef indexDirectory,
+                                   llvm::StringRef usr) {
+  if (usr.empty()) return llvm::None;
+
+  llvm::SHA1 hash;
+  hash.update(usr);
+  const auto symbolID = hash.final().take_front(symbolIDSize).str();
+
+  std::error_code error;
+  llvm::sys::fs::directory_iterator iterator(indexDirectory, error);
+  for (const llvm::sys::fs::directory_iterator end; !error && iterator != end;
+       iterator.increment(error)) {
+    const auto& shard = iterator->path();
+    if (llvm::sys::path::extension(shard) != ".idx") continue;
+
+    auto buffer = llvm::MemoryBuffer::getFile(shard,
+                                              /*FileSize=*/-1,
+                                              /*RequiresNullTerminator=*/false);
+    if (!buffer) continue;
+
+    if (auto path = searchShard((*buffer)->getBuffer(), symbolID)) {
+      return path;
+    }
+  }
+
+  return llvm::None;
+}
+
+}  // namespace ClangdIndex
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
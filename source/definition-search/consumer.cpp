@@ -28,6 +28,7 @@
 #include "clang-expand/common/query.hpp"
 
 // Clang includes
+#include <clang/AST/DeclGroup.h>
 #include <clang/ASTMatchers/ASTMatchFinder.h>
 #include <clang/ASTMatchers/ASTMatchers.h>
 #include <clang/ASTMatchers/ASTMatchersInternal.h>
@@ -51,7 +52,14 @@ auto createAstMatcher(const DeclarationData& declaration) {
 Consumer::Consumer(Query& query) : _query(query), _matchHandler(query) {
 }
 
+bool Consumer::HandleTopLevelDecl(clang::DeclGroupRef) {
+  // Returning false stops the parser.
+  return !_query.isCancelled();
+}
+
 void Consumer::HandleTranslationUnit(clang::ASTContext& context) {
+  if (_query.isCancelled()) return;
+
   const auto matcher = createAstMatcher(*_query.declaration);
   clang::ast_matchers::MatchFinder matchFinder;
   matchFinder.addMatcher(matcher, &_matchHandler);
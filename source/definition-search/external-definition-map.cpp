@@ -0,0 +1,95 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/definition-search/external-definition-map.hpp"
+#include "clang-expand/common/routines.hpp"
+
+// LLVM includes
+#include <llvm/ADT/None.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/LineIterator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+// Standard includes
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace ExternalDefinitionMap {
+namespace {
+/// Splits a line of the map into the USR and the path.
+/// \returns A pair of empty strings if the line is malformed.
+std::pair<llvm::StringRef, llvm::StringRef> parseLine(llvm::StringRef line) {
+  // Newer format: <length>:<usr> <path>
+  const auto colon = line.find(':');
+  std::size_t length;
+  if (colon != llvm::StringRef::npos &&
+      !line.substr(0, colon).getAsInteger(10, length)) {
+    const auto rest = line.drop_front(colon + 1);
+    if (rest.size() > length && rest[length] == ' ') {
+      return {rest.take_front(length), rest.drop_front(length + 1)};
+    }
+    return {};
+  }
+
+  // Older format: <usr> <path>
+  const auto space = line.find(' ');
+  if (space == llvm::StringRef::npos) return {};
+  return {line.take_front(space), line.drop_front(space + 1)};
+}
+}  // namespace
+
+llvm::Optional<std::string> lookup(llvm::StringRef mapFile,
+                                   llvm::StringRef usr) {
+  if (usr.empty()) return llvm::None;
+
+  auto buffer = llvm::MemoryBuffer::getFile(mapFile);
+  if (!buffer) return llvm::None;
+
+  // The maps of large projects easily run into the millions of lines, but we
+  // only ever look up a single USR per run, so scanning beats indexing.
+  for (llvm::line_iterator line(**buffer); !line.is_at_eof(); ++line) {
+    const auto entry = parseLine(*line);
+    if (entry.first != usr || entry.second.empty()) continue;
+
+    const auto path = entry.second.trim();
+    if (llvm::sys::path::is_absolute(path)) return path.str();
+
+    llvm::SmallString<256> resolved(llvm::sys::path::parent_path(mapFile));
+    llvm::sys::path::append(resolved, path);
+    return Routines::makeAbsolute(resolved.str());
+  }
+
+  return llvm::None;
+}
+
+}  // namespace ExternalDefinitionMap
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
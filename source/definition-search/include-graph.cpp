@@ -0,0 +1,575 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/definition-search/include-graph.hpp"
+#include "clang-expand/common/translation-unit.hpp"
+
+// Clang includes
+#include <clang/Basic/LangOptions.h>
+#include <clang/Basic/SourceLocation.h>
+#include <clang/Basic/TokenKinds.h>
+#include <clang/Basic/VirtualFileSystem.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Lex/HeaderSearchOptions.h>
+#include <clang/Lex/Lexer.h>
+#include <clang/Lex/PreprocessorOptions.h>
+#include <clang/Lex/Token.h>
+#include <clang/Tooling/CompilationDatabase.h>
+
+// LLVM includes
+#include <llvm/ADT/None.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace {
+/// The first line of the on-disk cache. Bump the version whenever the format
+/// changes, which invalidates all existing caches.
+constexpr const char* cacheHeader = "clang-expand-include-graph 2";
+
+/// Converts a modification time to the integer stored in the cache.
+std::int64_t toNanoseconds(const llvm::sys::TimePoint<>& time) {
+  using std::chrono::nanoseconds;
+  return std::chrono::duration_cast<nanoseconds>(time.time_since_epoch())
+      .count();
+}
+
+/// Joins a (possibly relative) path onto a directory and normalizes it.
+std::string joinPath(const llvm::StringRef& directory,
+                     const llvm::StringRef& path) {
+  llvm::SmallString<256> joined;
+  if (!llvm::sys::path::is_absolute(path)) joined = directory;
+  llvm::sys::path::append(joined, path);
+  llvm::sys::path::remove_dots(joined, /*remove_dot_dot=*/true);
+  return joined.str();
+}
+
+/// Returns the file name following an include directive keyword on the same
+/// line, stripped of its quotes or angle brackets. Sets `isAngled` depending
+/// on the delimiters. Returns an empty string if the file name is not spelled
+/// literally (i.e. it is a macro).
+llvm::StringRef parseIncludeFilename(llvm::StringRef rest, bool& isAngled) {
+  rest = rest.substr(0, rest.find_first_of("\r\n")).ltrim();
+  if (rest.empty()) return {};
+
+  const char opening = rest.front();
+  if (opening != '"' && opening != '<') return {};
+
+  isAngled = (opening == '<');
+  const auto closing = rest.find(isAngled ? '>' : '"', 1);
+  if (closing == llvm::StringRef::npos) return {};
+
+  return rest.slice(1, closing);
+}
+
+/// Returns where the preprocessor searches the directories of the `group`,
+/// relative to the other groups, or -1 if it does not search them at all for
+/// the `language`. Mirrors the order of clang's `InitHeaderSearch`.
+int getSearchRank(clang::frontend::IncludeDirGroup group,
+                  const clang::LangOptions& language) {
+  using namespace clang::frontend;  // NOLINT(build/namespaces)
+
+  const bool isC = !language.CPlusPlus && !language.ObjC1;
+  const bool isCXX = language.CPlusPlus && !language.ObjC1;
+  const bool isObjC = !language.CPlusPlus && language.ObjC1;
+  const bool isObjCXX = language.CPlusPlus && language.ObjC1;
+
+  switch (group) {
+    case Quoted: return 0;
+    case Angled:
+    case IndexHeaderMap: return 1;
+    case System:
+    case ExternCSystem: return 2;
+    case CSystem: return isC ? 2 : -1;
+    case CXXSystem: return isCXX ? 2 : -1;
+    case ObjCSystem: return isObjC ? 2 : -1;
+    case ObjCXXSystem: return isObjCXX ? 2 : -1;
+    case After: return 3;
+  }
+
+  return -1;
+}
+}  // namespace
+
+IncludeGraph::IncludeGraph(std::string cacheFile,
+                           FileSystemPointer fileSystem)
+: _cacheFile(std::move(cacheFile)), _fileSystem(std::move(fileSystem)) {
+  if (!_cacheFile.empty()) _load();
+}
+
+bool IncludeGraph::mayReach(const clang::tooling::CompileCommand& command,
+                            const llvm::StringRef& target) {
+  const auto targetFile = _getRealPath(joinPath(command.Directory, target));
+  auto visitor = [this, &targetFile](const auto& filename,
+                                     const auto* file,
+                                     bool isOpen) {
+    if (filename == targetFile) return false;
+    if (file != nullptr && _getRealPath(filename) == targetFile) return false;
+    // We cannot know where a macro or unresolved include leads, so be
+    // conservative.
+    return !isOpen;
+  };
+
+  // The traversal is stopped exactly when the target may be reached.
+  return !_traverse(command, visitor);
+}
+
+llvm::Optional<std::int64_t> IncludeGraph::getLatestModificationTime(
+    const clang::tooling::CompileCommand& command) {
+  std::int64_t latest = 0;
+  const bool complete =
+      _traverse(command, [&latest](const auto&, const auto* file, bool isOpen) {
+        if (file == nullptr || isOpen) return false;
+        latest = std::max(latest, file->modificationTime);
+        return true;
+      });
+
+  if (!complete) return llvm::None;
+  return latest;
+}
+
+std::uint64_t
+IncludeGraph::getClosureSize(const clang::tooling::CompileCommand& command) {
+  std::uint64_t size = 0;
+  _traverse(command, [&size](const auto&, const auto* file, bool) {
+    if (file != nullptr) size += file->size;
+    return true;
+  });
+
+  return size;
+}
+
+std::vector<std::string> IncludeGraph::getLeadingIncludes(
+    const clang::tooling::CompileCommand& command) {
+  const auto& searchPaths = _getSearchPaths(command);
+  const auto filename = joinPath(command.Directory, command.Filename);
+
+  std::vector<std::string> includes;
+  const auto* file = _getFile(filename);
+  if (file == nullptr) return includes;
+
+  const auto directory = llvm::sys::path::parent_path(filename);
+  for (unsigned index = 0; index < file->leadingDirectives; ++index) {
+    const auto& directive = file->directives[index];
+    auto resolved =
+        _resolve(directive, directory, /*isIncluderSystem=*/false, searchPaths);
+    if (!resolved) break;
+    includes.emplace_back(std::move(resolved->filename));
+  }
+
+  return includes;
+}
+
+void IncludeGraph::save() const {
+  if (_cacheFile.empty() || _scanned.empty()) return;
+
+  // Other processes (e.g. other shards) may have saved the cache since we
+  // loaded it, so what they scanned is kept, unless we scanned the same files.
+  llvm::StringMap<File> files;
+  _read(_cacheFile, files);
+  for (const auto& filename : _scanned) {
+    files[filename.getKey()] = _files.lookup(filename.getKey());
+  }
+
+  // Each process writes its own temporary file, which replaces the cache
+  // atomically.
+  int descriptor;
+  llvm::SmallString<256> temporary;
+  if (llvm::sys::fs::createUniqueFile(_cacheFile + ".tmp-%%%%%%%%",
+                                      descriptor,
+                                      temporary)) {
+    return;
+  }
+
+  {
+    llvm::raw_fd_ostream stream(descriptor, /*shouldClose=*/true);
+    stream << cacheHeader << '\n';
+    for (const auto& entry : files) {
+      const auto& file = entry.getValue();
+      stream << "F " << file.modificationTime << ' ' << file.size << ' '
+             << file.hasComputedInclude << ' ' << file.leadingDirectives << ' '
+             << entry.getKey() << '\n';
+      for (const auto& directive : file.directives) {
+        stream << (directive.isAngled ? "A " : "Q ") << directive.spelling
+               << '\n';
+      }
+    }
+  }
+
+  if (llvm::sys::fs::rename(temporary, _cacheFile)) {
+    llvm::sys::fs::remove(temporary);
+  }
+}
+
+const IncludeGraph::SearchPaths&
+IncludeGraph::_getSearchPaths(const clang::tooling::CompileCommand& command) {
+  // Most commands differ only in their main file, whose extension still
+  // decides the language (and thereby the system directories).
+  std::string key = command.Directory;
+  key += llvm::sys::path::extension(command.Filename);
+  for (const auto& argument : command.CommandLine) {
+    if (argument == command.Filename) continue;
+    key += '\0';
+    key += argument;
+  }
+
+  auto iterator = _searchPaths.find(key);
+  if (iterator != _searchPaths.end()) return iterator->getValue();
+
+  auto& searchPaths = _searchPaths[key];
+  auto invocation = TranslationUnit::createInvocation(command);
+  if (!invocation) return searchPaths;
+
+  const auto& options = invocation->getHeaderSearchOpts();
+  const auto& language = *invocation->getLangOpts();
+
+  std::vector<std::pair<int, SearchDirectory>> directories;
+  for (const auto& entry : options.UserEntries) {
+    const auto rank = getSearchRank(entry.Group, language);
+    if (rank < 0) continue;
+
+    // Paths starting with '=' are relative to the sysroot.
+    llvm::StringRef path(entry.Path);
+    std::string directory;
+    if (path.startswith("=")) {
+      directory = options.Sysroot + path.drop_front().str();
+    } else {
+      directory = path;
+    }
+
+    const bool isSystem = rank >= 2;
+    directories.push_back({rank,
+                           {joinPath(command.Directory, directory),
+                            entry.IsFramework,
+                            isSystem}});
+  }
+
+  std::stable_sort(directories.begin(),
+                   directories.end(),
+                   [](const auto& a, const auto& b) {
+                     return a.first < b.first;
+                   });
+  for (auto& directory : directories) {
+    auto& group =
+        directory.first == 0 ? searchPaths.quoted : searchPaths.angled;
+    group.emplace_back(std::move(directory.second));
+  }
+
+  const auto& preprocessor = invocation->getPreprocessorOpts();
+  for (const auto& include : preprocessor.MacroIncludes) {
+    searchPaths.forced.emplace_back(include);
+  }
+  for (const auto& include : preprocessor.Includes) {
+    searchPaths.forced.emplace_back(include);
+  }
+
+  // The driver turns `-include foo.h` into `-include-pch foo.h.pch` when the
+  // latter exists, but the header itself is what the closure contains.
+  if (!preprocessor.ImplicitPCHInclude.empty()) {
+    llvm::SmallString<256> header(preprocessor.ImplicitPCHInclude);
+    llvm::sys::path::replace_extension(header, "");
+    searchPaths.forced.emplace_back(header.str());
+  }
+
+  return searchPaths;
+}
+
+bool IncludeGraph::_traverse(const clang::tooling::CompileCommand& command,
+                             Visitor visitor) {
+  const auto& searchPaths = _getSearchPaths(command);
+  const auto mainFile = joinPath(command.Directory, command.Filename);
+
+  std::vector<Header> worklist;
+  worklist.push_back({mainFile, /*isSystem=*/false});
+
+  // A forced include that cannot be found may lead anywhere, like any other.
+  bool isMainFileOpen = false;
+  for (const auto& forced : searchPaths.forced) {
+    const Directive directive{forced, /*isAngled=*/false};
+    if (auto resolved = _resolve(directive,
+                                 command.Directory,
+                                 /*isIncluderSystem=*/false,
+                                 searchPaths)) {
+      worklist.emplace_back(std::move(*resolved));
+    } else {
+      isMainFileOpen = true;
+    }
+  }
+
+  llvm::StringSet<> visited;
+  while (!worklist.empty()) {
+    const auto header = std::move(worklist.back());
+    worklist.pop_back();
+
+    if (!visited.insert(header.filename).second) continue;
+
+    const auto* file = _getFile(header.filename);
+    bool isOpen = isMainFileOpen && header.filename == mainFile;
+    if (file != nullptr) {
+      isOpen = isOpen || file->hasComputedInclude;
+
+      const auto directory = llvm::sys::path::parent_path(header.filename);
+      for (const auto& directive : file->directives) {
+        if (auto resolved = _resolve(directive,
+                                     directory,
+                                     header.isSystem,
+                                     searchPaths)) {
+          worklist.emplace_back(std::move(*resolved));
+        } else if (!header.isSystem) {
+          isOpen = true;
+        }
+      }
+    }
+
+    if (!visitor(header.filename, file, isOpen)) return false;
+  }
+
+  return true;
+}
+
+const IncludeGraph::File* IncludeGraph::_getFile(const std::string& filename) {
+  auto iterator = _files.find(filename);
+  if (iterator != _files.end() && iterator->getValue().isValidated) {
+    return &iterator->getValue();
+  }
+
+  const auto status = _fileSystem->status(filename);
+  if (!status) return nullptr;
+
+  const auto modificationTime =
+      toNanoseconds(status->getLastModificationTime());
+  if (iterator != _files.end()) {
+    auto& file = iterator->getValue();
+    if (file.modificationTime == modificationTime &&
+        file.size == status->getSize()) {
+      file.isValidated = true;
+      return &file;
+    }
+  }
+
+  auto buffer = _fileSystem->getBufferForFile(filename);
+  if (!buffer) return nullptr;
+
+  File file;
+  file.modificationTime = modificationTime;
+  file.size = status->getSize();
+  file.isValidated = true;
+
+  clang::LangOptions languageOptions;
+  languageOptions.CPlusPlus = true;
+  languageOptions.CPlusPlus11 = true;
+  languageOptions.LineComment = true;
+
+  const auto text = (*buffer)->getBuffer();
+  clang::Lexer lexer(clang::SourceLocation(),
+                     languageOptions,
+                     text.begin(),
+                     text.begin(),
+                     text.end());
+
+  // Whether we are still inside the block of include directives at the very
+  // top of the file, before any code or other directive.
+  bool isLeading = true;
+
+  clang::Token token;
+  for (bool atEnd = false; !atEnd;) {
+    atEnd = lexer.LexFromRawLexer(token);
+    if (!token.isAtStartOfLine() || token.is(clang::tok::eof)) continue;
+    if (!token.is(clang::tok::hash)) {
+      isLeading = false;
+      continue;
+    }
+    if (atEnd) break;
+
+    atEnd = lexer.LexFromRawLexer(token);
+    if (!token.is(clang::tok::raw_identifier)) continue;
+
+    const auto keyword = token.getRawIdentifier();
+    if (keyword != "include" && keyword != "include_next" &&
+        keyword != "import") {
+      isLeading = false;
+      continue;
+    }
+
+    // #include_next depends on where the includer was found, which we cannot
+    // replicate when hoisting it into a prefix header.
+    if (keyword == "include_next") isLeading = false;
+
+    const char* position = lexer.getBufferLocation();
+    const llvm::StringRef rest(position, text.end() - position);
+
+    bool isAngled = false;
+    const auto spelling = parseIncludeFilename(rest, isAngled);
+    if (spelling.empty()) {
+      file.hasComputedInclude = true;
+      isLeading = false;
+    } else {
+      file.directives.push_back({spelling.str(), isAngled});
+      if (isLeading) ++file.leadingDirectives;
+    }
+  }
+
+  _scanned.insert(filename);
+  auto& stored = _files[filename];
+  stored = std::move(file);
+  return &stored;
+}
+
+llvm::Optional<IncludeGraph::Header>
+IncludeGraph::_resolve(const Directive& directive,
+                       const llvm::StringRef& includerDirectory,
+                       bool isIncluderSystem,
+                       const SearchPaths& searchPaths) {
+  if (llvm::sys::path::is_absolute(directive.spelling)) {
+    if (!_exists(directive.spelling)) return llvm::None;
+    return Header{directive.spelling, isIncluderSystem};
+  }
+
+  if (!directive.isAngled) {
+    auto candidate = joinPath(includerDirectory, directive.spelling);
+    if (_exists(candidate)) return Header{candidate, isIncluderSystem};
+  }
+
+  auto find = [this, &directive](const SearchDirectory& directory) {
+    std::string candidate;
+    if (directory.isFramework) {
+      // <Name/Header.h> lives in Name.framework/Headers/Header.h.
+      llvm::StringRef framework, header;
+      std::tie(framework, header) =
+          llvm::StringRef(directive.spelling).split('/');
+      if (header.empty()) return llvm::Optional<Header>();
+      const auto path = framework + ".framework/Headers/" + header;
+      candidate = joinPath(directory.path, path.str());
+    } else {
+      candidate = joinPath(directory.path, directive.spelling);
+    }
+
+    if (!_exists(candidate)) return llvm::Optional<Header>();
+    return llvm::Optional<Header>(Header{candidate, directory.isSystem});
+  };
+
+  if (!directive.isAngled) {
+    for (const auto& directory : searchPaths.quoted) {
+      if (auto header = find(directory)) return header;
+    }
+  }
+
+  for (const auto& directory : searchPaths.angled) {
+    if (auto header = find(directory)) return header;
+  }
+
+  // The file may only exist on other platforms or once it was generated by the
+  // build. Callers decide how much to trust the closure without it.
+  return llvm::None;
+}
+
+bool IncludeGraph::_exists(const std::string& filename) {
+  auto iterator = _existence.find(filename);
+  if (iterator != _existence.end()) return iterator->getValue();
+
+  const auto status = _fileSystem->status(filename);
+  const bool exists = status && status->isRegularFile();
+  _existence.insert({filename, exists});
+
+  return exists;
+}
+
+const std::string& IncludeGraph::_getRealPath(const std::string& filename) {
+  auto iterator = _realPaths.find(filename);
+  if (iterator != _realPaths.end()) return iterator->getValue();
+
+  llvm::SmallString<256> realPath;
+  if (llvm::sys::fs::real_path(filename, realPath)) realPath = filename;
+
+  return _realPaths.insert({filename, realPath.str()}).first->getValue();
+}
+
+void IncludeGraph::_read(const std::string& cacheFile,
+                         llvm::StringMap<File>& files) {
+  auto buffer = llvm::MemoryBuffer::getFile(cacheFile);
+  if (!buffer) return;
+
+  llvm::SmallVector<llvm::StringRef, 256> lines;
+  (*buffer)->getBuffer().split(lines, '\n', -1, /*KeepEmpty=*/false);
+  if (lines.empty() || lines.front() != cacheHeader) return;
+
+  llvm::StringMap<File> read;
+  File* current = nullptr;
+  for (auto line = std::next(lines.begin()); line != lines.end(); ++line) {
+    llvm::StringRef rest;
+    llvm::StringRef kind;
+    std::tie(kind, rest) = line->split(' ');
+
+    if (kind == "F") {
+      llvm::StringRef time, size, computed, leading;
+      std::tie(time, rest) = rest.split(' ');
+      std::tie(size, rest) = rest.split(' ');
+      std::tie(computed, rest) = rest.split(' ');
+      std::tie(leading, rest) = rest.split(' ');
+
+      File file;
+      if (time.getAsInteger(10, file.modificationTime) ||
+          size.getAsInteger(10, file.size) ||
+          leading.getAsInteger(10, file.leadingDirectives) || rest.empty()) {
+        return;
+      }
+      file.hasComputedInclude = (computed == "1");
+      current = &(read[rest] = std::move(file));
+    } else if ((kind == "A" || kind == "Q") && current != nullptr) {
+      current->directives.push_back({rest.str(), kind == "A"});
+    } else {
+      return;
+    }
+  }
+
+  for (auto& entry : read) {
+    files[entry.getKey()] = std::move(entry.getValue());
+  }
+}
+
+void IncludeGraph::_load() {
+  _read(_cacheFile, _files);
+}
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
@@ -24,6 +24,7 @@
 
 // Project includes
 #include "clang-expand/definition-search/match-handler.hpp"
+#include "clang-expand/common/canonical-location.hpp"
 #include "clang-expand/common/context-data.hpp"
 #include "clang-expand/common/declaration-data.hpp"
 #include "clang-expand/common/definition-data.hpp"
@@ -41,6 +42,7 @@
 #include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/Support/Casting.h>
+#include <llvm/Support/Error.h>
 
 // Standard includes
 #include <cassert>
@@ -65,6 +67,8 @@ MatchHandler::MatchHandler(Query& query) : _query(query) {
 }
 
 void MatchHandler::run(const MatchResult& result) {
+  if (_query.error || _query.isCancelled()) return;
+
   const auto* function = result.Nodes.getNodeAs<clang::FunctionDecl>("fn");
   assert(function != nullptr && "Got null function node in match handler");
 
@@ -75,8 +79,19 @@ void MatchHandler::run(const MatchResult& result) {
   if (!_matchParameters(*result.Context, *function)) return;
   if (!_matchContexts(*function)) return;
 
+  // Definitions in headers are found again in every source including them.
+  const CanonicalLocation canonical(function->getLocation(),
+                                    result.Context->getSourceManager());
+  const auto filename = canonical.getFilename(*_query.strings);
+  if (_query.hasDefinitionAt(filename, canonical.offset)) return;
+
   auto definition = DefinitionData::Collect(*function, *result.Context, _query);
-  _query.definition = std::move(definition);
+  if (!definition) {
+    _query.fail(definition.takeError());
+    return;
+  }
+
+  _query.addDefinition(std::move(*definition), filename, canonical.offset);
 }
 
 bool MatchHandler::_matchParameters(const clang::ASTContext& context,
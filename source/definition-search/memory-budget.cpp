@@ -0,0 +1,154 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/definition-search/memory-budget.hpp"
+
+// LLVM includes
+#include <llvm/ADT/None.h>
+#include <llvm/ADT/Optional.h>
+
+// System includes
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+// Standard includes
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace {
+/// Reads a single number from a file such as `memory.max`, which holds `max`
+/// if there is no limit.
+llvm::Optional<std::uint64_t> readNumber(const char* filename) {
+  std::ifstream stream(filename);
+  std::uint64_t number;
+  if (!(stream >> number)) return llvm::None;
+  return number;
+}
+
+/// Reads the memory the system could give us without swapping, in bytes.
+llvm::Optional<std::uint64_t> readAvailableMemory() {
+  std::ifstream stream("/proc/meminfo");
+  std::string key;
+  std::uint64_t kilobytes;
+  while (stream >> key >> kilobytes) {
+    if (key == "MemAvailable:") return kilobytes * 1024;
+    stream.ignore(64, '\n');
+  }
+
+  // Systems without /proc still tell us how much memory they have.
+#if !defined(_WIN32)
+  const auto pages = sysconf(_SC_PHYS_PAGES);
+  const auto pageSize = sysconf(_SC_PAGESIZE);
+  if (pages > 0 && pageSize > 0) {
+    return static_cast<std::uint64_t>(pages) *
+           static_cast<std::uint64_t>(pageSize);
+  }
+#endif
+
+  return llvm::None;
+}
+
+/// Reads the headroom under the limit of our memory cgroup (v2, else v1), in
+/// bytes.
+llvm::Optional<std::uint64_t> readCgroupHeadroom() {
+  auto limit = readNumber("/sys/fs/cgroup/memory.max");
+  auto usage = readNumber("/sys/fs/cgroup/memory.current");
+  if (!limit) {
+    limit = readNumber("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+    usage = readNumber("/sys/fs/cgroup/memory/memory.usage_in_bytes");
+  }
+
+  if (!limit) return llvm::None;
+  if (!usage || *usage > *limit) return *limit;
+  return *limit - *usage;
+}
+}  // namespace
+
+MemoryBudget::MemoryBudget(std::uint64_t bytes) {
+  if (bytes > 0) {
+    _budget = bytes;
+  } else {
+    _budget = detect();
+  }
+}
+
+bool MemoryBudget::isLimited() const noexcept {
+  return _budget.hasValue();
+}
+
+llvm::Optional<std::uint64_t> MemoryBudget::getLimit() const noexcept {
+  return _budget;
+}
+
+bool MemoryBudget::acquire(std::uint64_t bytes, StopPredicate shouldStop) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _released.wait(lock, [this, bytes, shouldStop] {
+    return shouldStop() || !_budget || _admitted == 0 ||
+           _admitted + bytes <= *_budget;
+  });
+
+  if (shouldStop()) return false;
+
+  _admitted += bytes;
+  return true;
+}
+
+void MemoryBudget::release(std::uint64_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _admitted -= std::min(bytes, _admitted);
+  }
+  _released.notify_all();
+}
+
+void MemoryBudget::interrupt() {
+  // Taking the lock makes sure no waiter is between checking its predicate
+  // and going to sleep, where it would miss the notification.
+  { std::lock_guard<std::mutex> lock(_mutex); }
+  _released.notify_all();
+}
+
+llvm::Optional<std::uint64_t> MemoryBudget::detect() {
+  auto headroom = readAvailableMemory();
+  if (auto cgroupHeadroom = readCgroupHeadroom()) {
+    headroom = headroom ? std::min(*headroom, *cgroupHeadroom) : cgroupHeadroom;
+  }
+
+  if (!headroom) return llvm::None;
+
+  // The thread parsing the call (and definition search after it) needs memory
+  // too, which the budget does not account for.
+  return *headroom / 4 * 3;
+}
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
@@ -0,0 +1,167 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/definition-search/parse-history.hpp"
+
+// LLVM includes
+#include <llvm/ADT/None.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace {
+/// The first line of the history file, bumped whenever its format changes.
+constexpr const char* historyHeader = "clang-expand-parse-history 2";
+
+/// A rough ratio of the memory taken by an AST to the size of the sources it
+/// was parsed from, for translation units that were never parsed before.
+constexpr std::uint64_t astBytesPerSourceByte = 8;
+
+/// A rough rate at which clang parses source code, for translation units that
+/// were never parsed before. Only used to order parses, so it need not be
+/// accurate, just consistent.
+constexpr std::uint64_t sourceBytesPerMillisecond = 2048;
+
+/// Reads the history from the `file` into the `costs`. A corrupt or outdated
+/// history is ignored.
+void readHistory(const std::string& file,
+                 llvm::StringMap<ParseHistory::Cost>& costs) {
+  auto buffer = llvm::MemoryBuffer::getFile(file);
+  if (!buffer) return;
+
+  llvm::SmallVector<llvm::StringRef, 256> lines;
+  (*buffer)->getBuffer().split(lines, '\n', -1, /*KeepEmpty=*/false);
+  if (lines.empty() || lines.front() != historyHeader) return;
+
+  llvm::StringMap<ParseHistory::Cost> read;
+  for (auto line = std::next(lines.begin()); line != lines.end(); ++line) {
+    llvm::StringRef kind, memory, milliseconds, includes, source;
+    std::tie(kind, source) = line->split(' ');
+    std::tie(memory, source) = source.split(' ');
+    std::tie(milliseconds, source) = source.split(' ');
+    std::tie(includes, source) = source.split(' ');
+
+    ParseHistory::Cost cost;
+    if (kind != "C" || memory.getAsInteger(10, cost.retainedMemory) ||
+        milliseconds.getAsInteger(10, cost.milliseconds) ||
+        includes.getAsInteger(10, cost.includes) || source.empty()) {
+      return;
+    }
+    read[source] = cost;
+  }
+
+  for (const auto& entry : read) {
+    costs[entry.getKey()] = entry.getValue();
+  }
+}
+}  // namespace
+
+ParseHistory::ParseHistory(std::string file) : _file(std::move(file)) {
+  if (!_file.empty()) _load();
+}
+
+llvm::Optional<ParseHistory::Cost>
+ParseHistory::getCost(llvm::StringRef source) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const auto iterator = _costs.find(source);
+  if (iterator == _costs.end()) return llvm::None;
+  return iterator->getValue();
+}
+
+ParseHistory::Cost ParseHistory::estimateCost(llvm::StringRef source,
+                                              std::uint64_t sourceBytes) const {
+  if (auto cost = getCost(source)) return *cost;
+
+  Cost cost;
+  cost.retainedMemory = sourceBytes * astBytesPerSourceByte;
+  cost.milliseconds = sourceBytes / sourceBytesPerMillisecond;
+  cost.includes = 0;
+
+  return cost;
+}
+
+void ParseHistory::recordCost(llvm::StringRef source, const Cost& cost) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _costs[source] = cost;
+  _recorded.insert(source);
+}
+
+void ParseHistory::save() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_file.empty() || _recorded.empty()) return;
+
+  // Other processes may have saved the history since we loaded it, so what
+  // they recorded is kept, unless we parsed the same sources since.
+  llvm::StringMap<Cost> costs;
+  readHistory(_file, costs);
+  for (const auto& source : _recorded) {
+    costs[source.getKey()] = _costs.lookup(source.getKey());
+  }
+
+  // Each process writes its own temporary file, which replaces the history
+  // atomically.
+  int descriptor;
+  llvm::SmallString<256> temporary;
+  if (llvm::sys::fs::createUniqueFile(_file + ".tmp-%%%%%%%%",
+                                      descriptor,
+                                      temporary)) {
+    return;
+  }
+
+  {
+    llvm::raw_fd_ostream stream(descriptor, /*shouldClose=*/true);
+    stream << historyHeader << '\n';
+    for (const auto& entry : costs) {
+      const auto& cost = entry.getValue();
+      stream << "C " << cost.retainedMemory << ' ' << cost.milliseconds << ' '
+             << cost.includes << ' ' << entry.getKey() << '\n';
+    }
+  }
+
+  if (llvm::sys::fs::rename(temporary, _file)) {
+    llvm::sys::fs::remove(temporary);
+  }
+}
+
+void ParseHistory::_load() {
+  readHistory(_file, _costs);
+}
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
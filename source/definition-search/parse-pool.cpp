@@ -0,0 +1,124 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/definition-search/parse-pool.hpp"
+#include "clang-expand/common/translation-unit.hpp"
+#include "clang-expand/options.hpp"
+
+// Clang includes
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/ASTUnit.h>
+
+// Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <numeric>
+#include <utility>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+
+ParsePool::ParsePool(FileSystemPointer fileSystem,
+                     const Options& options,
+                     unsigned threadCount)
+: _fileSystem(std::move(fileSystem))
+, _history(options.parseHistory)
+, _budget(options.memoryBudget)
+, _threadPool(threadCount) {
+}
+
+ParsePool::~ParsePool() {
+  _threadPool.wait();
+  _history.save();
+}
+
+ParseHistory::Cost ParsePool::estimateCost(llvm::StringRef source,
+                                           SizeFunction getSize) const {
+  if (auto cost = _history.getCost(source)) return *cost;
+  return _history.estimateCost(source, getSize());
+}
+
+std::vector<std::shared_future<void>>
+ParsePool::enqueue(std::vector<Job> jobs, JobFunction run) {
+  std::vector<std::size_t> order(jobs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&jobs](auto a, auto b) {
+    return jobs[a].cost.milliseconds > jobs[b].cost.milliseconds;
+  });
+
+  std::vector<std::shared_future<void>> finished(jobs.size());
+  for (const auto index : order) {
+    finished[index] = _threadPool.async(
+        [run, job = std::move(jobs[index])] { run(job); });
+  }
+
+  return finished;
+}
+
+std::shared_future<void> ParsePool::async(std::function<void()> task) {
+  return _threadPool.async(std::move(task));
+}
+
+std::unique_ptr<clang::ASTUnit>
+ParsePool::parse(const Job& job, MemoryBudget::StopPredicate shouldStop) {
+  if (!_budget.acquire(job.cost.retainedMemory, shouldStop)) return nullptr;
+
+  const auto start = std::chrono::steady_clock::now();
+  auto unit = TranslationUnit::parse(job.command, _fileSystem);
+  if (!unit) {
+    release(job.cost.retainedMemory);
+    return nullptr;
+  }
+
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  ParseHistory::Cost cost;
+  cost.retainedMemory = TranslationUnit::measureMemory(*unit);
+  cost.milliseconds =
+      std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+  cost.includes = unit->getSourceManager().fileinfo_size();
+  _history.recordCost(job.source, cost);
+
+  return unit;
+}
+
+void ParsePool::release(std::uint64_t memory) {
+  _budget.release(memory);
+}
+
+void ParsePool::interrupt() {
+  _budget.interrupt();
+}
+
+void ParsePool::wait() {
+  _threadPool.wait();
+}
+
+const MemoryBudget& ParsePool::getBudget() const noexcept {
+  return _budget;
+}
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
@@ -0,0 +1,273 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/definition-search/prefix-header.hpp"
+#include "clang-expand/definition-search/include-graph.hpp"
+
+// Clang includes
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Frontend/PCHContainerOperations.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/Tooling.h>
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace {
+/// A candidate source together with its (only) compile command.
+struct Candidate {
+  /// The source, as passed to definition search.
+  std::string source;
+
+  /// The compile command of the source.
+  clang::tooling::CompileCommand command;
+};
+
+/// Returns the flags of a compile command that affect the meaning of the code.
+/// That is, all arguments except for the compiler, the input file, the output
+/// file and anything to do with dependency files.
+std::vector<std::string>
+getFlags(const clang::tooling::CompileCommand& command) {
+  const auto input = llvm::sys::path::filename(command.Filename);
+  const auto& arguments = command.CommandLine;
+
+  std::vector<std::string> flags;
+  for (std::size_t index = 1; index < arguments.size(); ++index) {
+    const llvm::StringRef argument(arguments[index]);
+    if (argument == "-o" || argument == "-MF" || argument == "-MT" ||
+        argument == "-MQ") {
+      ++index;
+      continue;
+    }
+    if (argument == "-c" || argument == "-fsyntax-only") continue;
+    if (argument.startswith("-M")) continue;
+    if (argument.startswith("-o") && !argument.startswith("-objc")) continue;
+    if (!argument.startswith("-") &&
+        llvm::sys::path::filename(argument) == input) {
+      continue;
+    }
+    flags.emplace_back(argument);
+  }
+
+  return flags;
+}
+
+/// Returns the `-x` language to precompile a header with, given the flags and
+/// main file of the sources it is for.
+const char* getHeaderLanguage(const std::vector<std::string>& flags,
+                              const llvm::StringRef& source) {
+  auto language = std::find(flags.begin(), flags.end(), "-x");
+  if (language != flags.end() && std::next(language) != flags.end()) {
+    if (*std::next(language) == "c") return "c-header";
+  }
+  if (llvm::sys::path::extension(source) == ".c") return "c-header";
+  return "c++-header";
+}
+
+/// Returns the modification time of a file on disk in nanoseconds, or a
+/// negative value if the file does not exist.
+std::int64_t getModificationTime(const llvm::StringRef& filename) {
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(filename, status)) return -1;
+  if (!llvm::sys::fs::exists(status)) return -1;
+
+  using std::chrono::nanoseconds;
+  const auto time = status.getLastModificationTime().time_since_epoch();
+  return std::chrono::duration_cast<nanoseconds>(time).count();
+}
+}  // namespace
+
+PrefixHeader::PrefixHeader(std::string cacheDirectory,
+                           FileSystemPointer fileSystem)
+: _cacheDirectory(std::move(cacheDirectory))
+, _fileSystem(std::move(fileSystem)) {
+}
+
+bool PrefixHeader::prepare(
+    const clang::tooling::CompilationDatabase& compilationDatabase,
+    const SourceVector& sources,
+    IncludeGraph& includeGraph) {
+  // Group the sources by their directory and flags, since a precompiled
+  // header can only be used with the exact flags it was built with.
+  llvm::StringMap<std::vector<Candidate>> groups;
+  for (const auto& source : sources) {
+    auto commands = compilationDatabase.getCompileCommands(source);
+    if (commands.size() != 1) continue;
+
+    std::string key = commands.front().Directory;
+    for (const auto& flag : getFlags(commands.front())) {
+      key += '\0';
+      key += flag;
+    }
+
+    groups[key].push_back({source, std::move(commands.front())});
+  }
+
+  auto largest = std::max_element(groups.begin(),
+                                   groups.end(),
+                                   [](const auto& first, const auto& second) {
+                                     return first.getValue().size() <
+                                            second.getValue().size();
+                                   });
+
+  // A shared PCH is only worth it for more than one source.
+  if (largest == groups.end() || largest->getValue().size() < 2) return false;
+  const auto& group = largest->getValue();
+
+  auto prefix = includeGraph.getLeadingIncludes(group.front().command);
+  for (auto candidate = std::next(group.begin()); candidate != group.end();
+       ++candidate) {
+    if (prefix.empty()) return false;
+    const auto includes = includeGraph.getLeadingIncludes(candidate->command);
+    const auto length = std::min(prefix.size(), includes.size());
+    const auto mismatch = std::mismatch(prefix.begin(),
+                                        prefix.begin() + length,
+                                        includes.begin());
+    prefix.erase(mismatch.first, prefix.end());
+  }
+  if (prefix.empty()) return false;
+
+  std::string contents;
+  for (const auto& include : prefix) {
+    contents += "#include \"" + include + "\"\n";
+  }
+
+  llvm::MD5 hash;
+  hash.update(largest->getKey());
+  hash.update(contents);
+  llvm::MD5::MD5Result digest;
+  hash.final(digest);
+  llvm::SmallString<32> hexDigest;
+  llvm::MD5::stringifyResult(digest, hexDigest);
+
+  if (llvm::sys::fs::create_directories(_cacheDirectory)) return false;
+
+  llvm::SmallString<256> headerFile(_cacheDirectory);
+  llvm::sys::path::append(headerFile,
+                          llvm::Twine("prefix-") + hexDigest.str() + ".h");
+  llvm::SmallString<256> pchFile(headerFile);
+  llvm::sys::path::replace_extension(pchFile, "pch");
+
+  if (!llvm::sys::fs::exists(headerFile)) {
+    std::error_code error;
+    llvm::raw_fd_ostream stream(headerFile, error, llvm::sys::fs::F_Text);
+    if (error) return false;
+    stream << contents;
+  }
+
+  // The prefix header is compiled like the sources in the group.
+  const auto& representative = group.front();
+  clang::tooling::CompileCommand headerCommand;
+  headerCommand.Directory = representative.command.Directory;
+  headerCommand.Filename = headerFile.str();
+  headerCommand.CommandLine = getFlags(representative.command);
+  headerCommand.CommandLine.insert(headerCommand.CommandLine.begin(),
+                                   representative.command.CommandLine.front());
+  headerCommand.CommandLine.emplace_back("-x");
+  headerCommand.CommandLine.emplace_back(
+      getHeaderLanguage(headerCommand.CommandLine, representative.source));
+  headerCommand.CommandLine.emplace_back(headerFile.str());
+
+  const auto latestInput =
+      includeGraph.getLatestModificationTime(headerCommand);
+  const bool isUpToDate =
+      latestInput && getModificationTime(pchFile) >= *latestInput;
+
+  _pchFile = pchFile.str();
+  if (!isUpToDate && !_build(headerCommand, headerFile.str())) {
+    _pchFile.clear();
+    return false;
+  }
+
+  for (const auto& candidate : group) {
+    _compatibleSources.insert(candidate.command.Filename);
+  }
+
+  return true;
+}
+
+clang::tooling::ArgumentsAdjuster PrefixHeader::getArgumentsAdjuster() const {
+  return [this](const clang::tooling::CommandLineArguments& arguments,
+                llvm::StringRef filename) {
+    if (_pchFile.empty() || !_compatibleSources.count(filename)) {
+      return arguments;
+    }
+
+    clang::tooling::CommandLineArguments adjusted(arguments);
+    adjusted.insert(std::next(adjusted.begin()), {"-include-pch", _pchFile});
+    return adjusted;
+  };
+}
+
+bool PrefixHeader::_build(const clang::tooling::CompileCommand& command,
+                          const std::string& headerFile) const {
+  // FixedCompilationDatabase adds the compiler and the file itself.
+  std::vector<std::string> arguments(std::next(command.CommandLine.begin()),
+                                     std::prev(command.CommandLine.end()));
+  arguments.emplace_back("-o");
+  arguments.emplace_back(_pchFile);
+
+  clang::tooling::FixedCompilationDatabase compilationDatabase(
+      command.Directory, arguments);
+  clang::tooling::ClangTool tool(
+      compilationDatabase,
+      {headerFile},
+      std::make_shared<clang::PCHContainerOperations>(),
+      _fileSystem);
+
+  // The default adjusters would strip the output file and turn this into a
+  // syntax-only run.
+  tool.clearArgumentsAdjusters();
+
+  auto factory =
+      clang::tooling::newFrontendActionFactory<clang::GeneratePCHAction>();
+  return tool.run(factory.get()) == 0;
+}
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
@@ -0,0 +1,238 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/definition-search/speculation.hpp"
+#include "clang-expand/common/location.hpp"
+#include "clang-expand/common/query.hpp"
+#include "clang-expand/common/string-pool.hpp"
+#include "clang-expand/definition-search/candidates.hpp"
+#include "clang-expand/definition-search/consumer.hpp"
+#include "clang-expand/definition-search/include-graph.hpp"
+#include "clang-expand/options.hpp"
+
+// Clang includes
+#include <clang/AST/ASTContext.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/Basic/CharInfo.h>
+#include <clang/Basic/VirtualFileSystem.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Tooling/CompilationDatabase.h>
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+// Standard includes
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ClangExpand {
+namespace DefinitionSearch {
+namespace {
+/// How many parses are queued per thread when the memory budget is unlimited.
+constexpr unsigned queuedParsesPerThread = 4;
+
+/// One core is busy with symbol search, the others may speculate.
+unsigned getThreadCount() {
+  const auto cores = std::thread::hardware_concurrency();
+  return cores > 1 ? cores - 1 : 1;
+}
+
+/// Checks whether the text contains the name as a whole identifier. Operators
+/// are only checked for the `operator` keyword.
+bool mentions(llvm::StringRef text, llvm::StringRef name) {
+  if (name.startswith("operator")) name = "operator";
+
+  for (auto index = text.find(name); index != llvm::StringRef::npos;
+       index = text.find(name, index + 1)) {
+    const auto end = index + name.size();
+    const bool startsWord =
+        index == 0 || !clang::isIdentifierBody(text[index - 1]);
+    const bool endsWord =
+        end == text.size() || !clang::isIdentifierBody(text[end]);
+    if (startsWord && endsWord) return true;
+  }
+
+  return false;
+}
+
+/// Checks whether the AST contains a definition of a function with the name.
+bool definesFunction(clang::ASTContext& context, const std::string& name) {
+  using namespace clang::ast_matchers;  // NOLINT(build/namespaces)
+  const auto matcher = functionDecl(isDefinition(), hasName(name));
+  return !match(decl(matcher), context).empty();
+}
+}  // namespace
+
+Speculation::Speculation(CompilationDatabase& compilationDatabase,
+                         SourceVector candidates,
+                         const std::string& targetFile,
+                         FileSystemPointer fileSystem,
+                         const Options& options)
+: _compilationDatabase(compilationDatabase)
+, _candidates(std::move(candidates))
+, _targetFile(targetFile)
+, _fileSystem(std::move(fileSystem))
+, _includeGraphCache(options.includeGraphCache)
+, _threadCount(getThreadCount())
+, _pool(_fileSystem, options, _threadCount) {
+}
+
+Speculation::~Speculation() {
+  _abandoned = true;
+  _pool.interrupt();
+  _pool.wait();
+}
+
+void Speculation::start(llvm::StringRef spelling) {
+  // Picking candidates reads their sources, so that is done in the background
+  // as well. Reading them now also warms the file cache for later parses.
+  _planned =
+      _pool.async([this, spelling = spelling.str()] { _plan(spelling); });
+}
+
+bool Speculation::search(const std::string& source, Query& query) {
+  if (!_planned.valid()) return false;
+  _planned.wait();
+
+  auto iterator = _parses.find(source);
+  if (iterator == _parses.end()) return false;
+
+  auto& parse = iterator->second;
+  if (!parse.isClaimed.exchange(true)) return false;
+
+  parse.isSkipped = true;
+  _pool.interrupt();
+
+  // A running parse cannot be interrupted, but the query need not wait for it
+  // past its deadline.
+  if (query.deadline) {
+    const auto status = parse.finished.wait_until(*query.deadline);
+    if (status == std::future_status::timeout) return false;
+  } else {
+    parse.finished.wait();
+  }
+  if (!parse.succeeded) return false;
+
+  if (parse.unit) {
+    Consumer consumer(query);
+    consumer.HandleTranslationUnit(parse.unit->getASTContext());
+    parse.unit.reset();
+    _pool.release(parse.admittedMemory);
+    parse.admittedMemory = 0;
+  }
+
+  return true;
+}
+
+void Speculation::_plan(const std::string& spelling) {
+  // Without the declaration, the closest we have to its locality is the call.
+  StringPool strings;
+  Candidates::orderByLocality(_candidates,
+                              Location(_targetFile, 1, 1, strings));
+
+  // Only read (and possibly scan) includes if memory estimates are needed.
+  const auto& budget = _pool.getBudget();
+  std::unique_ptr<IncludeGraph> includeGraph;
+  if (budget.isLimited()) {
+    includeGraph = std::make_unique<IncludeGraph>(_includeGraphCache,
+                                                  _fileSystem);
+  }
+
+  // More parses are queued than there are threads, so that idle threads pick
+  // up the next one right away. The queue holds what the budget could admit at
+  // once (at least one parse), or a few parses per thread without a budget.
+  const auto limit = budget.getLimit();
+  std::uint64_t queuedMemory = 0;
+
+  std::vector<ParsePool::Job> jobs;
+  for (const auto& source : _candidates) {
+    if (_abandoned) break;
+    if (!limit && jobs.size() == _threadCount * queuedParsesPerThread) break;
+    if (source == _targetFile) continue;
+
+    auto buffer = _fileSystem->getBufferForFile(source);
+    if (!buffer || !mentions((*buffer)->getBuffer(), spelling)) continue;
+
+    auto commands = _compilationDatabase.getCompileCommands(source);
+    if (commands.empty()) continue;
+
+    // Without includes (or if they cannot be found), at least the main file
+    // counts.
+    auto cost = _pool.estimateCost(source, [&] {
+      std::uint64_t size = 0;
+      if (includeGraph) size = includeGraph->getClosureSize(commands.front());
+      return size > 0 ? size : (*buffer)->getBufferSize();
+    });
+    if (limit && !jobs.empty() && queuedMemory + cost.retainedMemory > *limit) {
+      break;
+    }
+    queuedMemory += cost.retainedMemory;
+    jobs.push_back({source, std::move(commands.front()), cost});
+  }
+
+  // All parses exist before the first job runs, since jobs look theirs up.
+  std::vector<Parse*> parses;
+  for (const auto& job : jobs) parses.push_back(&_parses[job.source]);
+
+  auto finished =
+      _pool.enqueue(std::move(jobs), [this, spelling](const auto& job) {
+        _parse(job, spelling, _parses.at(job.source));
+      });
+  for (std::size_t index = 0; index < parses.size(); ++index) {
+    parses[index]->finished = std::move(finished[index]);
+  }
+}
+
+void Speculation::_parse(const ParsePool::Job& job,
+                         const std::string& spelling,
+                         Parse& parse) {
+  if (_abandoned || parse.isClaimed.exchange(true)) return;
+
+  auto shouldStop = [this, &parse] { return _abandoned || parse.isSkipped; };
+  auto unit = _pool.parse(job, shouldStop);
+  if (!unit) return;
+
+  parse.succeeded = true;
+
+  // Most candidates do not define the function, and ASTs are big.
+  if (definesFunction(unit->getASTContext(), spelling)) {
+    parse.unit = std::move(unit);
+    parse.admittedMemory = job.cost.retainedMemory;
+  } else {
+    unit.reset();
+    _pool.release(job.cost.retainedMemory);
+  }
+}
+
+}  // namespace DefinitionSearch
+}  // namespace ClangExpand
@@ -30,17 +30,17 @@
 // Clang includes
 #include <clang/Frontend/FrontendAction.h>
 
-// Standard includes
-#include <string>
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
 
 namespace ClangExpand {
 namespace DefinitionSearch {
-ToolFactory::ToolFactory(const std::string& declarationFile, Query& query)
+ToolFactory::ToolFactory(llvm::StringRef declarationFile, Query& query)
 : _declarationFile(declarationFile), _query(query) {
 }
 
 clang::FrontendAction* ToolFactory::create() {
-  return new DefinitionSearch::Action(_declarationFile, _query);
+  return new DefinitionSearch::Action(_declarationFile.str(), _query);
 }
 
 }  // namespace DefinitionSearch
@@ -0,0 +1,79 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/error.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace ClangExpand {
+char Error::ID;
+
+Error::Error(ErrorKind kind, std::string message)
+: _kind(kind), _message(std::move(message)) {
+}
+
+const char* Error::getKindName(ErrorKind kind) noexcept {
+  switch (kind) {
+    case ErrorKind::FileNotFound: return "file-not-found";
+    case ErrorKind::InvalidLocation: return "invalid-location";
+    case ErrorKind::InvalidToken: return "invalid-token";
+    case ErrorKind::UnknownSymbol: return "unknown-symbol";
+    case ErrorKind::RefusedExpansion: return "refused-expansion";
+    case ErrorKind::DefinitionNotFound: return "definition-not-found";
+    case ErrorKind::ToolFailure: return "tool-failure";
+    case ErrorKind::Cancelled: return "cancelled";
+    case ErrorKind::InvalidConfiguration: return "invalid-configuration";
+    case ErrorKind::InconsistentShards: return "inconsistent-shards";
+  }
+  return "unknown";
+}
+
+void Error::log(llvm::raw_ostream& stream) const {
+  stream << _message;
+}
+
+std::error_code Error::convertToErrorCode() const {
+  return llvm::inconvertibleErrorCode();
+}
+
+nlohmann::json Error::toJson() const {
+  // clang-format off
+  return {
+    {"kind", getKindName(_kind)},
+    {"message", _message}
+  };
+  // clang-format on
+}
+}  // namespace ClangExpand
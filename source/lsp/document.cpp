@@ -0,0 +1,147 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/lsp/document.hpp"
+#include "clang-expand/common/offset.hpp"
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <utility>
+
+namespace ClangExpand {
+namespace LSP {
+namespace {
+/// Returns the length in bytes of the UTF-8 sequence starting with the byte.
+unsigned getSequenceLength(unsigned char byte) noexcept {
+  if (byte < 0xC0) return 1;
+  if (byte < 0xE0) return 2;
+  if (byte < 0xF0) return 3;
+  return 4;
+}
+
+/// Returns the number of UTF-16 code units encoding the UTF-8 sequence of the
+/// given length. Only characters outside the basic multilingual plane (which
+/// take four bytes) need a surrogate pair.
+unsigned getCodeUnits(unsigned sequenceLength) noexcept {
+  return sequenceLength == 4 ? 2 : 1;
+}
+
+/// Converts an offset into the line in UTF-16 code units to one in bytes.
+std::size_t toBytes(llvm::StringRef line, unsigned character) {
+  std::size_t bytes = 0;
+  unsigned units = 0;
+  while (bytes < line.size() && units < character) {
+    const auto length = getSequenceLength(line[bytes]);
+    bytes += length;
+    units += getCodeUnits(length);
+  }
+
+  // Past the end of the line, every character counts as one byte.
+  if (units < character) bytes += character - units;
+
+  return bytes;
+}
+
+/// Converts an offset into the line in bytes to one in UTF-16 code units.
+unsigned toCodeUnits(llvm::StringRef line, std::size_t byteOffset) {
+  std::size_t bytes = 0;
+  unsigned units = 0;
+  while (bytes < line.size() && bytes < byteOffset) {
+    const auto length = getSequenceLength(line[bytes]);
+    bytes += length;
+    units += getCodeUnits(length);
+  }
+
+  if (bytes < byteOffset) units += byteOffset - bytes;
+
+  return units;
+}
+}  // namespace
+
+Document::Document(std::string text) : _text(std::move(text)) {
+}
+
+void Document::setText(std::string text) {
+  _text = std::move(text);
+}
+
+void Document::replace(const Position& begin,
+                       const Position& end,
+                       llvm::StringRef text) {
+  const auto first = _getByteOffset(begin);
+  const auto last = std::max(first, _getByteOffset(end));
+  _text.replace(first, last - first, text.data(), text.size());
+}
+
+Offset Document::getOffset(const Position& position) const {
+  const auto bytes = toBytes(_getLine(position.line), position.character);
+  return {position.line + 1, static_cast<unsigned>(bytes) + 1};
+}
+
+Position Document::getPosition(const Offset& offset) const {
+  const auto line = offset.line > 0 ? offset.line - 1 : 0;
+  const auto column = offset.column > 0 ? offset.column - 1 : 0;
+  return {line, toCodeUnits(_getLine(line), column)};
+}
+
+std::size_t Document::_getLineStart(unsigned line) const {
+  std::size_t start = 0;
+  for (unsigned current = 0; current < line; ++current) {
+    start = _text.find('\n', start);
+    if (start == std::string::npos) return std::string::npos;
+    start += 1;
+  }
+
+  return start;
+}
+
+llvm::StringRef Document::_getLine(unsigned line) const {
+  const auto start = _getLineStart(line);
+  if (start == std::string::npos) return {};
+
+  llvm::StringRef text(_text);
+  auto contents = text.substr(start, text.find('\n', start) - start);
+  if (contents.endswith("\r")) contents = contents.drop_back();
+
+  return contents;
+}
+
+std::size_t Document::_getByteOffset(const Position& position) const {
+  const auto start = _getLineStart(position.line);
+  if (start == std::string::npos) return _text.size();
+
+  const auto bytes = toBytes(_getLine(position.line), position.character);
+  const auto lineEnd = std::min(_text.find('\n', start), _text.size());
+
+  return std::min(start + bytes, lineEnd);
+}
+
+}  // namespace LSP
+}  // namespace ClangExpand
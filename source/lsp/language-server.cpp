@@ -0,0 +1,495 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/lsp/language-server.hpp"
+#include "clang-expand/common/location.hpp"
+#include "clang-expand/common/range.hpp"
+#include "clang-expand/common/routines.hpp"
+#include "clang-expand/error.hpp"
+#include "clang-expand/lsp/document.hpp"
+#include "clang-expand/lsp/transport.hpp"
+#include "clang-expand/options.hpp"
+#include "clang-expand/result.hpp"
+#include "clang-expand/session.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// Clang includes
+#include <clang/Tooling/CompilationDatabase.h>
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace ClangExpand {
+namespace LSP {
+namespace {
+/// JSON-RPC error codes.
+namespace ErrorCode {
+constexpr int invalidParams = -32602;
+constexpr int methodNotFound = -32601;
+}  // namespace ErrorCode
+
+// JSON parsed from the client may have any shape, and accessing it the wrong
+// way aborts (we build without exceptions). All access goes through these.
+
+/// Checks whether we answer requests with this method.
+bool isSupported(llvm::StringRef method) {
+  return method == "initialize" || method == "shutdown" ||
+         method == "textDocument/codeAction" ||
+         method == "textDocument/definition";
+}
+
+/// Returns the member of the object, or null if there is no such member (or
+/// the value is not an object).
+const nlohmann::json* getMember(const nlohmann::json& object, const char* key) {
+  if (!object.is_object()) return nullptr;
+  const auto iterator = object.find(key);
+  return iterator == object.end() ? nullptr : &*iterator;
+}
+
+llvm::Optional<std::string> getString(const nlohmann::json& object,
+                                      const char* key) {
+  const auto* member = getMember(object, key);
+  if (member == nullptr || !member->is_string()) return llvm::None;
+  return member->get<std::string>();
+}
+
+llvm::Optional<unsigned> getUnsigned(const nlohmann::json& object,
+                                     const char* key) {
+  const auto* member = getMember(object, key);
+  if (member == nullptr || !member->is_number_integer()) return llvm::None;
+  const auto value = member->get<long long>();
+  if (value < 0) return llvm::None;
+  return static_cast<unsigned>(value);
+}
+
+llvm::Optional<Position> getPosition(const nlohmann::json& object,
+                                     const char* key) {
+  const auto* member = getMember(object, key);
+  if (member == nullptr) return llvm::None;
+
+  const auto line = getUnsigned(*member, "line");
+  const auto character = getUnsigned(*member, "character");
+  if (!line || !character) return llvm::None;
+
+  return Position{*line, *character};
+}
+
+llvm::Error makeInvalidParams(const std::string& message) {
+  return llvm::make_error<Error>(ErrorKind::InvalidConfiguration, message);
+}
+
+nlohmann::json toJson(const Position& position) {
+  // clang-format off
+  return {
+    {"line", position.line},
+    {"character", position.character}
+  };
+  // clang-format on
+}
+
+/// Converts a `file://` URI to an absolute path, undoing percent-encoding.
+llvm::Optional<std::string> uriToPath(llvm::StringRef uri) {
+  if (!uri.consume_front("file://")) return llvm::None;
+
+  std::string path;
+  for (std::size_t index = 0; index < uri.size(); ++index) {
+    if (uri[index] == '%' && index + 2 < uri.size()) {
+      const auto high = llvm::hexDigitValue(uri[index + 1]);
+      const auto low = llvm::hexDigitValue(uri[index + 2]);
+      if (high != -1U && low != -1U) {
+        path += static_cast<char>(high * 16 + low);
+        index += 2;
+        continue;
+      }
+    }
+    path += uri[index];
+  }
+
+  // file:///C:/... on Windows.
+  if (path.size() > 2 && path[0] == '/' && path[2] == ':') path.erase(0, 1);
+
+  return Routines::makeAbsolute(path);
+}
+
+/// Converts an absolute path to a `file://` URI, percent-encoding everything
+/// but unreserved characters and separators.
+std::string pathToUri(llvm::StringRef path) {
+  std::string uri = "file://";
+  if (!path.startswith("/")) uri += '/';
+
+  for (const char character : path) {
+    if (std::isalnum(static_cast<unsigned char>(character)) ||
+        llvm::StringRef("-._~/").find(character) != llvm::StringRef::npos) {
+      uri += character;
+    } else {
+      uri += '%';
+      uri += llvm::hexdigit(static_cast<unsigned char>(character) >> 4);
+      uri += llvm::hexdigit(static_cast<unsigned char>(character) & 0xF);
+    }
+  }
+
+  return uri;
+}
+
+/// Returns the path of the `textDocument` of the parameters.
+llvm::Expected<std::string> getDocumentPath(const nlohmann::json& params) {
+  const auto* document = getMember(params, "textDocument");
+  const auto uri = document ? getString(*document, "uri") : llvm::None;
+  const auto path = uri ? uriToPath(*uri) : llvm::None;
+  if (!path) return makeInvalidParams("Expected a textDocument with file URI");
+  return *path;
+}
+
+/// Returns a protocol `Location` for the clang `Location`.
+nlohmann::json toJson(const Location& location, const Document& document) {
+  const auto position = toJson(document.getPosition(location.offset));
+  // clang-format off
+  return {
+    {"uri", pathToUri(location.filename)},
+    {"range", {{"start", position}, {"end", position}}}
+  };
+  // clang-format on
+}
+}  // namespace
+
+int LanguageServer::run(std::FILE* input, std::FILE* output) {
+  _output = output;
+
+  while (!_hasExited) {
+    const auto content = readMessage(input);
+    if (!content) break;
+
+    // Without exceptions, malformed JSON aborts the parser. Editors do not
+    // send any, and restart servers that die.
+    _handle(nlohmann::json::parse(*content));
+  }
+
+  return _isShutDown ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void LanguageServer::_handle(const nlohmann::json& message) {
+  static const nlohmann::json noParams = nlohmann::json::object();
+
+  const auto method = getString(message, "method");
+  const auto* id = getMember(message, "id");
+  const auto* params = getMember(message, "params");
+  if (params == nullptr) params = &noParams;
+
+  // We send no requests, so there are no responses to handle.
+  if (!method) return;
+
+  if (id == nullptr) {
+    _apply(*method, *params);
+    return;
+  }
+
+  nlohmann::json response = {{"jsonrpc", "2.0"}, {"id", *id}};
+
+  if (!isSupported(*method)) {
+    response["error"] = {{"code", ErrorCode::methodNotFound},
+                         {"message", "Unsupported method " + *method}};
+    writeMessage(_output, response);
+    return;
+  }
+
+  // Searches that fail simply find nothing (the error is logged), so errors
+  // that reach the client are about the parameters.
+  auto result = _answer(*method, *params);
+  if (result) {
+    response["result"] = std::move(*result);
+  } else {
+    llvm::handleAllErrors(result.takeError(), [&response](const Error& error) {
+      response["error"] = {{"code", ErrorCode::invalidParams},
+                           {"message", error.getMessage()}};
+    });
+  }
+
+  writeMessage(_output, response);
+}
+
+llvm::Expected<nlohmann::json>
+LanguageServer::_answer(const std::string& method,
+                        const nlohmann::json& params) {
+  if (method == "initialize") return _initialize(params);
+  if (method == "textDocument/codeAction") return _codeAction(params);
+  if (method == "textDocument/definition") return _definition(params);
+
+  assert(method == "shutdown" && "Unhandled supported method");
+  _isShutDown = true;
+  return nullptr;
+}
+
+void LanguageServer::_apply(const std::string& method,
+                            const nlohmann::json& params) {
+  if (method == "exit") {
+    _hasExited = true;
+    return;
+  }
+
+  // Other notifications (initialized, $/cancelRequest, ...) need no action.
+  if (method.compare(0, 13, "textDocument/") != 0) return;
+
+  auto path = getDocumentPath(params);
+  if (!path) {
+    llvm::logAllUnhandledErrors(path.takeError(), llvm::errs(), method + ": ");
+    return;
+  }
+
+  if (method == "textDocument/didOpen") {
+    const auto text = getString(*getMember(params, "textDocument"), "text");
+    _documents[*path] = Document(text ? *text : std::string());
+
+    auto session = _getSession(*path);
+    if (session) {
+      session->retain(*path);
+    } else {
+      llvm::consumeError(session.takeError());
+    }
+  } else if (method == "textDocument/didClose") {
+    _documents.erase(*path);
+    if (_session) _session->release(*path);
+  } else if (method == "textDocument/didChange") {
+    auto iterator = _documents.find(*path);
+    if (iterator == _documents.end()) return;
+
+    auto& document = iterator->getValue();
+    const auto* changes = getMember(params, "contentChanges");
+    if (changes == nullptr || !changes->is_array()) return;
+
+    // Changes apply one after the other, each to the result of the last.
+    for (const auto& change : *changes) {
+      const auto text = getString(change, "text");
+      if (!text) continue;
+
+      const auto* range = getMember(change, "range");
+      if (range == nullptr) {
+        document.setText(*text);
+        continue;
+      }
+
+      const auto begin = getPosition(*range, "start");
+      const auto end = getPosition(*range, "end");
+      if (begin && end) document.replace(*begin, *end, *text);
+    }
+  }
+}
+
+nlohmann::json LanguageServer::_initialize(const nlohmann::json& params) {
+  llvm::SmallVector<std::string, 3> directories;
+
+  const auto* initializationOptions =
+      getMember(params, "initializationOptions");
+  if (initializationOptions != nullptr) {
+    const auto path =
+        getString(*initializationOptions, "compilationDatabasePath");
+    if (path) directories.emplace_back(Routines::makeAbsolute(*path));
+
+    const auto timeout = getUnsigned(*initializationOptions, "timeoutMs");
+    if (timeout) _timeout = std::chrono::milliseconds(*timeout);
+  }
+
+  llvm::Optional<std::string> root;
+  if (const auto rootUri = getString(params, "rootUri")) {
+    root = uriToPath(*rootUri);
+  } else if (const auto rootPath = getString(params, "rootPath")) {
+    root = Routines::makeAbsolute(*rootPath);
+  }
+  if (root) {
+    directories.emplace_back(*root);
+    directories.emplace_back(*root + "/build");
+  }
+
+  for (const auto& directory : directories) {
+    auto session = Session::Load(directory, {});
+    if (session) {
+      _session = std::move(*session);
+      break;
+    }
+    llvm::consumeError(session.takeError());
+  }
+
+  // clang-format off
+  return {
+    {"capabilities", {
+      {"textDocumentSync", {{"openClose", true}, {"change", 2}}},
+      {"codeActionProvider", true},
+      {"definitionProvider", true}
+    }},
+    {"serverInfo", {{"name", "clang-expand"}}}
+  };
+  // clang-format on
+}
+
+llvm::Expected<nlohmann::json>
+LanguageServer::_codeAction(const nlohmann::json& params) {
+  auto path = getDocumentPath(params);
+  if (!path) return path.takeError();
+
+  const auto* range = getMember(params, "range");
+  const auto position = range ? getPosition(*range, "start") : llvm::None;
+  if (!position) return makeInvalidParams("Expected a range");
+
+  auto actions = nlohmann::json::array();
+
+  // clang-format off
+  Options options = {
+    /*wantsCall=*/true,
+    /*wantsDeclaration=*/true,
+    /*wantsDefinition=*/false,
+    /*wantsRewritten=*/true
+  };
+  // clang-format on
+
+  auto result = _search(*path, *position, std::move(options));
+  if (!result) {
+    llvm::logAllUnhandledErrors(result.takeError(), llvm::errs(), "");
+    return actions;
+  }
+  if (!result->callRange || !result->declaration || !result->definition) {
+    return actions;
+  }
+
+  // The end of the call range is inclusive (it is the semicolon), but the
+  // protocol wants the exclusive end, i.e. the column after it. That column is
+  // 1-based like any other, and converted by `getPosition()`.
+  const auto document = _getDocument(*path);
+  const auto begin = document.getPosition(result->callRange->begin);
+  auto end = result->callRange->end;
+  end.column += 1;
+
+  auto edit = nlohmann::json::object();
+  edit["range"] = {{"start", toJson(begin)},
+                   {"end", toJson(document.getPosition(end))}};
+  edit["newText"] = result->definition->rewritten;
+
+  auto changes = nlohmann::json::object();
+  changes[pathToUri(*path)] = nlohmann::json::array({edit});
+
+  // clang-format off
+  actions.push_back({
+    {"title", "Expand " + result->declaration->name.str()},
+    {"kind", "refactor.inline"},
+    {"edit", {{"changes", changes}}}
+  });
+  // clang-format on
+
+  return actions;
+}
+
+llvm::Expected<nlohmann::json>
+LanguageServer::_definition(const nlohmann::json& params) {
+  auto path = getDocumentPath(params);
+  if (!path) return path.takeError();
+
+  const auto position = getPosition(params, "position");
+  if (!position) return makeInvalidParams("Expected a position");
+
+  // clang-format off
+  Options options = {
+    /*wantsCall=*/false,
+    /*wantsDeclaration=*/false,
+    /*wantsDefinition=*/true,
+    /*wantsRewritten=*/false
+  };
+  // clang-format on
+
+  auto result = _search(*path, *position, std::move(options));
+  if (!result) {
+    llvm::logAllUnhandledErrors(result.takeError(), llvm::errs(), "");
+    return nullptr;
+  }
+  if (!result->definition) return nullptr;
+
+  const auto& location = result->definition->location;
+  return toJson(location, _getDocument(location.filename.str()));
+}
+
+llvm::Expected<Result> LanguageServer::_search(const std::string& file,
+                                               const Position& position,
+                                               Options options) {
+  auto session = _getSession(file);
+  if (!session) return session.takeError();
+
+  // Without a list of sources to search, every source of the database is a
+  // candidate, of which only those that can see the declaration are useful.
+  options.searchAllSources = true;
+  options.pruneByIncludes = true;
+  options.timeout = _timeout;
+  for (const auto& document : _documents) {
+    options.unsavedFiles[document.getKey()] = document.getValue().getText();
+  }
+
+  const auto offset = _getDocument(file).getOffset(position);
+  return session->run(file, offset.line, offset.column, std::move(options));
+}
+
+Document LanguageServer::_getDocument(const std::string& file) const {
+  const auto iterator = _documents.find(file);
+  if (iterator != _documents.end()) return iterator->getValue();
+
+  auto buffer = llvm::MemoryBuffer::getFile(file);
+  if (!buffer) return Document();
+
+  return Document((*buffer)->getBuffer().str());
+}
+
+llvm::Expected<Session&> LanguageServer::_getSession(const std::string& file) {
+  if (_session) return *_session;
+
+  std::string message;
+  auto compilationDatabase =
+      clang::tooling::CompilationDatabase::autoDetectFromSource(file, message);
+  if (!compilationDatabase) {
+    return llvm::make_error<Error>(
+        ErrorKind::InvalidConfiguration,
+        "Could not find a compilation database for " + file + ": " + message);
+  }
+
+  _session = std::make_unique<Session>(std::move(compilationDatabase),
+                                       Session::SourceVector());
+  return *_session;
+}
+
+}  // namespace LSP
+}  // namespace ClangExpand
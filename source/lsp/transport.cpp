@@ -0,0 +1,94 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/lsp/transport.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+namespace ClangExpand {
+namespace LSP {
+namespace {
+/// Reads one header line, without its line terminator.
+/// \returns False at the end of the input.
+bool readLine(std::FILE* input, std::string& line) {
+  line.clear();
+
+  int character;
+  while ((character = std::fgetc(input)) != EOF && character != '\n') {
+    line += static_cast<char>(character);
+  }
+  if (character == EOF) return false;
+
+  if (!line.empty() && line.back() == '\r') line.pop_back();
+  return true;
+}
+}  // namespace
+
+llvm::Optional<std::string> readMessage(std::FILE* input) {
+  llvm::Optional<std::size_t> length;
+
+  // Headers end with an empty line. Content-Length is the only one we need.
+  std::string line;
+  while (true) {
+    if (!readLine(input, line)) return llvm::None;
+    if (line.empty()) break;
+
+    llvm::StringRef header(line);
+    std::size_t value;
+    if (header.consume_front("Content-Length:") &&
+        !header.trim().getAsInteger(10, value)) {
+      length = value;
+    }
+  }
+
+  if (!length) return llvm::None;
+
+  std::string content(*length, '\0');
+  if (*length > 0 && std::fread(&content[0], 1, *length, input) != *length) {
+    return llvm::None;
+  }
+
+  return content;
+}
+
+void writeMessage(std::FILE* output, const nlohmann::json& message) {
+  const auto content = message.dump();
+  std::fprintf(output, "Content-Length: %zu\r\n\r\n", content.size());
+  std::fwrite(content.data(), 1, content.size(), output);
+  std::fflush(output);
+}
+
+}  // namespace LSP
+}  // namespace ClangExpand
@@ -0,0 +1,225 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/merge.hpp"
+#include "clang-expand/error.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/ADT/None.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <cstddef>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace ClangExpand {
+namespace {
+// Results are read back from files, and accessing JSON the wrong way aborts
+// (we build without exceptions). All access goes through these.
+
+/// Returns the member of the object, or null if there is no such member (or
+/// the value is not an object).
+const nlohmann::json* getMember(const nlohmann::json& object, const char* key) {
+  if (!object.is_object()) return nullptr;
+  const auto iterator = object.find(key);
+  return iterator == object.end() ? nullptr : &*iterator;
+}
+
+llvm::Optional<unsigned> getUnsigned(const nlohmann::json& object,
+                                     const char* key) {
+  const auto* member = getMember(object, key);
+  if (member == nullptr || !member->is_number_integer()) return llvm::None;
+  const auto value = member->get<long long>();
+  if (value < 0) return llvm::None;
+  return static_cast<unsigned>(value);
+}
+
+/// Checks whether two results have the same member (or both lack it).
+bool agree(const nlohmann::json& first,
+           const nlohmann::json& second,
+           const char* key) {
+  const auto* a = getMember(first, key);
+  const auto* b = getMember(second, key);
+  if (a == nullptr || b == nullptr) return a == b;
+  return *a == *b;
+}
+
+/// What definitions are ordered by when picking the winner: the file, then
+/// the line and column, or the byte offset and zero.
+using DefinitionKey = std::tuple<std::string, unsigned, unsigned>;
+
+llvm::Optional<DefinitionKey> getKey(const nlohmann::json& definition) {
+  const auto* location = getMember(definition, "location");
+  if (location == nullptr) return llvm::None;
+
+  const auto* filename = getMember(*location, "filename");
+  const auto* offset = getMember(*location, "offset");
+  if (filename == nullptr || !filename->is_string() || offset == nullptr) {
+    return llvm::None;
+  }
+
+  // Searches reporting byte offsets have a number where the line and column
+  // would be.
+  if (offset->is_number_integer()) {
+    const auto byte = offset->get<long long>();
+    if (byte < 0) return llvm::None;
+    return std::make_tuple(filename->get<std::string>(),
+                           static_cast<unsigned>(byte),
+                           0u);
+  }
+
+  const auto line = getUnsigned(*offset, "line");
+  const auto column = getUnsigned(*offset, "column");
+  if (!line || !column) return llvm::None;
+
+  return std::make_tuple(filename->get<std::string>(), *line, *column);
+}
+
+llvm::Error makeInconsistent(const std::string& message) {
+  return llvm::make_error<Error>(ErrorKind::InconsistentShards, message);
+}
+}  // namespace
+
+llvm::Expected<nlohmann::json>
+mergeShards(const std::vector<nlohmann::json>& shards) {
+  if (shards.empty()) {
+    return llvm::make_error<Error>(ErrorKind::InvalidConfiguration,
+                                   "No shards to merge");
+  }
+
+  const auto& first = shards.front();
+  const auto* firstShard = getMember(first, "shard");
+  const auto count =
+      firstShard ? getUnsigned(*firstShard, "count") : llvm::None;
+  if (!count || *count == 0) {
+    return llvm::make_error<Error>(ErrorKind::InvalidConfiguration,
+                                   "Not the result of a sharded search");
+  }
+
+  std::vector<bool> seen(*count, false);
+  const nlohmann::json* winner = nullptr;
+  DefinitionKey winnerKey;
+
+  // With -all-definitions, every shard lists the definitions it found. Headers
+  // are seen by several shards, so the same definition may come from many.
+  std::map<DefinitionKey, const nlohmann::json*> allDefinitions;
+
+  // A shard that ran out of time may have missed the definition that would
+  // have won, so the merged result is only as complete as its shards.
+  bool isPartial = false;
+
+  for (const auto& result : shards) {
+    const auto* shard = getMember(result, "shard");
+    const auto index = shard ? getUnsigned(*shard, "index") : llvm::None;
+    if (!index || getUnsigned(*shard, "count") != count) {
+      return makeInconsistent("Results are not from the same sharded search");
+    }
+
+    const auto name = std::to_string(*index) + "/" + std::to_string(*count);
+    if (*index >= *count || seen[*index]) {
+      return makeInconsistent("Shard " + name + " is invalid or repeated");
+    }
+    seen[*index] = true;
+
+    if (!agree(result, first, "declaration")) {
+      return makeInconsistent("Shard " + name +
+                              " found a different declaration");
+    }
+    if (!agree(result, first, "call")) {
+      return makeInconsistent("Shard " + name + " found a different call");
+    }
+
+    const auto* partial = getMember(result, "partial");
+    if (partial != nullptr && partial->is_boolean() && partial->get<bool>()) {
+      isPartial = true;
+    }
+
+    if (const auto* definitions = getMember(result, "definitions")) {
+      if (!definitions->is_array()) {
+        return makeInconsistent("Shard " + name +
+                                " has malformed definitions");
+      }
+      for (const auto& other : *definitions) {
+        const auto key = getKey(other);
+        if (!key) {
+          return makeInconsistent("Shard " + name +
+                                  " has a malformed definition");
+        }
+        allDefinitions.emplace(*key, &other);
+      }
+    }
+
+    const auto* definition = getMember(result, "definition");
+    if (definition == nullptr) continue;
+
+    const auto key = getKey(*definition);
+    if (!key) {
+      return makeInconsistent("Shard " + name + " has a malformed definition");
+    }
+    if (winner == nullptr || *key < winnerKey) {
+      winner = definition;
+      winnerKey = *key;
+    }
+  }
+
+  for (std::size_t index = 0; index < seen.size(); ++index) {
+    if (!seen[index]) {
+      return makeInconsistent("Shard " + std::to_string(index) + "/" +
+                              std::to_string(*count) + " is missing");
+    }
+  }
+
+  if (winner == nullptr) {
+    return llvm::make_error<Error>(ErrorKind::DefinitionNotFound,
+                                   "Could not find definition in any shard");
+  }
+
+  // The shards agree on everything else, so the first one speaks for all.
+  auto merged = first;
+  merged.erase("shard");
+  merged.erase("cache");
+  merged.erase("partial");
+  merged["definition"] = *winner;
+  if (isPartial) merged["partial"] = true;
+
+  if (!allDefinitions.empty()) {
+    auto definitions = nlohmann::json::array();
+    for (const auto& entry : allDefinitions) {
+      definitions.push_back(*entry.second);
+    }
+    merged["definitions"] = std::move(definitions);
+  }
+
+  return merged;
+}
+
+}  // namespace ClangExpand
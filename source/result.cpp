@@ -40,18 +40,28 @@
 #include <utility>
 
 namespace ClangExpand {
-Result::Result(Query&& query) {
+Result::Result(Query&& query) : strings(query.strings) {
   if (query.options.wantsCall) {
-    assert(query.call.hasValue() &&
+    assert((query.call.hasValue() || query.hasTimedOut()) &&
            "User wants call information, but have no call data.");
-    callRange = query.call->extent;
+    if (query.call) callRange = query.call->extent;
   }
-  if (query.options.wantsDeclaration) {
+  // Shards are checked against each other by their declarations.
+  if (query.options.wantsDeclaration || query.options.shardCount > 1) {
     declaration = std::move(query.declaration);
   }
   if (query.requiresDefinition()) {
+    if (query.options.wantsAllDefinitions && query.definition) {
+      definitions.emplace_back(*query.definition);
+      for (auto& other : query.otherDefinitions) {
+        definitions.emplace_back(std::move(other));
+      }
+    }
     definition = std::move(query.definition);
   }
+  if (query.options.shardCount > 1) {
+    shard = std::make_pair(query.options.shardIndex, query.options.shardCount);
+  }
 }
 
 nlohmann::json Result::toJson() const {
@@ -69,6 +79,24 @@ nlohmann::json Result::toJson() const {
     json["definition"] = definition->toJson();
   }
 
+  if (!definitions.empty()) {
+    auto array = nlohmann::json::array();
+    for (const auto& other : definitions) array.push_back(other.toJson());
+    json["definitions"] = std::move(array);
+  }
+
+  if (isPartial) {
+    json["partial"] = true;
+  }
+
+  if (shard.hasValue()) {
+    json["shard"] = {{"index", shard->first}, {"count", shard->second}};
+  }
+
+  if (cacheStatistics.hasValue()) {
+    json["cache"] = cacheStatistics->toJson();
+  }
+
   return json.is_null() ? "" : json;
 }
 
@@ -24,73 +24,525 @@
 
 // Project includes
 #include "clang-expand/search.hpp"
+#include "clang-expand/caller-search/expander.hpp"
+#include "clang-expand/caller-search/scanner.hpp"
+#include "clang-expand/common/declaration-data.hpp"
 #include "clang-expand/common/query.hpp"
 #include "clang-expand/common/routines.hpp"
+#include "clang-expand/common/translation-unit.hpp"
+#include "clang-expand/definition-search/ast-files.hpp"
+#include "clang-expand/definition-search/candidates.hpp"
+#include "clang-expand/definition-search/clangd-index.hpp"
+#include "clang-expand/definition-search/external-definition-map.hpp"
+#include "clang-expand/definition-search/include-graph.hpp"
+#include "clang-expand/definition-search/prefix-header.hpp"
+#include "clang-expand/definition-search/speculation.hpp"
 #include "clang-expand/definition-search/tool-factory.hpp"
+#include "clang-expand/error.hpp"
+#include "clang-expand/options.hpp"
 #include "clang-expand/result.hpp"
+#include "clang-expand/symbol-search/action.hpp"
 #include "clang-expand/symbol-search/tool-factory.hpp"
 
 // Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Frontend/PCHContainerOperations.h>
 #include <clang/Tooling/Tooling.h>
 
 // LLVM includes
 #include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
 #include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
 
 // Standard includes
-#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <memory>
 #include <string>
 #include <type_traits>
+#include <utility>
 
 namespace ClangExpand {
 Search::Search(const std::string& file, unsigned line, unsigned column)
-: _location(Routines::makeAbsolute(file), line, column) {
+: Search(file, line, column, new CachingFileSystem()) {
 }
 
-Result Search::run(clang::tooling::CompilationDatabase& compilationDatabase,
-                   const SourceVector& sources,
-                   const Options& options) {
-  Query query(options);
+Search::Search(const std::string& file,
+               unsigned line,
+               unsigned column,
+               llvm::IntrusiveRefCntPtr<CachingFileSystem> fileSystem)
+: _strings(std::make_shared<StringPool>())
+, _location(Routines::makeAbsolute(file), line, column, *_strings)
+, _cachingFileSystem(std::move(fileSystem))
+, _fileSystem(_cachingFileSystem) {
+}
+
+llvm::Expected<Result>
+Search::run(clang::tooling::CompilationDatabase& compilationDatabase,
+            const SourceVector& sources,
+            const Options& options) {
+  Query query(options, _strings);
+
+  if (options.unsavedFiles.empty()) {
+    _fileSystem = _cachingFileSystem;
+  } else {
+    _fileSystem = _overlayUnsavedFiles(options.unsavedFiles);
+  }
 
-  _symbolSearch(compilationDatabase, query);
+  // The speculation must not outlive the file system it parses with, which
+  // the next search may replace.
+  std::unique_ptr<DefinitionSearch::Speculation> speculation;
+  if (options.speculate && query.requiresDefinition()) {
+    namespace Candidates = DefinitionSearch::Candidates;
+    auto candidates = Candidates::collect(compilationDatabase,
+                                          sources,
+                                          options.searchAllSources);
+    Candidates::keepShard(candidates, options.shardIndex, options.shardCount);
+    speculation = std::make_unique<DefinitionSearch::Speculation>(
+        compilationDatabase,
+        std::move(candidates),
+        _location.filename.str(),
+        _fileSystem,
+        options);
+  }
+
+  if (auto error =
+          _symbolSearch(compilationDatabase, query, speculation.get())) {
+    return std::move(error);
+  }
+
+  if (query.hasTimedOut()) return _partial(std::move(query));
+  if (query.isCancelled()) return _cancelled();
 
   if (query.foundNothing()) {
-    Routines::error("Could not recognize token at specified location");
+    return llvm::make_error<Error>(
+        ErrorKind::UnknownSymbol,
+        "Could not recognize token at specified location");
   }
 
   if (query.requiresDefinition()) {
-    if (!query.definition) {
-      _definitionSearch(compilationDatabase, sources, query);
+    // A macro has exactly one definition, and no declaration to match others
+    // against.
+    const bool wantsMore =
+        options.wantsAllDefinitions && query.declaration && !query.error;
+    unsigned failures = 0;
+    if (!query.definition || wantsMore) {
+      failures = _definitionSearch(compilationDatabase,
+                                   sources,
+                                   query,
+                                   speculation.get());
+    }
+
+    if (query.error) return llvm::make_error<Error>(*query.error);
+    // Without all definitions, the first one is the complete result.
+    if ((!query.definition || options.wantsAllDefinitions) &&
+        query.hasTimedOut()) {
+      return _partial(std::move(query));
+    }
+    if (!query.definition && query.isCancelled()) return _cancelled();
+
+    // Another shard may well have the definition.
+    if (!query.definition && options.shardCount <= 1) {
+      std::string message = "Could not find definition";
+      if (failures > 0) {
+        message += " (" + std::to_string(failures) +
+                   " candidate source(s) failed to compile)";
+      }
+      return llvm::make_error<Error>(ErrorKind::DefinitionNotFound, message);
+    }
+  }
+
+  Result result(std::move(query));
+  if (options.wantsStatistics) {
+    result.cacheStatistics = _cachingFileSystem->getStatistics();
+  }
+
+  return result;
+}
+
+llvm::Expected<unsigned>
+Search::findCallers(CompilationDatabase& compilationDatabase,
+                    const SourceVector& sources,
+                    const Options& options,
+                    CallFunction onCall) {
+  auto symbolOptions = options;
+  symbolOptions.wantsDeclaration = true;
+  symbolOptions.wantsDefinition = false;
+  symbolOptions.wantsRewritten = false;
+  Query query(symbolOptions, _strings);
+
+  if (options.unsavedFiles.empty()) {
+    _fileSystem = _cachingFileSystem;
+  } else {
+    _fileSystem = _overlayUnsavedFiles(options.unsavedFiles);
+  }
+
+  if (auto error = _symbolSearch(compilationDatabase, query, nullptr)) {
+    return std::move(error);
+  }
+
+  if (query.isCancelled()) return _cancelled();
+
+  // Macros have no declaration, and calls to functions without a USR cannot be
+  // told apart from calls to their namesakes.
+  if (!query.declaration || query.declaration->usr.empty()) {
+    return llvm::make_error<Error>(
+        ErrorKind::UnknownSymbol,
+        "Could not recognize function at specified location");
+  }
+
+  const auto candidates =
+      _collectCallerCandidates(compilationDatabase,
+                               sources,
+                               options,
+                               query.declaration->location);
+
+  CallerSearch::Scanner scanner(compilationDatabase, _fileSystem, query);
+  const auto count = scanner.scan(candidates, onCall);
+
+  if (query.isCancelled() && !query.hasTimedOut()) return _cancelled();
+
+  return count;
+}
+
+llvm::Expected<CallerSearch::Expansions>
+Search::expandCallers(CompilationDatabase& compilationDatabase,
+                      const SourceVector& sources,
+                      const Options& options) {
+  auto definitionOptions = options;
+  definitionOptions.wantsCall = false;
+  definitionOptions.wantsDeclaration = true;
+  definitionOptions.wantsDefinition = true;
+  definitionOptions.wantsRewritten = false;
+  definitionOptions.wantsAllDefinitions = false;
+  definitionOptions.shardIndex = 0;
+  definitionOptions.shardCount = 1;
+
+  auto result = run(compilationDatabase, sources, definitionOptions);
+  if (!result) return result.takeError();
+  if (result->isPartial) return _cancelled();
+
+  // Macros have a definition, but no declaration to find their calls with.
+  if (!result->declaration || result->declaration->usr.empty()) {
+    return llvm::make_error<Error>(
+        ErrorKind::UnknownSymbol,
+        "Could not recognize function at specified location");
+  }
+
+  // The query of the whole search, whose declaration the calls are matched
+  // against. The deadline starts over, but the definition is usually found
+  // quickly compared to scanning every source.
+  Query query(options, _strings);
+  query.declaration = std::move(result->declaration);
+
+  // Translation units that do not define the function themselves rewrite the
+  // definition from the one that does, which is parsed only once.
+  std::unique_ptr<clang::ASTUnit> definitionUnit;
+  const auto& definitionFile = result->definition->location.filename;
+  const auto commands = compilationDatabase.getCompileCommands(definitionFile);
+  if (!commands.empty()) {
+    definitionUnit = TranslationUnit::parse(commands.front(), _fileSystem);
+  }
+
+  const auto candidates =
+      _collectCallerCandidates(compilationDatabase,
+                               sources,
+                               options,
+                               query.declaration->location);
+
+  CallerSearch::Scanner scanner(compilationDatabase, _fileSystem, query);
+  CallerSearch::Expander expander(query, scanner, std::move(definitionUnit));
+  scanner.parseEach(candidates, [&expander](clang::ASTContext& context) {
+    expander.expandCalls(context);
+  });
+
+  if (query.hasTimedOut()) {
+    return llvm::make_error<Error>(ErrorKind::Cancelled,
+                                   "Search timed out before every source was "
+                                   "scanned for calls");
+  }
+  if (query.isCancelled()) return _cancelled();
+
+  return expander.takeExpansions(_location.filename.str());
+}
+
+void Search::retainTranslationUnit(
+    std::unique_ptr<clang::ASTUnit>& unit) noexcept {
+  _retainedUnit = &unit;
+}
+
+llvm::Error Search::_symbolSearch(CompilationDatabase& compilationDatabase,
+                                  Query& query,
+                                  DefinitionSearch::Speculation* speculation) {
+  SymbolSearch::ToolFactory::SpellingCallback onSpelling;
+  if (speculation != nullptr) {
+    onSpelling = [speculation](llvm::StringRef spelling) {
+      speculation->start(spelling);
+    };
+  }
+
+  if (_retainedUnit != nullptr &&
+      _searchRetainedUnit(compilationDatabase, query, onSpelling)) {
+    if (query.error) return llvm::make_error<Error>(*query.error);
+    return llvm::Error::success();
+  }
+
+  clang::tooling::ClangTool tool(
+      compilationDatabase,
+      {_location.filename.str()},
+      std::make_shared<clang::PCHContainerOperations>(),
+      _fileSystem);
+
+  SymbolSearch::ToolFactory factory(_location, query, std::move(onSpelling));
+  const auto status = tool.run(&factory);
+
+  // Errors we detect ourselves are more specific than the tool's status, which
+  // also reports the parse we stopped when the query was cancelled.
+  if (query.error) return llvm::make_error<Error>(*query.error);
+
+  if (status != 0 && !query.isCancelled()) {
+    return llvm::make_error<Error>(ErrorKind::ToolFailure,
+                                   "Could not process " +
+                                       _location.filename.str());
+  }
+
+  return llvm::Error::success();
+}
+
+bool Search::_searchRetainedUnit(
+    CompilationDatabase& compilationDatabase,
+    Query& query,
+    const std::function<void(llvm::StringRef)>& onSpelling) {
+  auto& unit = *_retainedUnit;
+
+  // Reparsing reuses the precompiled preamble, unless the includes at the top
+  // of the file (or the files they include) changed. The unit is reset when
+  // reparsing fails.
+  if (unit && unit->Reparse(std::make_shared<clang::PCHContainerOperations>(),
+                            llvm::None,
+                            _fileSystem)) {
+    unit.reset();
+  }
+
+  if (!unit) {
+    const auto commands =
+        compilationDatabase.getCompileCommands(_location.filename);
+    if (commands.empty()) return false;
+    unit = TranslationUnit::parse(commands.front(),
+                                  _fileSystem,
+                                  /*precompilesPreamble=*/true);
+    if (!unit) return false;
+  }
+
+  return SymbolSearch::searchUnit(*unit, _location, query, onSpelling);
+}
+
+unsigned
+Search::_definitionSearch(CompilationDatabase& compilationDatabase,
+                          const SourceVector& sources,
+                          Query& query,
+                          DefinitionSearch::Speculation* speculation) {
+  namespace Candidates = DefinitionSearch::Candidates;
+  const auto& options = query.options;
+  const auto& declaration = query.declaration->location;
+
+  // An external definition map or a clangd index tells us exactly where to
+  // look. If neither knows about the function (or is wrong about it), we scan
+  // as usual. Both only know about one definition.
+  if (!options.wantsAllDefinitions &&
+      _searchIndexedDefinition(compilationDatabase, query)) {
+    return 0;
+  }
+
+  auto candidates = Candidates::collect(compilationDatabase,
+                                        sources,
+                                        options.searchAllSources);
+  Candidates::keepShard(candidates, options.shardIndex, options.shardCount);
+  Candidates::orderByLocality(candidates, declaration);
+
+  DefinitionSearch::IncludeGraph includeGraph(options.includeGraphCache,
+                                              _fileSystem);
+  if (options.pruneByIncludes) {
+    Candidates::pruneByIncludes(candidates,
+                                compilationDatabase,
+                                declaration,
+                                includeGraph);
+  }
+
+  DefinitionSearch::PrefixHeader prefixHeader(options.prefixHeaderCache,
+                                              _fileSystem);
+  const bool usePrefixHeader =
+      !options.prefixHeaderCache.empty() &&
+      prefixHeader.prepare(compilationDatabase, candidates, includeGraph);
+
+  DefinitionSearch::ToolFactory factory(_location.filename, query);
+  auto runTool = [&](const std::string& source, bool withPrefixHeader) {
+    clang::tooling::ClangTool tool(
+        compilationDatabase,
+        {source},
+        std::make_shared<clang::PCHContainerOperations>(),
+        _fileSystem);
+    if (withPrefixHeader) {
+      tool.appendArgumentsAdjuster(prefixHeader.getArgumentsAdjuster());
+    }
+    return tool.run(&factory);
+  };
+
+  // Sources are ordered by locality, so we run one tool per source and stop at
+  // the first definition (unless all of them are wanted). Sources that fail to
+  // compile are skipped (clang has already reported the diagnostics), since
+  // they may well be unrelated to the function we are looking for, but they
+  // are counted, so that not finding the definition can be explained. Sources
+  // parsed speculatively during symbol search are not parsed again, and
+  // neither are those for which the build left an up-to-date serialized AST
+  // behind.
+  unsigned failures = 0;
+  for (const auto& source : candidates) {
+    if (query.isCancelled()) break;
+
+    if (speculation != nullptr && speculation->search(source, query)) {
+      if (query.hasEnoughDefinitions()) break;
+      continue;
     }
 
-    if (!query.definition) {
-      Routines::error("Could not find definition");
+    if (options.useASTFiles &&
+        _searchASTFile(compilationDatabase, source, includeGraph, query)) {
+      if (query.hasEnoughDefinitions()) break;
+      continue;
     }
+
+    auto status = runTool(source, usePrefixHeader);
+
+    // The precompiled header may fail to load for this source (e.g. when it
+    // was built with flags that matter to it), so it gets one more try without.
+    if (status != 0 && usePrefixHeader && !query.hasEnoughDefinitions() &&
+        !query.isCancelled()) {
+      status = runTool(source, false);
+    }
+
+    if (status != 0) ++failures;
+    if (query.hasEnoughDefinitions()) break;
   }
 
-  return Result(std::move(query));
+  includeGraph.save();
+
+  return failures;
 }
 
-void Search::_symbolSearch(CompilationDatabase& compilationDatabase,
-                           Query& query) {
-  clang::tooling::ClangTool SymbolSearch(compilationDatabase,
-                                         {_location.filename});
+Search::SourceVector
+Search::_collectCallerCandidates(CompilationDatabase& compilationDatabase,
+                                 const SourceVector& sources,
+                                 const Options& options,
+                                 const Location& declaration) {
+  namespace Candidates = DefinitionSearch::Candidates;
+  auto candidates = Candidates::collect(compilationDatabase,
+                                        sources,
+                                        /*allSources=*/true);
+  Candidates::keepShard(candidates, options.shardIndex, options.shardCount);
+
+  // Only sources including the declaration can call the function.
+  if (options.pruneByIncludes) {
+    DefinitionSearch::IncludeGraph includeGraph(options.includeGraphCache,
+                                                _fileSystem);
+    Candidates::pruneByIncludes(candidates,
+                                compilationDatabase,
+                                declaration,
+                                includeGraph);
+    includeGraph.save();
+  }
+
+  return candidates;
+}
 
-  const auto error = SymbolSearch.run(
-      new ClangExpand::SymbolSearch::ToolFactory(_location, query));
-  if (error) std::exit(error);
+llvm::Error Search::_cancelled() const {
+  return llvm::make_error<Error>(ErrorKind::Cancelled,
+                                 "Search was cancelled");
 }
 
-void Search::_definitionSearch(CompilationDatabase& compilationDatabase,
-                               const SourceVector& sources,
-                               Query& query) {
-  clang::tooling::ClangTool DefinitionSearch(compilationDatabase, sources);
+Result Search::_partial(Query&& query) const {
+  Result result(std::move(query));
+  result.isPartial = true;
+  return result;
+}
+
+Search::FileSystemPointer
+Search::_overlayUnsavedFiles(const llvm::StringMap<std::string>& files) {
+  // Unsaved files are newer than anything on disk, which makes sure that
+  // caches keyed by modification time (include graph, precompiled headers,
+  // AST files) do not mistake them for their saved versions.
+  const auto now = std::time(nullptr);
+
+  llvm::IntrusiveRefCntPtr<clang::vfs::InMemoryFileSystem> memory(
+      new clang::vfs::InMemoryFileSystem());
+  for (const auto& file : files) {
+    const auto path = Routines::makeAbsolute(file.getKey());
+    memory->addFile(path,
+                    now,
+                    llvm::MemoryBuffer::getMemBufferCopy(file.getValue(),
+                                                         path));
+  }
+
+  llvm::IntrusiveRefCntPtr<clang::vfs::OverlayFileSystem> overlay(
+      new clang::vfs::OverlayFileSystem(_cachingFileSystem));
+  overlay->pushOverlay(memory);
+
+  return overlay;
+}
+
+bool Search::_searchIndexedDefinition(
+    CompilationDatabase& compilationDatabase, Query& query) {
+  namespace ExternalDefinitionMap = DefinitionSearch::ExternalDefinitionMap;
+  namespace ClangdIndex = DefinitionSearch::ClangdIndex;
+  const auto& options = query.options;
+  const auto& usr = query.declaration->usr;
+
+  llvm::Optional<std::string> file;
+  if (!options.externalDefinitionMap.empty()) {
+    file = ExternalDefinitionMap::lookup(options.externalDefinitionMap, usr);
+  }
+  if (!file && !options.clangdIndex.empty()) {
+    file = ClangdIndex::lookup(options.clangdIndex, usr);
+  }
+  if (!file) return false;
+
+  if (llvm::sys::path::extension(*file) == ".ast") {
+    DefinitionSearch::ASTFiles::search(*file, _location.filename.str(), query);
+  } else {
+    clang::tooling::ClangTool tool(
+        compilationDatabase,
+        {*file},
+        std::make_shared<clang::PCHContainerOperations>(),
+        _fileSystem);
+    DefinitionSearch::ToolFactory factory(_location.filename, query);
+    tool.run(&factory);
+  }
+
+  return query.definition.hasValue() || query.error.hasValue();
+}
+
+bool Search::_searchASTFile(CompilationDatabase& compilationDatabase,
+                            const std::string& source,
+                            DefinitionSearch::IncludeGraph& includeGraph,
+                            Query& query) {
+  // The AST file was built from the saved version of the source.
+  if (query.options.unsavedFiles.count(source)) return false;
+
+  const auto commands = compilationDatabase.getCompileCommands(source);
+  if (commands.empty()) return false;
+
+  const auto astFile =
+      DefinitionSearch::ASTFiles::findUpToDate(commands.front(), includeGraph);
+  if (!astFile) return false;
 
-  const auto error = DefinitionSearch.run(
-      new ClangExpand::DefinitionSearch::ToolFactory(_location.filename,
-                                                     query));
-  if (error) std::exit(error);
+  return DefinitionSearch::ASTFiles::search(*astFile,
+                                            _location.filename.str(),
+                                            query);
 }
 
 }  // namespace ClangExpand
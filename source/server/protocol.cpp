@@ -0,0 +1,176 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/server/protocol.hpp"
+
+// System includes
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Standard includes
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Not every platform has it (the client ignores SIGPIPE instead).
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace ClangExpand {
+namespace Server {
+namespace {
+/// No sane field comes close to this size. Larger lengths indicate a corrupt
+/// stream, and we should not try to allocate them.
+constexpr std::uint32_t maximumFieldSize = 1u << 30;
+
+/// Writes all of `size` bytes, retrying on short writes and interrupts.
+bool writeAll(int socket, const char* data, std::size_t size) {
+  while (size > 0) {
+    const auto written = ::send(socket, data, size, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+/// Reads exactly `size` bytes, retrying on short reads and interrupts.
+bool readAll(int socket, char* data, std::size_t size) {
+  while (size > 0) {
+    const auto received = ::recv(socket, data, size, 0);
+    if (received < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (received == 0) return false;
+    data += received;
+    size -= static_cast<std::size_t>(received);
+  }
+  return true;
+}
+
+bool writeInteger(int socket, std::uint32_t value) {
+  return writeAll(socket, reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+bool readInteger(int socket, std::uint32_t& value) {
+  return readAll(socket, reinterpret_cast<char*>(&value), sizeof value);
+}
+
+bool writeString(int socket, const std::string& string) {
+  if (string.size() > maximumFieldSize) return false;
+  return writeInteger(socket, static_cast<std::uint32_t>(string.size())) &&
+         writeAll(socket, string.data(), string.size());
+}
+
+bool readString(int socket, std::string& string) {
+  std::uint32_t size;
+  if (!readInteger(socket, size) || size > maximumFieldSize) return false;
+  string.resize(size);
+  return size == 0 || readAll(socket, &string[0], size);
+}
+
+/// Creates the directory (only accessible to us) if it does not exist yet and
+/// checks that nobody else can get at it.
+bool ensurePrivateDirectory(const std::string& directory) {
+  if (::mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) return false;
+
+  struct stat status;
+  if (::lstat(directory.c_str(), &status) != 0) return false;
+  return S_ISDIR(status.st_mode) && status.st_uid == ::getuid() &&
+         (status.st_mode & 0077) == 0;
+}
+}  // namespace
+
+std::string getDefaultSocketPath() {
+  if (const char* socket = std::getenv("CLANG_EXPAND_SOCKET")) return socket;
+
+  if (const char* runtimeDirectory = std::getenv("XDG_RUNTIME_DIR")) {
+    return std::string(runtimeDirectory) + "/clang-expand.sock";
+  }
+
+  const auto directory = "/tmp/clang-expand-" + std::to_string(::getuid());
+  if (!ensurePrivateDirectory(directory)) return {};
+
+  return directory + "/clang-expand.sock";
+}
+
+bool sendRequest(int socket, const Request& request) {
+  if (!writeString(socket, request.workingDirectory)) return false;
+  if (!writeString(socket, request.input)) return false;
+
+  const auto count = static_cast<std::uint32_t>(request.arguments.size());
+  if (!writeInteger(socket, count)) return false;
+  for (const auto& argument : request.arguments) {
+    if (!writeString(socket, argument)) return false;
+  }
+
+  return true;
+}
+
+bool receiveRequest(int socket, Request& request) {
+  if (!readString(socket, request.workingDirectory)) return false;
+  if (!readString(socket, request.input)) return false;
+
+  std::uint32_t count;
+  if (!readInteger(socket, count) || count > maximumFieldSize) return false;
+
+  request.arguments.clear();
+  for (std::uint32_t index = 0; index < count; ++index) {
+    std::string argument;
+    if (!readString(socket, argument)) return false;
+    request.arguments.emplace_back(std::move(argument));
+  }
+
+  return true;
+}
+
+bool sendResponse(int socket, const Response& response) {
+  return writeInteger(socket, static_cast<std::uint32_t>(response.exitCode)) &&
+         writeString(socket, response.output) &&
+         writeString(socket, response.errors);
+}
+
+bool receiveResponse(int socket, Response& response) {
+  std::uint32_t exitCode;
+  if (!readInteger(socket, exitCode)) return false;
+  response.exitCode = static_cast<int>(exitCode);
+
+  return readString(socket, response.output) &&
+         readString(socket, response.errors);
+}
+
+}  // namespace Server
+}  // namespace ClangExpand
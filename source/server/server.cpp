@@ -0,0 +1,428 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/server/server.hpp"
+#include "clang-expand/server/protocol.hpp"
+
+// LLVM includes
+#include <llvm/Support/raw_ostream.h>
+
+// System includes
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Standard includes
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace ClangExpand {
+namespace Server {
+namespace {
+/// Fills in the address of the socket.
+/// \returns False if the path is too long for a socket address.
+bool makeAddress(const std::string& path, sockaddr_un& address) {
+  std::memset(&address, 0, sizeof address);
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof address.sun_path) return false;
+  std::strcpy(address.sun_path, path.c_str());
+  return true;
+}
+
+/// Checks whether a server accepts connections on the socket.
+bool isListening(const sockaddr_un& address) {
+  const int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (probe < 0) return false;
+
+  const auto* generic = reinterpret_cast<const sockaddr*>(&address);
+  const bool listening = ::connect(probe, generic, sizeof address) == 0;
+  ::close(probe);
+
+  return listening;
+}
+
+/// Takes the lock that serializes starting and stopping servers on the socket,
+/// held by a lock file next to it, waiting for other servers to release it.
+/// The lock is released by closing the returned descriptor.
+/// \returns The descriptor of the lock file, or -1 if it cannot be locked.
+int lockSocket(const std::string& socketPath) {
+  const auto lockPath = socketPath + ".lock";
+  const int lock = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (lock < 0) return -1;
+
+  while (::flock(lock, LOCK_EX) != 0) {
+    if (errno == EINTR) continue;
+    ::close(lock);
+    return -1;
+  }
+
+  return lock;
+}
+
+/// Checks whether the file at the path is the one described by the `status`,
+/// i.e. has not been replaced since.
+bool isSameFile(const std::string& path, const struct stat& status) {
+  struct stat current;
+  if (::stat(path.c_str(), &current) != 0) return false;
+  return current.st_dev == status.st_dev && current.st_ino == status.st_ino;
+}
+
+/// Checks that the client runs as the same user as the server. The socket
+/// is created with owner-only permissions, but we do not rely on the directory
+/// it lives in.
+bool isTrusted(int connection) {
+#if defined(SO_PEERCRED)
+  struct ucred credentials;
+  socklen_t length = sizeof credentials;
+  if (::getsockopt(connection,
+                   SOL_SOCKET,
+                   SO_PEERCRED,
+                   &credentials,
+                   &length) != 0) {
+    return false;
+  }
+  return credentials.uid == ::getuid();
+#else
+  uid_t user;
+  gid_t group;
+  if (::getpeereid(connection, &user, &group) != 0) return false;
+  return user == ::getuid();
+#endif
+}
+
+/// Reads everything written to the (temporary) file.
+std::string readFile(std::FILE* file) {
+  std::string contents;
+  std::rewind(file);
+
+  char buffer[4096];
+  std::size_t count;
+  while ((count = std::fread(buffer, 1, sizeof buffer, file)) > 0) {
+    contents.append(buffer, count);
+  }
+
+  return contents;
+}
+
+/// Temporary files that receive stdout and stderr while a request is handled,
+/// so that everything written to them (including diagnostics printed by clang)
+/// ends up in the response.
+///
+/// In fork mode, the files are created before forking, so that the server can
+/// still report what a crashed child printed.
+class Capture {
+ public:
+  Capture() : _output(std::tmpfile()), _errors(std::tmpfile()) {
+  }
+
+  Capture(const Capture&) = delete;
+  Capture& operator=(const Capture&) = delete;
+
+  ~Capture() {
+    if (_output != nullptr) std::fclose(_output);
+    if (_errors != nullptr) std::fclose(_errors);
+  }
+
+  /// Whether both files could be created.
+  bool isValid() const noexcept {
+    return _output != nullptr && _errors != nullptr;
+  }
+
+  /// Runs the function with stdout and stderr redirected to the files.
+  int run(const std::function<int()>& function) {
+    flushAll();
+
+    const int savedOutput = ::dup(STDOUT_FILENO);
+    const int savedErrors = ::dup(STDERR_FILENO);
+    ::dup2(::fileno(_output), STDOUT_FILENO);
+    ::dup2(::fileno(_errors), STDERR_FILENO);
+
+    const int exitCode = function();
+    flushAll();
+
+    ::dup2(savedOutput, STDOUT_FILENO);
+    ::dup2(savedErrors, STDERR_FILENO);
+    ::close(savedOutput);
+    ::close(savedErrors);
+
+    return exitCode;
+  }
+
+  /// Everything written to stdout so far.
+  std::string getOutput() const {
+    return readFile(_output);
+  }
+
+  /// Everything written to stderr so far.
+  std::string getErrors() const {
+    return readFile(_errors);
+  }
+
+ private:
+  static void flushAll() {
+    llvm::outs().flush();
+    llvm::errs().flush();
+    std::fflush(stdout);
+    std::fflush(stderr);
+  }
+
+  std::FILE* _output;
+  std::FILE* _errors;
+};
+
+/// Creates a response telling the client that its request failed.
+Response makeFailure(std::string errors) {
+  return {EXIT_FAILURE, {}, std::move(errors)};
+}
+
+/// Handles the request in the working directory of the client.
+Response handle(const Request& request,
+                const Handler& handler,
+                Capture& capture) {
+  if (::chdir(request.workingDirectory.c_str()) != 0) {
+    return makeFailure("Could not change into " + request.workingDirectory +
+                       ": " + std::strerror(errno) + '\n');
+  }
+
+  Response response;
+  response.exitCode = capture.run([&] { return handler(request); });
+  response.output = capture.getOutput();
+  response.errors = capture.getErrors();
+
+  return response;
+}
+
+/// A request being answered by a child process, in fork mode.
+struct Child {
+  /// The connection to the client, kept open to report crashes.
+  int connection;
+
+  /// The output of the child.
+  std::unique_ptr<Capture> capture;
+};
+
+using ChildMap = std::unordered_map<pid_t, Child>;
+
+/// Collects children that have finished. A child exits successfully only once
+/// it has sent its response; for any other outcome (a crash, or a call to
+/// `exit()` deep inside the handler), we answer the client on its behalf.
+///
+/// \param block Whether to wait for at least one child to finish.
+void reap(ChildMap& children, bool block) {
+  int status;
+  pid_t pid;
+  while ((pid = ::waitpid(-1, &status, block ? 0 : WNOHANG)) > 0) {
+    block = false;
+
+    auto iterator = children.find(pid);
+    if (iterator == children.end()) continue;
+    auto& child = iterator->second;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+      auto errors = child.capture->getErrors();
+      if (WIFSIGNALED(status)) {
+        errors += "clang-expand crashed (" +
+                  std::string(::strsignal(WTERMSIG(status))) + ")\n";
+      }
+      sendResponse(child.connection, makeFailure(std::move(errors)));
+    }
+
+    ::close(child.connection);
+    children.erase(iterator);
+  }
+}
+
+/// Answers the request in a child process, which inherits all the state the
+/// server has built up and exits once it has sent its response.
+void forkRequest(int listener,
+                 int connection,
+                 const Request& request,
+                 const Handler& handler,
+                 ChildMap& children) {
+  auto capture = std::make_unique<Capture>();
+  if (!capture->isValid()) {
+    sendResponse(connection, makeFailure("Could not capture the output\n"));
+    ::close(connection);
+    return;
+  }
+
+  const pid_t pid = ::fork();
+  if (pid < 0) {
+    sendResponse(connection, makeFailure("Could not fork the server\n"));
+    ::close(connection);
+    return;
+  }
+
+  if (pid == 0) {
+    ::close(listener);
+    const bool sent =
+        sendResponse(connection, handle(request, handler, *capture));
+    // Skip static destructors, which belong to the server.
+    ::_exit(sent ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  children.emplace(pid, Child{connection, std::move(capture)});
+}
+
+/// How many requests may be answered concurrently in fork mode.
+std::size_t getMaximumChildren() {
+  const auto processors = ::sysconf(_SC_NPROCESSORS_ONLN);
+  return processors > 0 ? static_cast<std::size_t>(processors) : 1;
+}
+}  // namespace
+
+int serve(const std::string& socketPath,
+          const Handler& handler,
+          Mode mode,
+          unsigned idleTimeoutSeconds,
+          const Preparer& prepare) {
+  sockaddr_un address;
+  if (!makeAddress(socketPath, address)) {
+    llvm::errs() << "Socket path is too long: " << socketPath << '\n';
+    return EXIT_FAILURE;
+  }
+
+  // Clients racing to start a server all end up here. Under the lock, only
+  // the first finds nothing listening and replaces a stale socket, and no
+  // server can be shutting down at the same time.
+  const int lock = lockSocket(socketPath);
+  if (lock < 0) {
+    llvm::errs() << "Could not lock " << socketPath << ": "
+                 << std::strerror(errno) << '\n';
+    return EXIT_FAILURE;
+  }
+
+  if (isListening(address)) {
+    ::close(lock);
+    return EXIT_SUCCESS;
+  }
+  ::unlink(socketPath.c_str());
+
+  const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    llvm::errs() << "Could not create socket: " << std::strerror(errno) << '\n';
+    ::close(lock);
+    return EXIT_FAILURE;
+  }
+
+  const auto* generic = reinterpret_cast<const sockaddr*>(&address);
+  const auto oldMask = ::umask(0077);
+  const bool bound = ::bind(listener, generic, sizeof address) == 0;
+  ::umask(oldMask);
+
+  // Remembers which socket file is ours, to only ever remove that one.
+  struct stat socketStatus;
+  if (!bound || ::listen(listener, SOMAXCONN) != 0 ||
+      ::stat(socketPath.c_str(), &socketStatus) != 0) {
+    llvm::errs() << "Could not listen on " << socketPath << ": "
+                 << std::strerror(errno) << '\n';
+    ::close(listener);
+    ::close(lock);
+    return EXIT_FAILURE;
+  }
+
+  ::close(lock);
+
+  // A client going away mid-response must not take the server down with it.
+  std::signal(SIGPIPE, SIG_IGN);
+
+  const std::size_t maximumChildren = getMaximumChildren();
+  const int idleTimeout = static_cast<int>(idleTimeoutSeconds) * 1000;
+  ChildMap children;
+
+  while (true) {
+    if (children.size() >= maximumChildren) {
+      reap(children, /*block=*/true);
+      continue;
+    }
+
+    // While children are running, wake up regularly to collect them.
+    const bool busy = !children.empty();
+    pollfd descriptor{listener, POLLIN, 0};
+    const int ready = ::poll(&descriptor, 1, busy ? 50 : idleTimeout);
+    reap(children, /*block=*/false);
+
+    if (ready == 0) {
+      if (busy) continue;
+      break;
+    }
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+
+    const int connection = ::accept(listener, nullptr, nullptr);
+    if (connection < 0) continue;
+
+    Request request;
+    if (!isTrusted(connection) || !receiveRequest(connection, request)) {
+      ::close(connection);
+      continue;
+    }
+
+    if (mode == Mode::Fork) {
+      if (prepare) prepare(request);
+      forkRequest(listener, connection, request, handler, children);
+      continue;
+    }
+
+    Capture capture;
+    if (capture.isValid()) {
+      sendResponse(connection, handle(request, handler, capture));
+    } else {
+      sendResponse(connection, makeFailure("Could not capture the output\n"));
+    }
+    ::close(connection);
+  }
+
+  // Stop listening under the lock, so that a server starting meanwhile does
+  // not mistake us for a live server. If the socket was replaced (e.g. deleted
+  // and taken over by another server), it is not ours to remove.
+  const int shutdownLock = lockSocket(socketPath);
+  if (isSameFile(socketPath, socketStatus)) ::unlink(socketPath.c_str());
+  ::close(listener);
+  if (shutdownLock >= 0) ::close(shutdownLock);
+
+  while (!children.empty()) reap(children, /*block=*/true);
+
+  return EXIT_SUCCESS;
+}
+
+}  // namespace Server
+}  // namespace ClangExpand
@@ -0,0 +1,123 @@
+//===----------------------------------------------------------------------===//
+//
+//                           The MIT License (MIT)
+//                    Copyright (c) 2017 Peter Goldsborough
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//===----------------------------------------------------------------------===//
+
+// Project includes
+#include "clang-expand/session.hpp"
+#include "clang-expand/common/routines.hpp"
+#include "clang-expand/error.hpp"
+#include "clang-expand/result.hpp"
+#include "clang-expand/search.hpp"
+
+// Clang includes
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Tooling/CompilationDatabase.h>
+
+// LLVM includes
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace ClangExpand {
+llvm::Expected<std::unique_ptr<Session>>
+Session::Load(const std::string& buildDirectory, SourceVector sources) {
+  std::string message;
+  auto compilationDatabase =
+      clang::tooling::CompilationDatabase::loadFromDirectory(buildDirectory,
+                                                             message);
+  if (!compilationDatabase) {
+    return llvm::make_error<Error>(ErrorKind::InvalidConfiguration,
+                                   "Could not load compilation database from " +
+                                       buildDirectory + ": " + message);
+  }
+
+  return std::make_unique<Session>(std::move(compilationDatabase),
+                                   std::move(sources));
+}
+
+Session::Session(std::unique_ptr<CompilationDatabase> compilationDatabase,
+                 SourceVector sources)
+: _compilationDatabase(std::move(compilationDatabase))
+, _sources(std::move(sources))
+, _fileSystem(new CachingFileSystem()) {
+}
+
+Session::~Session() = default;
+
+llvm::Expected<Result> Session::run(const std::string& file,
+                                    unsigned line,
+                                    unsigned column,
+                                    Options options) {
+  // The token is registered before waiting for earlier searches, so that a
+  // cancellation issued in the meantime is not lost.
+  auto cancellation = std::make_shared<CancellationToken>();
+  {
+    std::lock_guard<std::mutex> lock(_cancellationMutex);
+    _cancellations.push_back(cancellation);
+  }
+  options.cancellation = cancellation;
+
+  auto result = [&]() -> llvm::Expected<Result> {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // No tool is using the cache between searches, so now is the time.
+    _fileSystem->refresh();
+
+    Search search(file, line, column, _fileSystem);
+    auto unit = _units.find(Routines::makeAbsolute(file));
+    if (unit != _units.end()) search.retainTranslationUnit(unit->getValue());
+
+    return search.run(*_compilationDatabase, _sources, options);
+  }();
+
+  std::lock_guard<std::mutex> lock(_cancellationMutex);
+  _cancellations.erase(std::find(_cancellations.begin(),
+                                 _cancellations.end(),
+                                 cancellation));
+
+  return result;
+}
+
+void Session::retain(const std::string& file) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _units[Routines::makeAbsolute(file)];
+}
+
+void Session::release(const std::string& file) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _units.erase(Routines::makeAbsolute(file));
+}
+
+void Session::cancel() noexcept {
+  std::lock_guard<std::mutex> lock(_cancellationMutex);
+  for (const auto& cancellation : _cancellations) {
+    cancellation->cancel();
+  }
+}
+}  // namespace ClangExpand
@@ -26,14 +26,18 @@
 #include "clang-expand/symbol-search/action.hpp"
 #include "clang-expand/common/offset.hpp"
 #include "clang-expand/common/query.hpp"
-#include "clang-expand/common/routines.hpp"
 #include "clang-expand/symbol-search/consumer.hpp"
 #include "clang-expand/symbol-search/macro-search.hpp"
+#include "clang-expand/symbol-search/match-handler.hpp"
+#include "clang-expand/error.hpp"
 
 // Clang includes
+#include <clang/ASTMatchers/ASTMatchFinder.h>
 #include <clang/Basic/FileManager.h>
+#include <clang/Basic/IdentifierTable.h>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Basic/TokenKinds.h>
+#include <clang/Frontend/ASTUnit.h>
 #include <clang/Frontend/CompilerInstance.h>
 #include <clang/Lex/Lexer.h>
 #include <clang/Lex/PPCallbacks.h>
@@ -44,6 +48,7 @@
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/StringSet.h>
 #include <llvm/ADT/Twine.h>
+#include <llvm/Support/Error.h>
 
 // Standard includes
 #include <cassert>
@@ -63,7 +68,7 @@ namespace {
 ///
 /// \returns True if the token is an operator, else false if it is a simple
 /// identifier.
-bool verifyToken(const clang::Token& token) {
+llvm::Expected<bool> verifyToken(const clang::Token& token) {
   static const llvm::StringSet<> operatorTokens = {
       "amp",                  // &
       "ampamp",               // &&
@@ -101,18 +106,21 @@ bool verifyToken(const clang::Token& token) {
   if (token.is(clang::tok::raw_identifier)) return false;
   if (operatorTokens.count(token.getName())) return true;
 
-  Routines::error("Token at given location is not an identifier");
+  return llvm::make_error<Error>(ErrorKind::InvalidToken,
+                                 "Token at given location is not an "
+                                 "identifier");
 }
 
 /// Attempts to get the `clang::FileID` for the target location.
-clang::FileID getFileID(const Location& targetLocation,
-                        clang::SourceManager& sourceManager) {
+llvm::Expected<clang::FileID> getFileID(const Location& targetLocation,
+                                        clang::SourceManager& sourceManager) {
   auto& fileManager = sourceManager.getFileManager();
   const auto* fileEntry = fileManager.getFile(targetLocation.filename);
   if (fileEntry == nullptr || !fileEntry->isValid()) {
-    Routines::error("Could not find file " +
-                    llvm::Twine(targetLocation.filename) +
-                    " in file manager\n");
+    return llvm::make_error<Error>(ErrorKind::FileNotFound,
+                                   "Could not find file " +
+                                       targetLocation.filename.str() +
+                                       " in file manager");
   }
 
   assert(fileEntry->getName() == targetLocation.filename &&
@@ -121,7 +129,8 @@ clang::FileID getFileID(const Location& targetLocation,
   const auto fileID =
       sourceManager.getOrCreateFileID(fileEntry, clang::SrcMgr::C_User);
   if (!fileID.isValid()) {
-    Routines::error("Error getting file ID from file entry");
+    return llvm::make_error<Error>(ErrorKind::FileNotFound,
+                                   "Error getting file ID from file entry");
   }
 
   return fileID;
@@ -129,21 +138,25 @@ clang::FileID getFileID(const Location& targetLocation,
 
 /// Translates our friendly representation of a location to a compact
 /// `clang::SourceLocation` for further processing with clang APIs.
-clang::SourceLocation translateLocation(const Location& location,
-                                        clang::SourceManager& sourceManager) {
-  const auto fileID = getFileID(location, sourceManager);
+llvm::Expected<clang::SourceLocation>
+translateLocation(const Location& location,
+                  clang::SourceManager& sourceManager) {
+  auto fileID = getFileID(location, sourceManager);
+  if (!fileID) return fileID.takeError();
+
   const auto line = location.offset.line;
   const auto column = location.offset.column;
-  const auto translated = sourceManager.translateLineCol(fileID, line, column);
+  const auto translated = sourceManager.translateLineCol(*fileID, line, column);
   if (translated.isInvalid()) {
-    Routines::error("Location is not valid");
+    return llvm::make_error<Error>(ErrorKind::InvalidLocation,
+                                   "Location is not valid");
   }
   return translated;
 }
 
 /// Given a location between the start and end of a token, returns a location
 /// for the start of the token.
-clang::SourceLocation
+llvm::Expected<clang::SourceLocation>
 getBeginningOfToken(const clang::SourceLocation& somewhere,
                     clang::SourceManager& sourceManager,
                     const clang::LangOptions& languageOptions) {
@@ -152,16 +165,18 @@ getBeginningOfToken(const clang::SourceLocation& somewhere,
                                                                languageOptions);
 
   if (startLocation.isInvalid()) {
-    Routines::error("Error retrieving start of token");
+    return llvm::make_error<Error>(ErrorKind::InvalidLocation,
+                                   "Error retrieving start of token");
   }
 
   return startLocation;
 }
 
 /// Lexes the token at the given location.
-clang::Token lex(const clang::SourceLocation& startLocation,
-                 clang::SourceManager& sourceManager,
-                 const clang::LangOptions& languageOptions) {
+llvm::Expected<clang::Token>
+lex(const clang::SourceLocation& startLocation,
+    clang::SourceManager& sourceManager,
+    const clang::LangOptions& languageOptions) {
   clang::Token token;
   bool errorOccurred = clang::Lexer::getRawToken(startLocation,
                                                  token,
@@ -169,37 +184,49 @@ clang::Token lex(const clang::SourceLocation& startLocation,
                                                  languageOptions,
                                                  /*IgnoreWhiteSpace=*/true);
   if (errorOccurred) {
-    Routines::error("Error lexing token at given location");
+    return llvm::make_error<Error>(ErrorKind::InvalidLocation,
+                                   "Error lexing token at given location");
   }
 
   return token;
 }
 }  // namespace
 
-Action::Action(Location targetLocation, Query& query)
-: _query(query), _targetLocation(std::move(targetLocation)) {
+Action::Action(Location targetLocation,
+               Query& query,
+               SpellingCallback onSpelling)
+: _onSpelling(std::move(onSpelling))
+, _query(query)
+, _targetLocation(std::move(targetLocation)) {
 }
 
 bool Action::BeginSourceFileAction(clang::CompilerInstance& compiler,
                                    llvm::StringRef filename) {
+  if (_query.isCancelled()) return false;
   if (!super::BeginSourceFileAction(compiler, filename)) return false;
 
   auto& sourceManager = compiler.getSourceManager();
-  const clang::SourceLocation location =
-      translateLocation(_targetLocation, sourceManager);
+  auto location = translateLocation(_targetLocation, sourceManager);
+  if (!location) return _fail(location.takeError());
 
   const auto& languageOptions = compiler.getLangOpts();
-  const auto& startLocation =
-      getBeginningOfToken(location, sourceManager, languageOptions);
+  auto startLocation =
+      getBeginningOfToken(*location, sourceManager, languageOptions);
+  if (!startLocation) return _fail(startLocation.takeError());
 
-  clang::Token token = lex(startLocation, sourceManager, languageOptions);
-  bool isOperator = verifyToken(token);
+  auto token = lex(*startLocation, sourceManager, languageOptions);
+  if (!token) return _fail(token.takeError());
+
+  auto isOperator = verifyToken(*token);
+  if (!isOperator) return _fail(isOperator.takeError());
 
   // Good to go.
-  _callLocation = startLocation;
-  _spelling = clang::Lexer::getSpelling(token, sourceManager, languageOptions);
+  _callLocation = *startLocation;
+  _spelling =
+      clang::Lexer::getSpelling(*token, sourceManager, languageOptions);
 
-  if (isOperator) _spelling = "operator" + _spelling;
+  if (*isOperator) _spelling = "operator" + _spelling;
+  if (_onSpelling) _onSpelling(_spelling);
 
   _installMacroFacilities(compiler);
 
@@ -212,10 +239,60 @@ Action::ASTConsumerPointer Action::CreateASTConsumer(clang::CompilerInstance&,
   return std::make_unique<Consumer>(_callLocation, _spelling, _query);
 }
 
+bool Action::_fail(llvm::Error error) {
+  _query.fail(std::move(error));
+  return false;
+}
+
 void Action::_installMacroFacilities(clang::CompilerInstance& compiler) const {
   auto hooks = std::make_unique<MacroSearch>(compiler, _callLocation, _query);
   compiler.getPreprocessor().addPPCallbacks(std::move(hooks));
 }
 
+bool searchUnit(clang::ASTUnit& unit,
+                const Location& targetLocation,
+                Query& query,
+                const Action::SpellingCallback& onSpelling) {
+  auto fail = [&query](llvm::Error error) {
+    query.fail(std::move(error));
+    return true;
+  };
+
+  auto& sourceManager = unit.getSourceManager();
+  auto location = translateLocation(targetLocation, sourceManager);
+  if (!location) return fail(location.takeError());
+
+  const auto& languageOptions = unit.getLangOpts();
+  auto startLocation =
+      getBeginningOfToken(*location, sourceManager, languageOptions);
+  if (!startLocation) return fail(startLocation.takeError());
+
+  auto token = lex(*startLocation, sourceManager, languageOptions);
+  if (!token) return fail(token.takeError());
+
+  auto isOperator = verifyToken(*token);
+  if (!isOperator) return fail(isOperator.takeError());
+
+  auto spelling =
+      clang::Lexer::getSpelling(*token, sourceManager, languageOptions);
+  if (*isOperator) {
+    spelling = "operator" + spelling;
+  } else {
+    auto& preprocessor = unit.getPreprocessor();
+    const auto* identifier = preprocessor.getIdentifierInfo(spelling);
+    if (identifier->hadMacroDefinition()) return false;
+  }
+
+  if (onSpelling) onSpelling(spelling);
+
+  const auto callLocation = *startLocation;
+  MatchHandler matchHandler(callLocation, query);
+  clang::ast_matchers::MatchFinder matchFinder;
+  matchFinder.addMatcher(createMatcher(spelling), &matchHandler);
+  matchFinder.matchAST(unit.getASTContext());
+
+  return true;
+}
+
 }  // namespace SymbolSearch
 }  // namespace ClangExpand
@@ -124,7 +124,11 @@ void MacroSearch::MacroExpands(const clang::Token& macroNameToken,
   const auto mapping = _createParameterMap(*info, *arguments);
   std::string text = _rewriteMacro(*info, mapping);
 
-  Location location(info->getDefinitionLoc(), _sourceManager);
+  const auto encoding = _query.getOffsetEncoding();
+  Location location(info->getDefinitionLoc(),
+                    _sourceManager,
+                    *_query.strings,
+                    encoding);
 
   if (info->isObjectLike()) {
     // - 1 because the range is inclusive
@@ -132,7 +136,7 @@ void MacroSearch::MacroExpands(const clang::Token& macroNameToken,
     range.setEnd(range.getBegin().getLocWithOffset(length));
   }
 
-  _query.call.emplace(Range{range, _sourceManager});
+  _query.call.emplace(Range{range, _sourceManager, encoding});
   _query.definition = DefinitionData{std::move(location),
                                      std::move(original),
                                      std::move(text),
@@ -26,12 +26,16 @@
 #include "clang-expand/symbol-search/match-handler.hpp"
 #include "clang-expand/common/assignee-data.hpp"
 #include "clang-expand/common/call-data.hpp"
+#include "clang-expand/common/canonical-location.hpp"
 #include "clang-expand/common/declaration-data.hpp"
 #include "clang-expand/common/definition-data.hpp"
 #include "clang-expand/common/location.hpp"
+#include "clang-expand/common/offset.hpp"
 #include "clang-expand/common/query.hpp"
 #include "clang-expand/common/range.hpp"
 #include "clang-expand/common/routines.hpp"
+#include "clang-expand/common/string-pool.hpp"
+#include "clang-expand/error.hpp"
 #include "clang-expand/options.hpp"
 
 // Clang includes
@@ -48,16 +52,19 @@
 #include <clang/ASTMatchers/ASTMatchers.h>
 #include <clang/Basic/SourceLocation.h>
 #include <clang/Basic/SourceManager.h>
+#include <clang/Index/USRGeneration.h>
 #include <clang/Lex/Lexer.h>
 
 // LLVM includes
 #include <clang/AST/PrettyPrinter.h>
 #include <llvm/ADT/None.h>
 #include <llvm/ADT/Optional.h>
+#include <llvm/ADT/SmallString.h>
 #include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/Twine.h>
 #include <llvm/Support/Casting.h>
+#include <llvm/Support/Error.h>
 
 // Standard includes
 #include <cassert>
@@ -74,10 +81,12 @@ namespace {
 using ParameterMap = DeclarationData::ParameterMap;
 
 /// Performs some necessary preprocessing on call ranges before we can plug them
-/// into the `CallData` object returned from the match handler.
+/// into the `CallData` object returned from the match handler. The offsets of
+/// the range are in the given `encoding`.
 Range cleanCallRange(const clang::Expr& expression,
                      const clang::SourceRange& range,
-                     const clang::ASTContext& context) {
+                     const clang::ASTContext& context,
+                     Offset::Encoding encoding) {
   // For a normal call expression with parentheses, we have to add +1
   // because the call expression does not include the final semicolon.
   unsigned extraOffset = +1;
@@ -95,28 +104,39 @@ Range cleanCallRange(const clang::Expr& expression,
   const auto begin = range.getBegin();
   const auto end = range.getEnd().getLocWithOffset(+extraOffset);
 
-  return {{begin, end}, context.getSourceManager()};
+  return {{begin, end}, context.getSourceManager(), encoding};
 }
 
 /// Collects a `DeclarationData` object containing the declaration's location,
 /// context and text.
 auto collectDeclarationData(const clang::FunctionDecl& function,
                             clang::ASTContext& astContext,
-                            ParameterMap&& parameterMap) {
+                            ParameterMap&& parameterMap,
+                            Offset::Encoding encoding,
+                            StringPool& strings) {
   const Location location(function.getLocation(),
-                          astContext.getSourceManager());
+                          astContext.getSourceManager(),
+                          strings,
+                          encoding);
   ClangExpand::DeclarationData declaration(function.getNameAsString(),
-                                           location);
+                                           location,
+                                           strings);
 
   declaration.parameterMap = std::move(parameterMap);
   auto text = Routines::getSourceText(function.getSourceRange(), astContext);
   declaration.text = (std::move(text) + llvm::Twine(";")).str();
 
+  llvm::SmallString<128> usr;
+  if (!clang::index::generateUSRForDecl(&function, usr)) {
+    declaration.usr = strings.intern(usr);
+  }
+
   const auto& policy = astContext.getPrintingPolicy();
   // Collect parameter types (their string representations)
   for (const auto* parameter : function.parameters()) {
     const auto type = parameter->getOriginalType().getCanonicalType();
-    declaration.parameterTypes.emplace_back(type.getAsString(policy));
+    declaration.parameterTypes.push_back(
+        strings.intern(type.getAsString(policy)));
   }
 
   // Collect contexts (their kind, e.g. namespace or class, and name)
@@ -124,9 +144,9 @@ auto collectDeclarationData(const clang::FunctionDecl& function,
   for (; context; context = context->getParent()) {
     const auto kind = context->getDeclKind();
     if (auto* ns = llvm::dyn_cast<clang::NamespaceDecl>(context)) {
-      declaration.contexts.emplace_back(kind, ns->getName().str());
+      declaration.contexts.emplace_back(kind, ns->getName(), strings);
     } else if (auto* record = llvm::dyn_cast<clang::RecordDecl>(context)) {
-      declaration.contexts.emplace_back(kind, record->getName().str());
+      declaration.contexts.emplace_back(kind, record->getName(), strings);
     }
   }
 
@@ -328,7 +348,9 @@ std::string getTypeAsString(const clang::QualType& qualType,
 /// invalid).
 llvm::Optional<CallData> handleCallForVarDecl(const clang::VarDecl& variable,
                                               clang::ASTContext& context,
-                                              const clang::Expr& expression) {
+                                              const clang::Expr& expression,
+                                              Offset::Encoding encoding,
+                                              StringPool& strings) {
   // Could be an IfStmt, a WhileStmt, a CallExpr etc. etc.
   if (isNestedInsideSomeOtherStatement(variable, context)) {
     return llvm::None;
@@ -336,7 +358,7 @@ llvm::Optional<CallData> handleCallForVarDecl(const clang::VarDecl& variable,
 
   const auto qualType = variable.getType().getCanonicalType();
   const auto typeString = getTypeAsString(qualType, context);
-  auto assignee = AssigneeData::Builder()
+  auto assignee = AssigneeData::Builder(strings)
                       .type(typeString)
                       .name(variable.getName())
                       .op("=")
@@ -351,7 +373,10 @@ llvm::Optional<CallData> handleCallForVarDecl(const clang::VarDecl& variable,
     }
   }
 
-  auto range = cleanCallRange(expression, variable.getSourceRange(), context);
+  auto range = cleanCallRange(expression,
+                              variable.getSourceRange(),
+                              context,
+                              encoding);
   return CallData(std::move(assignee), std::move(range));
 }
 
@@ -359,21 +384,27 @@ llvm::Optional<CallData> handleCallForVarDecl(const clang::VarDecl& variable,
 /// binary operator (like an assignment or compound operation, e.g. +=), then
 /// this function takes care of handling that call and collecting relevant
 /// data.
-CallData
+llvm::Expected<CallData>
 handleCallForBinaryOperator(const clang::BinaryOperator& binaryOperator,
                             clang::ASTContext& context,
-                            const clang::Expr& expression) {
+                            const clang::Expr& expression,
+                            Offset::Encoding encoding,
+                            StringPool& strings) {
   const auto* lhs = binaryOperator.getLHS();
   if (&expression == lhs) {
-    Routines::error(
+    return llvm::make_error<Error>(
+        ErrorKind::RefusedExpansion,
         "Refuse to expand function that is LHS of a binary operator");
   }
 
   if (!binaryOperator.isAssignmentOp() &&
       !binaryOperator.isCompoundAssignmentOp() &&
       !binaryOperator.isShiftAssignOp()) {
-    Routines::error("Cannot expand call as operand of " +
-                    llvm::Twine(binaryOperator.getOpcodeStr()));
+    return llvm::make_error<Error>(
+        ErrorKind::RefusedExpansion,
+        ("Cannot expand call as operand of " +
+         llvm::Twine(binaryOperator.getOpcodeStr()))
+            .str());
   }
 
   std::string name;
@@ -387,14 +418,16 @@ handleCallForBinaryOperator(const clang::BinaryOperator& binaryOperator,
     name = Routines::getSourceText(lhs->getSourceRange(), context);
   }
 
-  auto assignee = AssigneeData::Builder()
+  auto assignee = AssigneeData::Builder(strings)
                       .name(name)
                       .op(binaryOperator.getOpcodeStr())
                       .build();
 
-  auto range =
-      cleanCallRange(expression, binaryOperator.getSourceRange(), context);
-  return {std::move(assignee), std::move(range)};
+  auto range = cleanCallRange(expression,
+                              binaryOperator.getSourceRange(),
+                              context,
+                              encoding);
+  return CallData(std::move(assignee), std::move(range));
 }
 
 /// Attempts to obtain `CallData` from the surroundings (context) of an
@@ -403,9 +436,13 @@ handleCallForBinaryOperator(const clang::BinaryOperator& binaryOperator,
 /// declaration).
 /// If the maximum recursion ("walking-up") depth is reached, the operation
 /// fails. The depth value passed must initially not be zero.
-llvm::Optional<CallData>
+/// \returns `None` if nothing we can handle was found, or an error if we found
+/// something but refuse to expand the call in it.
+llvm::Expected<llvm::Optional<CallData>>
 collectCallDataFromContext(const clang::Expr& expression,
                            clang::ASTContext& context,
+                           Offset::Encoding encoding,
+                           StringPool& strings,
                            unsigned depth = 8) {
   // Not checking the base case is generally bad for the first call, but we
   // don't actually want this to be called with depth = 0 the first time.
@@ -413,12 +450,22 @@ collectCallDataFromContext(const clang::Expr& expression,
 
   for (const auto parent : context.getParents(expression)) {
     if (const auto* node = parent.get<clang::ReturnStmt>()) {
-      return CallData(
-          cleanCallRange(expression, node->getSourceRange(), context));
+      return CallData(cleanCallRange(expression,
+                                     node->getSourceRange(),
+                                     context,
+                                     encoding));
     } else if (const auto* node = parent.get<clang::VarDecl>()) {
-      return handleCallForVarDecl(*node, context, expression);
+      return handleCallForVarDecl(*node,
+                                  context,
+                                  expression,
+                                  encoding,
+                                  strings);
     } else if (const auto* node = parent.get<clang::BinaryOperator>()) {
-      return handleCallForBinaryOperator(*node, context, expression);
+      return handleCallForBinaryOperator(*node,
+                                         context,
+                                         expression,
+                                         encoding,
+                                         strings);
     }
   }
 
@@ -429,8 +476,12 @@ collectCallDataFromContext(const clang::Expr& expression,
   if (depth > 1) {
     for (const auto parent : context.getParents(expression)) {
       if (const auto* node = parent.get<clang::Expr>()) {
-        auto result = collectCallDataFromContext(*node, context, depth - 1);
-        if (result) return result;
+        auto result = collectCallDataFromContext(*node,
+                                                 context,
+                                                 encoding,
+                                                 strings,
+                                                 depth - 1);
+        if (!result || *result) return result;
       }
     }
   }
@@ -511,7 +562,7 @@ void decorateCallDataWithMemberBase(CallData& callData,
   const auto* constructor =
       result.Nodes.getNodeAs<clang::CXXConstructorDecl>("fn");
   if (constructor && callData.assignee.hasValue()) {
-    callData.base = callData.assignee->name + ".";
+    callData.base = callData.assignee->name.str() + ".";
   }
 }
 
@@ -535,18 +586,23 @@ inspectCall(const clang::FunctionDecl& function,
 /// range of the entire function call (including any variables that are assigned
 /// the return value of the function), any base (object whose method is called,
 /// when the function is a method) as well as data about any assignee.
-CallData collectCallData(const clang::Expr& call, clang::ASTContext& context) {
+llvm::Expected<CallData> collectCallData(const clang::Expr& call,
+                                         clang::ASTContext& context,
+                                         Offset::Encoding encoding,
+                                         StringPool& strings) {
   // If the parent is a compound statement or a translation unit (for globals),
   // this is a plain function call (i.e. simply `^f(x);$`), so only need the
   // range.
   if (parentAs<clang::CompoundStmt>(call, context) ||
       parentAs<clang::TranslationUnitDecl>(call, context)) {
-    return CallData(cleanCallRange(call, call.getSourceRange(), context));
+    return CallData(
+        cleanCallRange(call, call.getSourceRange(), context, encoding));
   }
 
-  if (auto optional = collectCallDataFromContext(call, context)) {
-    return *optional;
-  }
+  auto fromContext =
+      collectCallDataFromContext(call, context, encoding, strings);
+  if (!fromContext) return fromContext.takeError();
+  if (*fromContext) return std::move(**fromContext);
 
   // We only match for what we know are OK expressions, because the set of bad
   // expressions is much greater. For example, we don't want to expand function
@@ -554,7 +610,9 @@ CallData collectCallData(const clang::Expr& call, clang::ASTContext& context) {
   // declarations or any other locations where we're not safely expanding into a
   // compound statment that allows more than one statment instead of the
   // original expression.
-  Routines::error("Refuse or unable to expand at given location");
+  return llvm::make_error<Error>(
+      ErrorKind::RefusedExpansion,
+      "Refuse or unable to expand at given location");
 }
 
 /// Checks if the call location obtained through the match result matches the
@@ -575,8 +633,36 @@ MatchHandler::MatchHandler(const clang::SourceLocation& targetLocation,
 }
 
 void MatchHandler::run(const MatchResult& result) {
+  if (_query.error || _query.isCancelled()) return;
   if (!callLocationMatches(result, _targetLocation)) return;
 
+  collectMatch(result, _query);
+}
+
+clang::ast_matchers::StatementMatcher
+createMatcher(const std::string& spelling) {
+  using namespace clang::ast_matchers;  // NOLINT(build/namespaces)
+  // clang-format off
+  return expr(anyOf(
+           callExpr(anyOf(
+             hasDescendant(declRefExpr(
+               hasDeclaration(functionDecl(hasName(spelling)).bind("fn")))
+             .bind("ref")),
+             hasDescendant(memberExpr(
+               hasDeclaration(cxxMethodDecl(hasName(spelling)).bind("fn")))
+             .bind("member"))))
+           .bind("call"),
+           cxxConstructExpr(
+              hasDeclaration(
+                cxxConstructorDecl(
+                  hasName(spelling),
+                  isUserProvided())
+                .bind("fn")))
+           .bind("construct")));
+  // clang-format on
+}
+
+void collectMatch(const MatchHandler::MatchResult& result, Query& query) {
   // This is either a pure FunctionDecl, a CXXMethodDecl or a CXXConstructorDecl
   const auto* function = result.Nodes.getNodeAs<clang::FunctionDecl>("fn");
   assert(function && "Did not match required function declaration");
@@ -591,22 +677,41 @@ void MatchHandler::run(const MatchResult& result) {
 
   auto& context = *result.Context;
 
-  if (_query.options.wantsCall || _query.options.wantsRewritten) {
-    auto callData = collectCallData(*callExpression, context);
-    decorateCallDataWithMemberBase(callData, result);
-    _query.call = std::move(callData);
+  if (query.options.wantsCall || query.options.wantsRewritten) {
+    auto callData = collectCallData(*callExpression,
+                                    context,
+                                    query.getOffsetEncoding(),
+                                    *query.strings);
+    if (!callData) {
+      query.fail(callData.takeError());
+      return;
+    }
+    decorateCallDataWithMemberBase(*callData, result);
+    query.call = std::move(*callData);
   }
 
   // Already found a macro definition
-  if (_query.definition) return;
-
-  if (_query.requiresDeclaration()) {
-    _query.declaration =
-        collectDeclarationData(*function, context, std::move(parameterMap));
+  if (query.definition) return;
+
+  if (query.requiresDeclaration()) {
+    query.declaration = collectDeclarationData(*function,
+                                               context,
+                                               std::move(parameterMap),
+                                               query.getOffsetEncoding(),
+                                               *query.strings);
   }
 
-  if (_query.requiresDefinition() && function->hasBody()) {
-    _query.definition = DefinitionData::Collect(*function, context, _query);
+  if (query.requiresDefinition() && function->hasBody()) {
+    auto definition = DefinitionData::Collect(*function, context, query);
+    if (!definition) {
+      query.fail(definition.takeError());
+      return;
+    }
+    const CanonicalLocation canonical(function->getLocation(),
+                                      context.getSourceManager());
+    query.addDefinition(std::move(*definition),
+                        canonical.getFilename(*query.strings),
+                        canonical.offset);
   }
 }
 
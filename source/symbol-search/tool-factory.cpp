@@ -30,14 +30,21 @@
 // Clang includes
 #include <clang/Frontend/FrontendAction.h>
 
+// Standard includes
+#include <utility>
+
 namespace ClangExpand {
 namespace SymbolSearch {
-ToolFactory::ToolFactory(const Location& targetLocation, Query& query)
-: _targetLocation(targetLocation), _query(query) {
+ToolFactory::ToolFactory(const Location& targetLocation,
+                         Query& query,
+                         SpellingCallback onSpelling)
+: _targetLocation(targetLocation)
+, _query(query)
+, _onSpelling(std::move(onSpelling)) {
 }
 
 clang::FrontendAction* ToolFactory::create() {
-  return new SymbolSearch::Action(_targetLocation, _query);
+  return new SymbolSearch::Action(_targetLocation, _query, _onSpelling);
 }
 
 }  // namespace SymbolSearch